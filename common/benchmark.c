@@ -0,0 +1,401 @@
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "worker_pool.h"
+#include "constants.h"
+#include "benchmark.h"
+#include "terrain.h"
+#include "mesher.h"
+#include "utils.h"
+
+/* Fixed, so every run measures the same chunks */
+#define BENCHMARK_SEED 1337
+#define BENCHMARK_ITERATIONS 8
+#define CHUNK_VOLUME (SECTION_VOLUME * SECTIONS_PER_CHUNK)
+#define MAX_LIGHT 15
+
+/* L1 data cache read misses and last level cache misses */
+enum cache_counter {
+	COUNTER_L1D_MISSES,
+	COUNTER_LLC_MISSES,
+	cache_counter_count
+};
+
+/* Counters of the calling thread, a file descriptor is -1 when perf
+ * events are not available, for example without the permission */
+struct cache_counters {
+	int fds[cache_counter_count];
+	uint64_t values[cache_counter_count];
+};
+
+static double
+get_elapsed_us(const struct timespec *start, const struct timespec *end)
+{
+	return (end->tv_sec - start->tv_sec) * 1e6 + (end->tv_nsec - start->tv_nsec) / 1e3;
+}
+
+static int
+benchmark_mesher(enum mesher_type type, const struct world *world, struct chunk_mesh *mesh)
+{
+	struct timespec start, end;
+	uint32_t chunk_count = 0, cursor;
+	uint64_t quad_count = 0;
+	struct chunk *chunk;
+	int iteration;
+
+	set_mesher_type(type);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (iteration = 0; iteration < BENCHMARK_ITERATIONS; iteration++) {
+		cursor = 0;
+		while ((chunk = world_next_chunk(world, &cursor))) {
+			if (mesh_chunk(mesh, world, chunk))
+				return -1;
+
+			quad_count += mesh->index_count / 6;
+			chunk_count++;
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	printf("%-8s %10.2f us/chunk %10.1f quads/chunk\n", get_mesher_name(type),
+		   get_elapsed_us(&start, &end) / chunk_count, (double) quad_count / chunk_count);
+
+	return 0;
+}
+
+/* Compared with one byte per block */
+static void
+print_world_memory(const struct world *world)
+{
+	uint32_t cursor = 0, uniform = 0, empty = 0, shared = 0, shared_count;
+	const struct chunk_section *section;
+	size_t size = 0, shared_size;
+	struct chunk *chunk;
+	int s;
+
+	while ((chunk = world_next_chunk(world, &cursor))) {
+		size += get_chunk_memory_size(chunk);
+		for (s = 0; s < SECTIONS_PER_CHUNK; s++) {
+			section = &chunk->sections[s];
+			uniform += section_is_uniform(section);
+			empty += section_is_empty(section);
+			shared += section->indices && section->indices->shared;
+		}
+	}
+
+	printf("Blocks use %.1f KiB, %.1f KiB unpacked\n", size / 1024.0,
+		   (double) world->count * sizeof(struct chunk) / 1024.0 +
+		   (double) world->count * SECTIONS_PER_CHUNK * SECTION_VOLUME / 1024.0);
+	printf("%u of %u sections are uniform, %u of them air\n", uniform,
+		   world->count * SECTIONS_PER_CHUNK, empty);
+
+	get_shared_indices_stats(&shared_count, &shared_size);
+	printf("%u of the other sections share %u index buffers (%.1f KiB)\n",
+		   shared, shared_count, shared_size / 1024.0);
+}
+
+static void
+open_cache_counters(struct cache_counters *counters)
+{
+	static const uint64_t configs[cache_counter_count][2] = {
+		[COUNTER_L1D_MISSES] = {
+			PERF_TYPE_HW_CACHE,
+			PERF_COUNT_HW_CACHE_L1D | PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16
+		},
+		[COUNTER_LLC_MISSES] = { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+	};
+	struct perf_event_attr attr;
+	int i;
+
+	for (i = 0; i < cache_counter_count; i++) {
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = configs[i][0];
+		attr.config = configs[i][1];
+		attr.disabled = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+
+		counters->fds[i] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+		counters->values[i] = 0;
+	}
+}
+
+static void
+close_cache_counters(struct cache_counters *counters)
+{
+	int i;
+
+	for (i = 0; i < cache_counter_count; i++)
+		if (counters->fds[i] >= 0)
+			close(counters->fds[i]);
+}
+
+/* The counters only count between a start and a stop, and add up until
+ * they are read */
+static void
+start_cache_counters(struct cache_counters *counters)
+{
+	int i;
+
+	for (i = 0; i < cache_counter_count; i++)
+		if (counters->fds[i] >= 0)
+			ioctl(counters->fds[i], PERF_EVENT_IOC_ENABLE, 0);
+}
+
+static void
+stop_cache_counters(struct cache_counters *counters)
+{
+	int i;
+
+	for (i = 0; i < cache_counter_count; i++)
+		if (counters->fds[i] >= 0)
+			ioctl(counters->fds[i], PERF_EVENT_IOC_DISABLE, 0);
+}
+
+static void
+read_cache_counters(struct cache_counters *counters)
+{
+	int i;
+
+	for (i = 0; i < cache_counter_count; i++) {
+		if (counters->fds[i] < 0)
+			continue;
+
+		if (read(counters->fds[i], &counters->values[i], sizeof(uint64_t)) != sizeof(uint64_t))
+			counters->values[i] = 0;
+		ioctl(counters->fds[i], PERF_EVENT_IOC_RESET, 0);
+	}
+}
+
+static void
+print_cache_counter(const struct cache_counters *counters, enum cache_counter counter, uint32_t chunk_count)
+{
+	if (counters->fds[counter] < 0)
+		printf(" %10s", "n/a");
+	else
+		printf(" %10.1f", (double) counters->values[counter] / chunk_count);
+}
+
+/* Breadth first flood fill of the light of the top air blocks through the
+ * air of the chunk, the blocks and the light are in the packed order of
+ * the layout, one section after the other. Every block is queued at most
+ * once, since all the sources have the same light. Returns the lit blocks.
+ * */
+static uint32_t
+propagate_light(const uint8_t *blocks, uint8_t *light, uint16_t *queue, const uint32_t masks[3])
+{
+	uint32_t head = 0, tail = 0, i, section, index, neighbors[6], mask;
+	int x, z, axis, count;
+
+	memset(light, 0, CHUNK_VOLUME);
+
+	for (z = 0; z < CHUNK_WIDTH; z++) {
+		for (x = 0; x < CHUNK_WIDTH; x++) {
+			i = (SECTIONS_PER_CHUNK - 1) * SECTION_VOLUME + get_section_index(x, SECTION_HEIGHT - 1, z);
+			if (blocks[i] == BLOCK_AIR) {
+				light[i] = MAX_LIGHT;
+				queue[tail++] = i;
+			}
+		}
+	}
+
+	while (head < tail) {
+		i = queue[head++];
+		section = i / SECTION_VOLUME;
+		index = i % SECTION_VOLUME;
+
+		/* The steps along y go to the next sections at the borders */
+		for (axis = 0, count = 0; axis < 3; axis++) {
+			mask = masks[axis];
+
+			if ((index & mask) != mask)
+				neighbors[count++] = section * SECTION_VOLUME + section_index_increment(index, mask);
+			else if (axis == 1 && section + 1 < SECTIONS_PER_CHUNK)
+				neighbors[count++] = (section + 1) * SECTION_VOLUME + (index & ~mask);
+
+			if (index & mask)
+				neighbors[count++] = section * SECTION_VOLUME + section_index_decrement(index, mask);
+			else if (axis == 1 && section > 0)
+				neighbors[count++] = (section - 1) * SECTION_VOLUME + (index | mask);
+		}
+
+		while (count--) {
+			if (blocks[neighbors[count]] != BLOCK_AIR || light[neighbors[count]] + 1 >= light[i])
+				continue;
+
+			light[neighbors[count]] = light[i] - 1;
+			queue[tail++] = neighbors[count];
+		}
+	}
+
+	return tail;
+}
+
+static int
+generate_benchmark_world(struct world *world, struct worker_pool *workers, int radius)
+{
+	fnl_state noise;
+
+	init_noise_generator(&noise, BENCHMARK_SEED);
+
+	if (world_init(world, 4 * radius * radius))
+		return -1;
+
+	if (generate_world(world, &noise, workers, radius)) {
+		world_destroy(world);
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Mesh and light every chunk of the world, in the current layout */
+static int
+benchmark_layout(const struct world *world, struct chunk_mesh *mesh)
+{
+	static uint8_t blocks[CHUNK_VOLUME], light[CHUNK_VOLUME];
+	static uint16_t queue[CHUNK_VOLUME];
+	struct cache_counters counters;
+	uint32_t cursor, chunk_count = 0, masks[3];
+	struct timespec start, end;
+	struct chunk *chunk;
+	uint64_t lit = 0;
+	double elapsed_us = 0;
+	int iteration, s;
+
+	get_section_axis_masks(get_section_layout(), masks);
+	open_cache_counters(&counters);
+
+	start_cache_counters(&counters);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (iteration = 0; iteration < BENCHMARK_ITERATIONS; iteration++) {
+		cursor = 0;
+		while ((chunk = world_next_chunk(world, &cursor))) {
+			if (mesh_chunk(mesh, world, chunk)) {
+				close_cache_counters(&counters);
+				return -1;
+			}
+			chunk_count++;
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	stop_cache_counters(&counters);
+	read_cache_counters(&counters);
+
+	printf("%-8s mesh  %8.2f us/chunk", get_section_layout_name(get_section_layout()),
+		   get_elapsed_us(&start, &end) / chunk_count);
+	print_cache_counter(&counters, COUNTER_L1D_MISSES, chunk_count);
+	print_cache_counter(&counters, COUNTER_LLC_MISSES, chunk_count);
+	printf("\n");
+
+	/* Only the flood fill is measured, not the unpacking */
+	for (iteration = 0; iteration < BENCHMARK_ITERATIONS; iteration++) {
+		cursor = 0;
+		while ((chunk = world_next_chunk(world, &cursor))) {
+			for (s = 0; s < SECTIONS_PER_CHUNK; s++)
+				section_get_packed_blocks(&chunk->sections[s], blocks + s * SECTION_VOLUME);
+
+			start_cache_counters(&counters);
+			clock_gettime(CLOCK_MONOTONIC, &start);
+			lit += propagate_light(blocks, light, queue, masks);
+			clock_gettime(CLOCK_MONOTONIC, &end);
+			stop_cache_counters(&counters);
+
+			elapsed_us += get_elapsed_us(&start, &end);
+		}
+	}
+
+	read_cache_counters(&counters);
+
+	printf("%-8s light %8.2f us/chunk", get_section_layout_name(get_section_layout()), elapsed_us / chunk_count);
+	print_cache_counter(&counters, COUNTER_L1D_MISSES, chunk_count);
+	print_cache_counter(&counters, COUNTER_LLC_MISSES, chunk_count);
+	printf(" %8.1f lit blocks/chunk\n", (double) lit / chunk_count);
+
+	close_cache_counters(&counters);
+
+	return 0;
+}
+
+int
+run_mesher_benchmark(int radius)
+{
+	enum mesher_type type;
+	struct worker_pool workers;
+	struct chunk_mesh mesh;
+	struct world world;
+	int ret = -1;
+
+	if (worker_pool_init(&workers, get_worker_count(), WORKER_QUEUE_SIZE))
+		return -1;
+
+	if (generate_benchmark_world(&world, &workers, radius))
+		goto destroy_workers;
+
+	chunk_mesh_init(&mesh);
+
+	print_world_memory(&world);
+	printf("Meshing %u chunks %d times\n", world.count, BENCHMARK_ITERATIONS);
+	for (type = 0; type < mesher_type_count; type++)
+		if (benchmark_mesher(type, &world, &mesh))
+			goto destroy_mesh;
+
+	ret = 0;
+
+destroy_mesh:
+	chunk_mesh_destroy(&mesh);
+	world_destroy(&world);
+destroy_workers:
+	worker_pool_destroy(&workers);
+	return ret;
+}
+
+int
+run_layout_benchmark(int radius)
+{
+	enum section_layout layout;
+	struct worker_pool workers;
+	struct chunk_mesh mesh;
+	struct world world;
+	int ret = -1;
+
+	if (worker_pool_init(&workers, get_worker_count(), WORKER_QUEUE_SIZE))
+		return -1;
+
+	chunk_mesh_init(&mesh);
+
+	printf("Meshing and lighting %d chunks %d times with the %s mesher\n", 4 * radius * radius,
+		   BENCHMARK_ITERATIONS, get_mesher_name(get_mesher_type()));
+	printf("%-14s %17s %10s %10s\n", "", "", "L1D miss", "LLC miss");
+
+	/* The chunks are generated again in each layout */
+	for (layout = 0; layout < section_layout_count; layout++) {
+		set_section_layout(layout);
+
+		if (generate_benchmark_world(&world, &workers, radius))
+			goto destroy_mesh;
+
+		if (benchmark_layout(&world, &mesh)) {
+			world_destroy(&world);
+			goto destroy_mesh;
+		}
+
+		world_destroy(&world);
+	}
+
+	ret = 0;
+
+destroy_mesh:
+	chunk_mesh_destroy(&mesh);
+	set_section_layout(SECTION_LAYOUT_LINEAR);
+	worker_pool_destroy(&workers);
+	return ret;
+}
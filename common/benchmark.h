@@ -0,0 +1,15 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+/* Mesh the same (2 * radius)^2 chunks with every mesher and print the time
+ * per chunk and the quads of each one */
+int
+run_mesher_benchmark(int radius);
+
+/* Mesh and flood fill the light of the same chunks stored in every section
+ * layout, with the time and the cache misses per chunk of each one. The
+ * misses are read with perf events, when they are available. */
+int
+run_layout_benchmark(int radius);
+
+#endif //BENCHMARK_H
@@ -18,5 +18,15 @@
 #define PLAYER_INITIAL_POSITION_X 0.0f
 #define PLAYER_INITIAL_POSITION_Y 0.0f
 #define PLAYER_INITIAL_POSITION_Z 5.0f
+/* Chunks drawn around the player in each direction */
+#define DEFAULT_VIEW_DISTANCE 6
+/* Memory kept for the chunk blocks and for the chunk meshes, the chunks
+ * out of the view distance are cached until one of them is full */
+#define DEFAULT_CHUNK_MEMORY_BUDGET_MIB 64
+#define DEFAULT_MESH_MEMORY_BUDGET_MIB 128
+/* Where the level and region files are saved */
+#define WORLD_DIRECTORY "world"
+/* Maximum number of tasks waiting for a worker thread */
+#define WORKER_QUEUE_SIZE 4096
 
 #endif //CONSTANTS_H
@@ -0,0 +1,72 @@
+#include <string.h>
+
+#include "cpu_dispatch.h"
+
+static const char *simd_level_names[simd_level_count] = {
+	[SIMD_SCALAR] = "scalar",
+	[SIMD_SSE41] = "sse4.1",
+	[SIMD_AVX2] = "avx2",
+	[SIMD_AVX512] = "avx512",
+};
+
+static const noise_row_kernel noise_row_kernels[simd_level_count] = {
+	[SIMD_SCALAR] = noise_row_scalar,
+	[SIMD_SSE41] = noise_row_sse41,
+	[SIMD_AVX2] = noise_row_avx2,
+	[SIMD_AVX512] = noise_row_avx512,
+};
+
+struct cpu_kernels cpu_kernels = {
+	.level = SIMD_SCALAR,
+	.noise_row = noise_row_scalar,
+};
+
+static enum simd_level
+detect_simd_level()
+{
+	/* libgcc also checks with xgetbv that the OS saves the wide registers */
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx512f"))
+		return SIMD_AVX512;
+	if (__builtin_cpu_supports("avx2"))
+		return SIMD_AVX2;
+	if (__builtin_cpu_supports("sse4.1"))
+		return SIMD_SSE41;
+	return SIMD_SCALAR;
+}
+
+enum simd_level
+init_cpu_dispatch(enum simd_level max_level)
+{
+	enum simd_level level = detect_simd_level();
+
+	if (level > max_level)
+		level = max_level;
+
+	cpu_kernels.level = level;
+	cpu_kernels.noise_row = noise_row_kernels[level];
+
+	return level;
+}
+
+const char *
+get_simd_level_name(enum simd_level level)
+{
+	return simd_level_names[level];
+}
+
+int
+parse_simd_level(const char *name, enum simd_level *level)
+{
+	int i;
+
+	for (i = 0; i < simd_level_count; i++) {
+		if (!strcmp(name, simd_level_names[i])) {
+			*level = i;
+			return 0;
+		}
+	}
+
+	return -1;
+}
@@ -0,0 +1,37 @@
+#ifndef CPU_DISPATCH_H
+#define CPU_DISPATCH_H
+
+#include "noise.h"
+
+/* Instruction sets with their own kernels, from the narrowest to the widest */
+enum simd_level {
+	SIMD_SCALAR,
+	SIMD_SSE41,
+	SIMD_AVX2,
+	SIMD_AVX512,
+	simd_level_count
+};
+
+/* Implementations picked for the host CPU, everything is built with generic
+ * flags and the wide kernels are compiled with per function target attributes */
+struct cpu_kernels {
+	enum simd_level level;
+	noise_row_kernel noise_row;
+};
+
+/* Scalar until `init_cpu_dispatch()` is called */
+extern struct cpu_kernels cpu_kernels;
+
+/* Select the widest kernels supported by the CPU and the OS, but never
+ * above `max_level`, returns the selected level */
+enum simd_level
+init_cpu_dispatch(enum simd_level max_level);
+
+const char *
+get_simd_level_name(enum simd_level level);
+
+/* Returns -1 if the name is unknown */
+int
+parse_simd_level(const char *name, enum simd_level *level);
+
+#endif //CPU_DISPATCH_H
@@ -0,0 +1,146 @@
+#include <stdatomic.h>
+#include <stdalign.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <stdint.h>
+
+#include "lf_queue.h"
+#include "epoch.h"
+#include "utils.h"
+
+/* Epoch of a reading thread, 0 while it is not reading */
+struct epoch_record {
+	alignas(CACHE_LINE_SIZE) atomic_uint_fast64_t epoch;
+	atomic_bool taken;
+};
+
+static struct epoch_record records[EPOCH_MAX_THREADS];
+static atomic_uint_fast64_t global_epoch = 1;
+
+/* Gives the record back when the thread exits */
+static pthread_once_t record_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t record_key;
+static _Thread_local struct epoch_record *thread_record = NULL;
+
+static pthread_mutex_t retired_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct epoch_node *retired = NULL;
+
+static void
+release_record(void *record)
+{
+	atomic_store_explicit(&((struct epoch_record *) record)->epoch, 0, memory_order_release);
+	atomic_store_explicit(&((struct epoch_record *) record)->taken, false, memory_order_release);
+}
+
+static void
+create_record_key()
+{
+	if (pthread_key_create(&record_key, release_record))
+		print_error("Failed to create the epoch record key!");
+}
+
+static struct epoch_record *
+take_record()
+{
+	bool expected;
+	int i;
+
+	pthread_once(&record_key_once, create_record_key);
+
+	for (i = 0; i < EPOCH_MAX_THREADS; i++) {
+		expected = false;
+		if (atomic_compare_exchange_strong(&records[i].taken, &expected, true)) {
+			pthread_setspecific(record_key, &records[i]);
+			return &records[i];
+		}
+	}
+
+	print_error("Too many threads reading, no epoch record left!");
+	return NULL;
+}
+
+int
+epoch_enter()
+{
+	if (!thread_record && !(thread_record = take_record()))
+		return -1;
+
+	/* The record must be visible before any read of the shared data, so a
+	 * writer that does not see it knows the reads come after its unlink */
+	atomic_store_explicit(&thread_record->epoch, atomic_load(&global_epoch), memory_order_relaxed);
+	atomic_thread_fence(memory_order_seq_cst);
+
+	return 0;
+}
+
+void
+epoch_leave()
+{
+	atomic_store_explicit(&thread_record->epoch, 0, memory_order_release);
+}
+
+void
+epoch_retire(struct epoch_node *node, void *object, void (*destroy)(void *object))
+{
+	node->object = object;
+	node->destroy = destroy;
+
+	/* Unlinked before this, so only the readers of this epoch or older
+	 * ones can still see it */
+	atomic_thread_fence(memory_order_seq_cst);
+	node->epoch = atomic_load(&global_epoch);
+
+	pthread_mutex_lock(&retired_lock);
+	node->next = retired;
+	retired = node;
+	pthread_mutex_unlock(&retired_lock);
+}
+
+void
+epoch_collect()
+{
+	uint64_t epoch, oldest, current;
+	struct epoch_node **link, *node;
+	int i;
+
+	pthread_mutex_lock(&retired_lock);
+
+	atomic_thread_fence(memory_order_seq_cst);
+	current = atomic_load(&global_epoch);
+	oldest = current;
+	for (i = 0; i < EPOCH_MAX_THREADS; i++) {
+		epoch = atomic_load(&records[i].epoch);
+		if (epoch && epoch < oldest)
+			oldest = epoch;
+	}
+
+	/* Every reader is in the current epoch */
+	if (oldest == current)
+		atomic_compare_exchange_strong(&global_epoch, &current, current + 1);
+
+	/* Whatever was retired before the oldest reader entered is unreachable */
+	link = &retired;
+	while ((node = *link)) {
+		if (node->epoch < oldest) {
+			*link = node->next;
+			node->destroy(node->object);
+		} else {
+			link = &node->next;
+		}
+	}
+
+	pthread_mutex_unlock(&retired_lock);
+}
+
+void
+epoch_reclaim_all()
+{
+	struct epoch_node *node;
+
+	pthread_mutex_lock(&retired_lock);
+	while ((node = retired)) {
+		retired = node->next;
+		node->destroy(node->object);
+	}
+	pthread_mutex_unlock(&retired_lock);
+}
@@ -0,0 +1,44 @@
+#ifndef EPOCH_H
+#define EPOCH_H
+
+#include <stdint.h>
+
+/* Epoch based reclamation. The readers of a shared structure access it
+ * between `epoch_enter()` and `epoch_leave()`, and the writers retire
+ * what they unlink from it instead of freeing it. A retired object is
+ * destroyed once every reader that could have seen it has left.
+ * Each reading thread takes one of EPOCH_MAX_THREADS records on its first
+ * `epoch_enter()`, and gives it back when it exits.
+ * */
+#define EPOCH_MAX_THREADS 64
+
+/* Embedded in the retired objects, so retiring never allocates */
+struct epoch_node {
+	struct epoch_node *next;
+	void *object;
+	void (*destroy)(void *object);
+	uint64_t epoch;
+};
+
+/* Not reentrant. Fails if every record is taken, the thread must not read
+ * the shared structures then. */
+int
+epoch_enter();
+
+void
+epoch_leave();
+
+/* `node` belongs to `object` and must stay valid until `destroy` */
+void
+epoch_retire(struct epoch_node *node, void *object, void (*destroy)(void *object));
+
+/* Advance the epoch when every reader is in the current one, and destroy
+ * what can't be seen anymore. Call it regularly from any thread. */
+void
+epoch_collect();
+
+/* Destroy everything retired, only when no thread is reading anymore */
+void
+epoch_reclaim_all();
+
+#endif //EPOCH_H
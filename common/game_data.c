@@ -11,6 +11,7 @@ init_game_state(struct game_data *game)
 
 	configs->mouse_speed = DEFAULT_MOUSE_SPEED;
 	configs->FoV = DEFAULT_FOV;
+	configs->view_distance = DEFAULT_VIEW_DISTANCE;
 
 	player->horizontal_angle = INITIAL_HORIZONTAL_ANGLE;
 	player->vertical_angle = INITIAL_VERTICAL_ANGLE;
@@ -1,34 +0,0 @@
-#include "game_objects.h"
-
-struct vertex cube_vertices[20] = {
-	// vertex position     texture coodinate
-	{{ -0.5f,-0.5f,-0.5f }, { 0.0f, 0.0f }},
-	{{ -0.5f,-0.5f, 0.5f }, { 1.0f, 0.0f }},
-	{{ -0.5f, 0.5f, 0.5f }, { 1.0f, 1.0f }},
-	{{ -0.5f, 0.5f,-0.5f }, { 0.0f, 1.0f }},
-	{{ -0.5f,-0.5f,-0.5f }, { 1.0f, 0.0f }},
-	{{ 0.5f, 0.5f,-0.5f },  { 0.0f, 1.0f }},
-	{{ 0.5f,-0.5f,-0.5f },  { 0.0f, 0.0f }},
-	{{ -0.5f, 0.5f,-0.5f }, { 1.0f, 1.0f }},
-	{{ -0.5f,-0.5f,-0.5f }, { 1.0f, 1.0f }},
-	{{ 0.5f,-0.5f,-0.5f },  { 1.0f, 0.0f }},
-	{{ 0.5f,-0.5f, 0.5f },  { 0.0f, 0.0f }},
-	{{ -0.5f,-0.5f, 0.5f }, { 0.0f, 1.0f }},
-	{{ -0.5f, 0.5f, 0.5f }, { 0.0f, 1.0f }},
-	{{ 0.5f, 0.5f, 0.5f },  { 0.0f, 0.0f }},
-	{{ 0.5f, 0.5f,-0.5f },  { 1.0f, 0.0f }},
-	{{ 0.5f, 0.5f,-0.5f },  { 1.0f, 1.0f }},
-	{{ 0.5f, 0.5f, 0.5f },  { 0.0f, 1.0f }},
-	{{ -0.5f,-0.5f, 0.5f }, { 0.0f, 0.0f }},
-	{{ 0.5f, 0.5f, 0.5f },  { 1.0f, 1.0f }},
-	{{ 0.5f,-0.5f, 0.5f },  { 1.0f, 0.0f }},
-};
-
-uint16_t cube_vertex_indices[36] = {
-	0, 1, 2, 2, 3, 0,      // -X side
-	4, 5, 6, 4, 7, 5,      // -Z side
-	8, 9, 10, 8, 10, 11,   // -Y side
-	7, 12, 13, 7, 13, 14,  // +Y side
-	15, 16, 10, 10, 9, 15, // +X side
-	12, 17, 18, 17, 19, 18 // +Z side
-};
@@ -1,17 +1,31 @@
 #ifndef GAME_OBJECTS_H
 #define GAME_OBJECTS_H
 
-#include <stdalign.h>
-#include <cglm/cglm.h>
+#include <stdint.h>
 
-#include "vk_types.h"
+/* Bit offsets of the fields of `struct vertex`, keep them in sync with
+ * main_shader.vert */
+#define VERTEX_X_SHIFT 0
+#define VERTEX_Y_SHIFT 5
+#define VERTEX_Z_SHIFT 12
+#define VERTEX_FACE_SHIFT 17
+#define VERTEX_AO_SHIFT 20
+#define VERTEX_U_SHIFT 0
+#define VERTEX_V_SHIFT 8
+#define VERTEX_LAYER_SHIFT 16
 
+/* Ambient occlusion of a vertex, from fully occluded (0) to none (3) */
+#define VERTEX_AO_NONE 3
+
+/* Chunk mesh vertex packed in 8 bytes, decoded by the vertex shader.
+ * position: x (5 bits) | y (7 bits) | z (5 bits) | face (3 bits) | AO (2 bits)
+ * texture: u (8 bits) | v (8 bits) | texture layer (8 bits)
+ * The position is relative to the chunk origin, so it goes from 0 to the
+ * chunk size. The texture coordinates are in blocks.
+ * */
 struct vertex {
-	vec3 pos;
-	vec2 texCoord;
+	uint32_t position;
+	uint32_t texture;
 };
 
-extern struct vertex cube_vertices[20];
-extern uint16_t cube_vertex_indices[36];
-
 #endif //GAME_OBJECTS_H
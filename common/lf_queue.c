@@ -0,0 +1,102 @@
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "lf_queue.h"
+#include "utils.h"
+
+int
+lf_queue_init(struct lf_queue *queue, size_t capacity)
+{
+	size_t i, pow2_capacity = 2;
+
+	while (pow2_capacity < capacity)
+		pow2_capacity <<= 1;
+
+	queue->cells = malloc(sizeof(struct lf_queue_cell) * pow2_capacity);
+	if (!queue->cells) {
+		pprint_error("Failed to allocate a %zu entries lock-free queue", pow2_capacity);
+		return -1;
+	}
+
+	/* Every cell sequence starts as the position of its first push */
+	for (i = 0; i < pow2_capacity; i++)
+		atomic_init(&queue->cells[i].sequence, i);
+
+	queue->mask = pow2_capacity - 1;
+	atomic_init(&queue->enqueue_pos, 0);
+	atomic_init(&queue->dequeue_pos, 0);
+
+	return 0;
+}
+
+void
+lf_queue_destroy(struct lf_queue *queue)
+{
+	free(queue->cells);
+	queue->cells = NULL;
+}
+
+bool
+lf_queue_push(struct lf_queue *queue, void *data)
+{
+	size_t pos = atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed);
+	struct lf_queue_cell *cell;
+	intptr_t diff;
+	size_t seq;
+
+	for (;;) {
+		cell = &queue->cells[pos & queue->mask];
+		seq = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+		diff = (intptr_t) seq - (intptr_t) pos;
+
+		if (diff == 0) {
+			/* The cell is free, try to claim it */
+			if (atomic_compare_exchange_weak_explicit(&queue->enqueue_pos, &pos, pos + 1,
+													  memory_order_relaxed, memory_order_relaxed))
+				break;
+		} else if (diff < 0) {
+			/* The cell still holds the data of the previous lap */
+			return false;
+		} else {
+			pos = atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed);
+		}
+	}
+
+	cell->data = data;
+	atomic_store_explicit(&cell->sequence, pos + 1, memory_order_release);
+
+	return true;
+}
+
+void *
+lf_queue_pop(struct lf_queue *queue)
+{
+	size_t pos = atomic_load_explicit(&queue->dequeue_pos, memory_order_relaxed);
+	struct lf_queue_cell *cell;
+	intptr_t diff;
+	size_t seq;
+	void *data;
+
+	for (;;) {
+		cell = &queue->cells[pos & queue->mask];
+		seq = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+		diff = (intptr_t) seq - (intptr_t) (pos + 1);
+
+		if (diff == 0) {
+			if (atomic_compare_exchange_weak_explicit(&queue->dequeue_pos, &pos, pos + 1,
+													  memory_order_relaxed, memory_order_relaxed))
+				break;
+		} else if (diff < 0) {
+			/* Nothing was pushed to this cell yet */
+			return NULL;
+		} else {
+			pos = atomic_load_explicit(&queue->dequeue_pos, memory_order_relaxed);
+		}
+	}
+
+	data = cell->data;
+	/* Release the cell to the push of the next lap */
+	atomic_store_explicit(&cell->sequence, pos + queue->mask + 1, memory_order_release);
+
+	return data;
+}
@@ -0,0 +1,42 @@
+#ifndef LF_QUEUE_H
+#define LF_QUEUE_H
+
+#include <stdatomic.h>
+#include <stdalign.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define CACHE_LINE_SIZE 64
+
+struct lf_queue_cell {
+	atomic_size_t sequence;
+	void *data;
+};
+
+/* Bounded multi producer/multi consumer lock-free queue of pointers
+ * (Dmitry Vyukov's ring buffer). Producers and consumers only contend on
+ * their own position counter, so each one lives in its own cache line.
+ * */
+struct lf_queue {
+	struct lf_queue_cell *cells;
+	size_t mask;
+	alignas(CACHE_LINE_SIZE) atomic_size_t enqueue_pos;
+	alignas(CACHE_LINE_SIZE) atomic_size_t dequeue_pos;
+};
+
+/* `capacity` is rounded up to a power of two */
+int
+lf_queue_init(struct lf_queue *queue, size_t capacity);
+
+void
+lf_queue_destroy(struct lf_queue *queue);
+
+/* Returns false if the queue is full */
+bool
+lf_queue_push(struct lf_queue *queue, void *data);
+
+/* Returns NULL if the queue is empty */
+void *
+lf_queue_pop(struct lf_queue *queue);
+
+#endif //LF_QUEUE_H
@@ -0,0 +1,660 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "mesher.h"
+#include "utils.h"
+
+/* The chunk blocks with a one block border taken from the neighbor chunks */
+#define PADDED_WIDTH (CHUNK_WIDTH + 2)
+#define PADDED_HEIGHT (CHUNK_HEIGHT + 2)
+#define padded_index(x, y, z) (((((y) + 1) * PADDED_WIDTH) + (z) + 1) * PADDED_WIDTH + (x) + 1)
+
+#define INITIAL_QUAD_CAPACITY 1024
+
+static_assert(sizeof(struct vertex) == 8, "Chunk mesh vertices must stay packed");
+static_assert(CHUNK_WIDTH <= 31 && CHUNK_HEIGHT <= 127, "Chunk too big for the vertex position bits");
+
+static const int chunk_dimensions[3] = { CHUNK_WIDTH, CHUNK_HEIGHT, CHUNK_WIDTH };
+
+static const uint8_t block_textures[block_type_count][block_face_count] = {
+	[BLOCK_STONE_BRICKS] = {
+		TEXTURE_STONE_BRICKS, TEXTURE_STONE_BRICKS, TEXTURE_STONE_BRICKS,
+		TEXTURE_STONE_BRICKS, TEXTURE_STONE_BRICKS, TEXTURE_STONE_BRICKS
+	},
+	[BLOCK_BRICKS] = {
+		TEXTURE_BRICKS, TEXTURE_BRICKS, TEXTURE_BRICKS,
+		TEXTURE_BRICKS, TEXTURE_BRICKS, TEXTURE_BRICKS
+	},
+	[BLOCK_GRASS] = {
+		[FACE_NEG_X] = TEXTURE_GRASS_BLOCK_SIDE, [FACE_POS_X] = TEXTURE_GRASS_BLOCK_SIDE,
+		[FACE_NEG_Y] = TEXTURE_COARSE_DIRT, [FACE_POS_Y] = TEXTURE_GRASS_BLOCK_TOP,
+		[FACE_NEG_Z] = TEXTURE_GRASS_BLOCK_SIDE, [FACE_POS_Z] = TEXTURE_GRASS_BLOCK_SIDE
+	},
+	[BLOCK_SAND] = {
+		TEXTURE_SAND, TEXTURE_SAND, TEXTURE_SAND,
+		TEXTURE_SAND, TEXTURE_SAND, TEXTURE_SAND
+	},
+	[BLOCK_COARSE_DIRT] = {
+		TEXTURE_COARSE_DIRT, TEXTURE_COARSE_DIRT, TEXTURE_COARSE_DIRT,
+		TEXTURE_COARSE_DIRT, TEXTURE_COARSE_DIRT, TEXTURE_COARSE_DIRT
+	},
+};
+
+void
+chunk_mesh_init(struct chunk_mesh *mesh)
+{
+	memset(mesh, 0, sizeof(struct chunk_mesh));
+}
+
+void
+chunk_mesh_destroy(struct chunk_mesh *mesh)
+{
+	free(mesh->vertices);
+	free(mesh->indices);
+	chunk_mesh_init(mesh);
+}
+
+static int
+grow_chunk_mesh(struct chunk_mesh *mesh)
+{
+	uint32_t capacity = mesh->quad_capacity ? mesh->quad_capacity * 2 : INITIAL_QUAD_CAPACITY;
+	struct vertex *vertices;
+	uint32_t *indices;
+
+	vertices = realloc(mesh->vertices, sizeof(struct vertex) * 4 * capacity);
+	if (!vertices) {
+		print_error("Failed to grow the chunk mesh vertex vector!");
+		return -1;
+	}
+	mesh->vertices = vertices;
+
+	indices = realloc(mesh->indices, sizeof(uint32_t) * 6 * capacity);
+	if (!indices) {
+		print_error("Failed to grow the chunk mesh index vector!");
+		return -1;
+	}
+	mesh->indices = indices;
+
+	mesh->quad_capacity = capacity;
+
+	return 0;
+}
+
+#define is_section_solid(section) (section_is_uniform(section) && (section)->palette[0] != BLOCK_AIR)
+
+/* A solid uniform section with solid sections all around, none of its
+ * faces can be seen. Missing neighbors and the outside of the world are
+ * air, so the lowest and the highest sections are never hidden. */
+static bool
+is_section_hidden(const struct chunk *chunk, const struct chunk *const neighbors[4], int section)
+{
+	int i;
+
+	if (section == 0 || section == SECTIONS_PER_CHUNK - 1 || !is_section_solid(&chunk->sections[section]) ||
+		!is_section_solid(&chunk->sections[section - 1]) || !is_section_solid(&chunk->sections[section + 1]))
+		return false;
+
+	for (i = 0; i < 4; i++)
+		if (!neighbors[i] || !is_section_solid(&neighbors[i]->sections[section]))
+			return false;
+
+	return true;
+}
+
+/* Sections without a single visible face */
+static bool
+can_skip_section(const struct chunk *chunk, const struct chunk *const neighbors[4], int section)
+{
+	return section_is_empty(&chunk->sections[section]) || is_section_hidden(chunk, neighbors, section);
+}
+
+/* Copy the chunk and the border blocks of its four neighbors, everything
+ * else (including above and bellow the world) stays air */
+static void
+fill_padded_blocks(uint8_t *padded, const struct chunk *chunk, const struct chunk *const neighbors[4])
+{
+	uint8_t blocks[SECTION_VOLUME];
+	int y, i;
+
+	memset(padded, BLOCK_AIR, PADDED_WIDTH * PADDED_WIDTH * PADDED_HEIGHT);
+
+	for (y = 0; y < CHUNK_HEIGHT; y++) {
+		if (y % SECTION_HEIGHT == 0)
+			section_get_blocks(&chunk->sections[y / SECTION_HEIGHT], blocks);
+
+		for (i = 0; i < CHUNK_WIDTH; i++) {
+			/* Rows along x are contiguous in both layouts */
+			memcpy(&padded[padded_index(0, y, i)], &blocks[block_index(0, y % SECTION_HEIGHT, i)], CHUNK_WIDTH);
+
+			if (neighbors[0])
+				padded[padded_index(-1, y, i)] = chunk_get_block(neighbors[0], CHUNK_WIDTH - 1, y, i);
+			if (neighbors[1])
+				padded[padded_index(CHUNK_WIDTH, y, i)] = chunk_get_block(neighbors[1], 0, y, i);
+			if (neighbors[2])
+				padded[padded_index(i, y, -1)] = chunk_get_block(neighbors[2], i, y, CHUNK_WIDTH - 1);
+			if (neighbors[3])
+				padded[padded_index(i, y, CHUNK_WIDTH)] = chunk_get_block(neighbors[3], i, y, 0);
+		}
+	}
+}
+
+/* Append the quad `origin` + [0, width] * u + [0, height] * v of the face
+ * perpendicular to `axis`. The winding is counter clockwise when looking
+ * at the face from outside of the block, like the old cube mesh.
+ * */
+static int
+add_quad(struct chunk_mesh *mesh, int face, const int origin[3], int width, int height, uint8_t texture_layer)
+{
+	int axis = face / 2, u = (axis + 1) % 3, v = (axis + 2) % 3;
+	struct vertex *vertex;
+	uint32_t *index;
+	uint32_t i, corner[3], tex_coord[2];
+	/* (u, v) offsets of the corners, reversed for the faces pointing to
+	 * the negative side so they keep facing out of the block */
+	static const int corners[2][4][2] = {
+		{ { 0, 0 }, { 0, 1 }, { 1, 1 }, { 1, 0 } },
+		{ { 0, 0 }, { 1, 0 }, { 1, 1 }, { 0, 1 } },
+	};
+
+	if (mesh->vertex_count / 4 == mesh->quad_capacity && grow_chunk_mesh(mesh))
+		return -1;
+
+	vertex = &mesh->vertices[mesh->vertex_count];
+	for (i = 0; i < 4; i++, vertex++) {
+		corner[axis] = origin[axis];
+		corner[u] = origin[u] + corners[face % 2][i][0] * width;
+		corner[v] = origin[v] + corners[face % 2][i][1] * height;
+
+		vertex->position = corner[0] << VERTEX_X_SHIFT | corner[1] << VERTEX_Y_SHIFT |
+			corner[2] << VERTEX_Z_SHIFT | face << VERTEX_FACE_SHIFT |
+			VERTEX_AO_NONE << VERTEX_AO_SHIFT;
+
+		/* Texture coordinates grow one unit per block, the sampler repeats
+		 * the texture. The top of the texture of the side faces is up. */
+		if (axis == 1) {
+			tex_coord[0] = corner[0];
+			tex_coord[1] = corner[2];
+		} else {
+			tex_coord[0] = axis == 0 ? corner[2] : corner[0];
+			tex_coord[1] = CHUNK_HEIGHT - corner[1];
+		}
+
+		vertex->texture = tex_coord[0] << VERTEX_U_SHIFT | tex_coord[1] << VERTEX_V_SHIFT |
+			(uint32_t) texture_layer << VERTEX_LAYER_SHIFT;
+	}
+
+	index = &mesh->indices[mesh->index_count];
+	index[0] = mesh->vertex_count;
+	index[1] = mesh->vertex_count + 1;
+	index[2] = mesh->vertex_count + 2;
+	index[3] = mesh->vertex_count + 2;
+	index[4] = mesh->vertex_count + 3;
+	index[5] = mesh->vertex_count;
+
+	mesh->vertex_count += 4;
+	mesh->index_count += 6;
+
+	return 0;
+}
+
+/* Merge the faces of `mask` (texture layer + 1, or 0 for no face) into the
+ * largest rectangles, growing first along u and then along v */
+static int
+mesh_slice_mask(struct chunk_mesh *mesh, uint8_t *mask, int face, int slice)
+{
+	int axis = face / 2, u = (axis + 1) % 3, v = (axis + 2) % 3;
+	int size_u = chunk_dimensions[u], size_v = chunk_dimensions[v];
+	int i, j, k, width, height, origin[3];
+	uint8_t layer;
+
+	for (j = 0; j < size_v; j++) {
+		for (i = 0; i < size_u; i++) {
+			layer = mask[j * size_u + i];
+			if (!layer)
+				continue;
+
+			for (width = 1; i + width < size_u && mask[j * size_u + i + width] == layer; width++)
+				;
+
+			for (height = 1; j + height < size_v; height++) {
+				for (k = 0; k < width; k++)
+					if (mask[(j + height) * size_u + i + k] != layer)
+						break;
+				if (k != width)
+					break;
+			}
+
+			for (k = 0; k < height; k++)
+				memset(&mask[(j + k) * size_u + i], 0, width);
+
+			origin[axis] = slice + face % 2;
+			origin[u] = i;
+			origin[v] = j;
+
+			if (add_quad(mesh, face, origin, width, height, layer - 1))
+				return -1;
+		}
+	}
+
+	return 0;
+}
+
+static int
+mesh_chunk_greedy(struct chunk_mesh *mesh, const struct chunk *chunk, const struct chunk *const neighbors[4])
+{
+	uint8_t padded[PADDED_WIDTH * PADDED_WIDTH * PADDED_HEIGHT];
+	uint8_t mask[CHUNK_WIDTH * CHUNK_HEIGHT];
+	int face, axis, u, v, slice, i, j, pos[3];
+	int neighbor_offset, offsets[3];
+	uint8_t block;
+
+	fill_padded_blocks(padded, chunk, neighbors);
+
+	offsets[0] = padded_index(1, 0, 0) - padded_index(0, 0, 0);
+	offsets[1] = padded_index(0, 1, 0) - padded_index(0, 0, 0);
+	offsets[2] = padded_index(0, 0, 1) - padded_index(0, 0, 0);
+
+	for (face = 0; face < block_face_count; face++) {
+		axis = face / 2;
+		u = (axis + 1) % 3;
+		v = (axis + 2) % 3;
+		neighbor_offset = face % 2 ? offsets[axis] : -offsets[axis];
+
+		for (slice = 0; slice < chunk_dimensions[axis]; slice++) {
+			if (axis == 1 && can_skip_section(chunk, neighbors, slice / SECTION_HEIGHT))
+				continue;
+
+			pos[axis] = slice;
+
+			/* A face is visible when the block next to it is air */
+			for (j = 0; j < chunk_dimensions[v]; j++) {
+				pos[v] = j;
+				for (i = 0; i < chunk_dimensions[u]; i++) {
+					pos[u] = i;
+					block = padded[padded_index(pos[0], pos[1], pos[2])];
+
+					if (block == BLOCK_AIR || padded[padded_index(pos[0], pos[1], pos[2]) + neighbor_offset] != BLOCK_AIR)
+						mask[j * chunk_dimensions[u] + i] = 0;
+					else
+						mask[j * chunk_dimensions[u] + i] = block_textures[block][face] + 1;
+				}
+			}
+
+			if (mesh_slice_mask(mesh, mask, face, slice))
+				return -1;
+		}
+	}
+
+	return 0;
+}
+
+/* The baseline: one quad per visible face, without any merging */
+static int
+mesh_chunk_naive(struct chunk_mesh *mesh, const struct chunk *chunk, const struct chunk *const neighbors[4])
+{
+	uint8_t padded[PADDED_WIDTH * PADDED_WIDTH * PADDED_HEIGHT];
+	static const int directions[block_face_count][3] = {
+		{ -1, 0, 0 }, { 1, 0, 0 }, { 0, -1, 0 }, { 0, 1, 0 }, { 0, 0, -1 }, { 0, 0, 1 }
+	};
+	int face, x, y, z, origin[3];
+	uint8_t block;
+
+	fill_padded_blocks(padded, chunk, neighbors);
+
+	for (y = 0; y < CHUNK_HEIGHT; y++) {
+		if (y % SECTION_HEIGHT == 0 && can_skip_section(chunk, neighbors, y / SECTION_HEIGHT)) {
+			y += SECTION_HEIGHT - 1;
+			continue;
+		}
+
+		for (z = 0; z < CHUNK_WIDTH; z++) {
+			for (x = 0; x < CHUNK_WIDTH; x++) {
+				block = padded[padded_index(x, y, z)];
+				if (block == BLOCK_AIR)
+					continue;
+
+				for (face = 0; face < block_face_count; face++) {
+					if (padded[padded_index(x + directions[face][0], y + directions[face][1],
+											z + directions[face][2])] != BLOCK_AIR)
+						continue;
+
+					origin[0] = x;
+					origin[1] = y;
+					origin[2] = z;
+					origin[face / 2] += face % 2;
+
+					if (add_quad(mesh, face, origin, 1, 1, block_textures[block][face]))
+						return -1;
+				}
+			}
+		}
+	}
+
+	return 0;
+}
+
+/* Bit y of a column is the block y of a (x, z) column of the chunk */
+static_assert(CHUNK_HEIGHT == 64, "The binary mesher needs 64 blocks high chunks");
+
+struct chunk_columns {
+	/* Solid blocks, with the border columns of the neighbor chunks */
+	uint64_t solid[PADDED_WIDTH][PADDED_WIDTH];
+	/* Blocks of each type, only for the columns of the chunk */
+	uint64_t types[block_type_count][CHUNK_WIDTH][CHUNK_WIDTH];
+};
+
+/* Bits of the blocks of a section in a column */
+#define get_section_column_mask(section) ((((uint64_t) 1 << SECTION_HEIGHT) - 1) << (section) * SECTION_HEIGHT)
+
+static uint64_t
+get_column_bits(const struct chunk *chunk, int x, int z)
+{
+	const struct chunk_section *section;
+	uint64_t column = 0;
+	int i, y;
+
+	for (i = 0; i < SECTIONS_PER_CHUNK; i++) {
+		section = &chunk->sections[i];
+		if (section_is_uniform(section)) {
+			if (section->palette[0] != BLOCK_AIR)
+				column |= get_section_column_mask(i);
+			continue;
+		}
+
+		for (y = i * SECTION_HEIGHT; y < (i + 1) * SECTION_HEIGHT; y++)
+			column |= (uint64_t) (chunk_get_block(chunk, x, y, z) != BLOCK_AIR) << y;
+	}
+
+	return column;
+}
+
+static void
+fill_chunk_columns(struct chunk_columns *columns, const struct chunk *chunk, const struct chunk *const neighbors[4])
+{
+	const struct chunk_section *section;
+	uint8_t blocks[SECTION_VOLUME];
+	uint64_t bit, section_mask;
+	int x, y, z, i;
+
+	memset(columns, 0, sizeof(struct chunk_columns));
+
+	for (i = 0; i < SECTIONS_PER_CHUNK; i++) {
+		section = &chunk->sections[i];
+
+		/* The same bits in every column */
+		if (section_is_uniform(section)) {
+			section_mask = get_section_column_mask(i);
+			for (x = 0; x < CHUNK_WIDTH; x++)
+				for (z = 0; z < CHUNK_WIDTH; z++)
+					columns->types[section->palette[0]][x][z] |= section_mask;
+			continue;
+		}
+
+		section_get_blocks(section, blocks);
+
+		for (y = 0; y < SECTION_HEIGHT; y++) {
+			bit = (uint64_t) 1 << (i * SECTION_HEIGHT + y);
+			for (z = 0; z < CHUNK_WIDTH; z++)
+				for (x = 0; x < CHUNK_WIDTH; x++)
+					columns->types[blocks[block_index(x, y, z)]][x][z] |= bit;
+		}
+	}
+
+	/* Everything that is not air is solid */
+	for (z = 0; z < CHUNK_WIDTH; z++)
+		for (x = 0; x < CHUNK_WIDTH; x++)
+			columns->solid[x + 1][z + 1] = ~columns->types[BLOCK_AIR][x][z];
+
+	for (i = 0; i < CHUNK_WIDTH; i++) {
+		if (neighbors[0])
+			columns->solid[0][i + 1] = get_column_bits(neighbors[0], CHUNK_WIDTH - 1, i);
+		if (neighbors[1])
+			columns->solid[CHUNK_WIDTH + 1][i + 1] = get_column_bits(neighbors[1], 0, i);
+		if (neighbors[2])
+			columns->solid[i + 1][0] = get_column_bits(neighbors[2], i, CHUNK_WIDTH - 1);
+		if (neighbors[3])
+			columns->solid[i + 1][CHUNK_WIDTH + 1] = get_column_bits(neighbors[3], i, 0);
+	}
+}
+
+/* Visible faces of the (x, z) column, the neighbor block of each face is
+ * found by shifting the column itself (y faces) or with the next column */
+static inline uint64_t
+get_face_bits(const struct chunk_columns *columns, int face, int x, int z)
+{
+	uint64_t column = columns->solid[x + 1][z + 1];
+
+	switch (face) {
+	case FACE_NEG_X:
+		return column & ~columns->solid[x][z + 1];
+	case FACE_POS_X:
+		return column & ~columns->solid[x + 2][z + 1];
+	case FACE_NEG_Y:
+		return column & ~(column << 1);
+	case FACE_POS_Y:
+		return column & ~(column >> 1);
+	case FACE_NEG_Z:
+		return column & ~columns->solid[x + 1][z];
+	default:
+		return column & ~columns->solid[x + 1][z + 2];
+	}
+}
+
+/* Greedy merge of a plane stored as `row_count` rows of bits. A run of set
+ * bits is found with bit scans and then grown over the next rows while all
+ * its bits are set there too. The quads are reported as
+ * [first_bit, first_bit + width) x [row, row + height).
+ * */
+static int
+mesh_bit_plane(struct chunk_mesh *mesh, uint64_t *rows, int row_count, int face, int slice, uint8_t layer)
+{
+	int row, first_bit, width, height, axis = face / 2, origin[3];
+	uint64_t run, run_mask;
+
+	for (row = 0; row < row_count; row++) {
+		while (rows[row]) {
+			first_bit = __builtin_ctzll(rows[row]);
+			run = rows[row] >> first_bit;
+			width = ~run ? __builtin_ctzll(~run) : 64;
+			run_mask = (width == 64 ? ~(uint64_t) 0 : ((uint64_t) 1 << width) - 1) << first_bit;
+
+			rows[row] &= ~run_mask;
+			for (height = 1; row + height < row_count && (rows[row + height] & run_mask) == run_mask; height++)
+				rows[row + height] &= ~run_mask;
+
+			origin[axis] = slice + face % 2;
+
+			/* x faces: rows along z and bits along y (u = y, v = z),
+			 * y faces: rows along z and bits along x (u = z, v = x),
+			 * z faces: rows along x and bits along y (u = x, v = y) */
+			if (axis == 0) {
+				origin[1] = first_bit;
+				origin[2] = row;
+				if (add_quad(mesh, face, origin, width, height, layer))
+					return -1;
+			} else {
+				origin[axis == 1 ? 2 : 0] = row;
+				origin[axis == 1 ? 0 : 1] = first_bit;
+				if (add_quad(mesh, face, origin, height, width, layer))
+					return -1;
+			}
+		}
+	}
+
+	return 0;
+}
+
+static int
+mesh_chunk_binary(struct chunk_mesh *mesh, const struct chunk *chunk, const struct chunk *const neighbors[4])
+{
+	uint64_t faces[CHUNK_WIDTH][CHUNK_WIDTH], layer_faces[CHUNK_WIDTH][CHUNK_WIDTH];
+	uint64_t planes[CHUNK_HEIGHT][CHUNK_WIDTH];
+	struct chunk_columns columns;
+	uint32_t layer_types, types;
+	uint64_t type_mask, bits;
+	int face, layer, type, x, y, z;
+	bool any_face;
+
+	fill_chunk_columns(&columns, chunk, neighbors);
+
+	for (face = 0; face < block_face_count; face++) {
+		for (x = 0; x < CHUNK_WIDTH; x++)
+			for (z = 0; z < CHUNK_WIDTH; z++)
+				faces[x][z] = get_face_bits(&columns, face, x, z);
+
+		/* Only faces with the same texture can be merged */
+		for (layer = 0; layer < texture_layer_count; layer++) {
+			layer_types = 0;
+			for (type = BLOCK_AIR + 1; type < block_type_count; type++)
+				if (block_textures[type][face] == layer)
+					layer_types |= 1u << type;
+
+			if (!layer_types)
+				continue;
+
+			any_face = false;
+			for (x = 0; x < CHUNK_WIDTH; x++) {
+				for (z = 0; z < CHUNK_WIDTH; z++) {
+					type_mask = 0;
+					for (types = layer_types; types; types &= types - 1)
+						type_mask |= columns.types[__builtin_ctz(types)][x][z];
+
+					layer_faces[x][z] = faces[x][z] & type_mask;
+					any_face |= layer_faces[x][z] != 0;
+				}
+			}
+
+			if (!any_face)
+				continue;
+
+			switch (face / 2) {
+			case 0:
+				for (x = 0; x < CHUNK_WIDTH; x++)
+					if (mesh_bit_plane(mesh, layer_faces[x], CHUNK_WIDTH, face, x, layer))
+						return -1;
+				break;
+			case 1:
+				/* Transpose the set bits into (z, x) planes, one per y */
+				memset(planes, 0, sizeof(planes));
+				for (x = 0; x < CHUNK_WIDTH; x++) {
+					for (z = 0; z < CHUNK_WIDTH; z++) {
+						for (bits = layer_faces[x][z]; bits; bits &= bits - 1) {
+							y = __builtin_ctzll(bits);
+							planes[y][z] |= (uint64_t) 1 << x;
+						}
+					}
+				}
+
+				for (y = 0; y < CHUNK_HEIGHT; y++)
+					if (mesh_bit_plane(mesh, planes[y], CHUNK_WIDTH, face, y, layer))
+						return -1;
+				break;
+			case 2:
+				for (z = 0; z < CHUNK_WIDTH; z++) {
+					for (x = 0; x < CHUNK_WIDTH; x++)
+						planes[0][x] = layer_faces[x][z];
+					if (mesh_bit_plane(mesh, planes[0], CHUNK_WIDTH, face, z, layer))
+						return -1;
+				}
+				break;
+			}
+		}
+	}
+
+	return 0;
+}
+
+static const char *mesher_names[mesher_type_count] = {
+	[MESHER_NAIVE] = "naive",
+	[MESHER_GREEDY] = "greedy",
+	[MESHER_BINARY] = "binary",
+};
+
+static int (*const meshers[mesher_type_count])(struct chunk_mesh *, const struct chunk *,
+												const struct chunk *const [4]) = {
+	[MESHER_NAIVE] = mesh_chunk_naive,
+	[MESHER_GREEDY] = mesh_chunk_greedy,
+	[MESHER_BINARY] = mesh_chunk_binary,
+};
+
+static enum mesher_type selected_mesher = MESHER_BINARY;
+
+void
+set_mesher_type(enum mesher_type type)
+{
+	selected_mesher = type;
+}
+
+enum mesher_type
+get_mesher_type()
+{
+	return selected_mesher;
+}
+
+const char *
+get_mesher_name(enum mesher_type type)
+{
+	return mesher_names[type];
+}
+
+int
+parse_mesher_type(const char *name, enum mesher_type *type)
+{
+	int i;
+
+	for (i = 0; i < mesher_type_count; i++) {
+		if (!strcmp(name, mesher_names[i])) {
+			*type = i;
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+void
+get_chunk_neighbors(const struct world *world, const struct chunk *chunk, const struct chunk *neighbors[4])
+{
+	neighbors[0] = world_get_chunk(world, chunk->x - 1, chunk->z);
+	neighbors[1] = world_get_chunk(world, chunk->x + 1, chunk->z);
+	neighbors[2] = world_get_chunk(world, chunk->x, chunk->z - 1);
+	neighbors[3] = world_get_chunk(world, chunk->x, chunk->z + 1);
+}
+
+int
+mesh_chunk_with_neighbors(struct chunk_mesh *mesh, const struct chunk *chunk, const struct chunk *const neighbors[4])
+{
+	int i;
+
+	mesh->vertex_count = 0;
+	mesh->index_count = 0;
+
+	/* A chunk of air has no faces, whatever its neighbors are */
+	for (i = 0; i < SECTIONS_PER_CHUNK; i++)
+		if (!section_is_empty(&chunk->sections[i]))
+			break;
+	if (i == SECTIONS_PER_CHUNK)
+		return 0;
+
+	return meshers[selected_mesher](mesh, chunk, neighbors);
+}
+
+int
+mesh_chunk(struct chunk_mesh *mesh, const struct world *world, const struct chunk *chunk)
+{
+	const struct chunk *neighbors[4];
+
+	get_chunk_neighbors(world, chunk, neighbors);
+
+	return mesh_chunk_with_neighbors(mesh, chunk, neighbors);
+}
+
+void
+get_chunk_origin(int32_t x, int32_t z, vec3 origin)
+{
+	origin[0] = x * CHUNK_WIDTH - 0.5f;
+	origin[1] = WORLD_MIN_Y - 0.5f;
+	origin[2] = z * CHUNK_WIDTH - 0.5f;
+}
@@ -0,0 +1,100 @@
+#ifndef MESHER_H
+#define MESHER_H
+
+#include <cglm/cglm.h>
+#include <stdint.h>
+
+#include "game_objects.h"
+#include "world.h"
+
+/* Layers of the block texture array, see `load_block_textures()` */
+enum texture_layer {
+	TEXTURE_STONE_BRICKS = 0,
+	TEXTURE_BRICKS,
+	TEXTURE_GRASS_BLOCK_TOP,
+	TEXTURE_SAND,
+	TEXTURE_COARSE_DIRT,
+	TEXTURE_GRASS_BLOCK_SIDE,
+	texture_layer_count
+};
+
+/* The face of a block pointing to the negative or positive side of an axis */
+enum block_face {
+	FACE_NEG_X = 0,
+	FACE_POS_X,
+	FACE_NEG_Y,
+	FACE_POS_Y,
+	FACE_NEG_Z,
+	FACE_POS_Z,
+	block_face_count
+};
+
+enum mesher_type {
+	/* One quad per visible face */
+	MESHER_NAIVE = 0,
+	/* Visible faces merged slice by slice, block by block */
+	MESHER_GREEDY,
+	/* Visible faces and merges computed with 64 bit block columns */
+	MESHER_BINARY,
+	mesher_type_count
+};
+
+/* Every quad has 4 vertices and 6 indices, the buffers grow as needed and
+ * can be reused for several chunks */
+struct chunk_mesh {
+	struct vertex *vertices;
+	uint32_t *indices;
+	uint32_t vertex_count;
+	uint32_t index_count;
+	uint32_t quad_capacity;
+};
+
+/* Bytes of the vertex and index buffers of the mesh */
+#define get_chunk_mesh_size(mesh) \
+	(sizeof(struct vertex) * (mesh)->vertex_count + sizeof(uint32_t) * (mesh)->index_count)
+
+void
+chunk_mesh_init(struct chunk_mesh *mesh);
+
+void
+chunk_mesh_destroy(struct chunk_mesh *mesh);
+
+/* Select the mesher used by `mesh_chunk()`, the binary one by default.
+ * It is not thread safe, call it before meshing anything. */
+void
+set_mesher_type(enum mesher_type type);
+
+enum mesher_type
+get_mesher_type();
+
+const char *
+get_mesher_name(enum mesher_type type);
+
+/* Returns -1 if the name is unknown */
+int
+parse_mesher_type(const char *name, enum mesher_type *type);
+
+/* Build the mesh of the exposed faces of `chunk`, merging coplanar faces with
+ * the same texture into larger quads (but with the naive mesher). Neighbor
+ * chunks missing from `world` are handled as air. The vertices are in chunk
+ * local coordinates, where the block (x, y, z) goes from (x, y, z) to
+ * (x + 1, y + 1, z + 1).
+ * */
+int
+mesh_chunk(struct chunk_mesh *mesh, const struct world *world, const struct chunk *chunk);
+
+/* The chunks at -x, +x, -z and +z of `chunk`, NULL if not in `world` */
+void
+get_chunk_neighbors(const struct world *world, const struct chunk *chunk, const struct chunk *neighbors[4]);
+
+/* Same as `mesh_chunk()` without looking up the world, so it can run on a
+ * worker thread while the world table changes. */
+int
+mesh_chunk_with_neighbors(struct chunk_mesh *mesh, const struct chunk *chunk, const struct chunk *const neighbors[4]);
+
+/* World position of the chunk mesh origin, blocks are centered at their
+ * integer coordinates */
+void
+get_chunk_origin(int32_t x, int32_t z, vec3 origin);
+
+#endif //MESHER_H
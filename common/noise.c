@@ -0,0 +1,369 @@
+#include <immintrin.h>
+#include <stdalign.h>
+#include <math.h>
+
+#define FNL_IMPL
+#include "cpu_dispatch.h"
+#include "noise.h"
+
+/* All the constants bellow are written exactly as in `_fnlSingleSimplex2D()`
+ * and `_fnlTransformNoiseCoordinate2D()`, so they round to the same floats */
+#define SQRT3 1.7320508075688772935274463415059f
+#define F2 (0.5f * (SQRT3 - 1))
+#define G2 ((3 - SQRT3) / 6)
+#define C_T ((float) (2 * (1 - 2 * G2) * (1 / G2 - 2)))
+#define C_A ((float) (-2 * (1 - 2 * G2) * (1 - 2 * G2)))
+#define SIMPLEX_2D_SCALE 99.83685446303647f
+#define HASH_MULTIPLIER 0x27d4eb2d
+#define GRADIENT_MASK (127 << 1)
+
+void
+noise_row_scalar(fnl_state *noise, int x, int z, int count, float scale, int *heights)
+{
+	int i;
+
+	for (i = 0; i < count; i++)
+		heights[i] = roundf(scale * fnlGetNoise2D(noise, x + i, z));
+}
+
+/* `_fnlFastFloor()`: (int)f, minus one for negative values (even integers) */
+#define FAST_FLOOR(bits, f) \
+	_mm##bits##_add_epi32(_mm##bits##_cvttps_epi32(f), \
+						  _mm##bits##_castps_si##bits(_mm##bits##_cmp_ps(f, _mm##bits##_setzero_ps(), _CMP_LT_OQ)))
+
+__attribute__((target("avx2")))
+static inline __m256
+grad_coord_avx2(__m256i seed, __m256i x_primed, __m256i y_primed, __m256 xd, __m256 yd)
+{
+	__m256i hash = _mm256_xor_si256(seed, _mm256_xor_si256(x_primed, y_primed));
+	__m256 x_gradient, y_gradient;
+
+	hash = _mm256_mullo_epi32(hash, _mm256_set1_epi32(HASH_MULTIPLIER));
+	hash = _mm256_xor_si256(hash, _mm256_srai_epi32(hash, 15));
+	hash = _mm256_and_si256(hash, _mm256_set1_epi32(GRADIENT_MASK));
+
+	x_gradient = _mm256_i32gather_ps(GRADIENTS_2D, hash, sizeof(float));
+	y_gradient = _mm256_i32gather_ps(GRADIENTS_2D, _mm256_or_si256(hash, _mm256_set1_epi32(1)), sizeof(float));
+
+	return _mm256_add_ps(_mm256_mul_ps(xd, x_gradient), _mm256_mul_ps(yd, y_gradient));
+}
+
+/* (a * a) * (a * a) * gradient, or zero where a <= 0 */
+__attribute__((target("avx2")))
+static inline __m256
+falloff_avx2(__m256 a, __m256 gradient)
+{
+	__m256 a2 = _mm256_mul_ps(a, a);
+	__m256 value = _mm256_mul_ps(_mm256_mul_ps(a2, a2), gradient);
+
+	return _mm256_and_ps(value, _mm256_cmp_ps(a, _mm256_setzero_ps(), _CMP_GT_OQ));
+}
+
+/* Half away from zero rounding like roundf(), _mm256_round_ps() rounds half to even */
+__attribute__((target("avx2")))
+static inline __m256i
+round_avx2(__m256 value)
+{
+	__m256 sign_mask = _mm256_set1_ps(-0.0f);
+	__m256 truncated = _mm256_round_ps(value, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+	__m256 fraction = _mm256_andnot_ps(sign_mask, _mm256_sub_ps(value, truncated));
+	__m256 one = _mm256_or_ps(_mm256_set1_ps(1.0f), _mm256_and_ps(value, sign_mask));
+	__m256 round_up = _mm256_cmp_ps(fraction, _mm256_set1_ps(0.5f), _CMP_GE_OQ);
+
+	return _mm256_cvttps_epi32(_mm256_add_ps(truncated, _mm256_and_ps(one, round_up)));
+}
+
+__attribute__((target("avx2")))
+void
+noise_row_avx2(fnl_state *noise, int x, int z, int count, float scale, int *heights)
+{
+	const __m256i prime_x = _mm256_set1_epi32(PRIME_X), prime_y = _mm256_set1_epi32(PRIME_Y);
+	const __m256i lane_offsets = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	const __m256i seed = _mm256_set1_epi32(noise->seed);
+	const __m256 frequency = _mm256_set1_ps(noise->frequency);
+	const __m256 half = _mm256_set1_ps(0.5f);
+	const __m256 g2 = _mm256_set1_ps(G2);
+	const __m256 g2_minus_one = _mm256_set1_ps((float) G2 - 1);
+	const __m256 z_row = _mm256_set1_ps((float) z);
+	__m256 xs, ys, t, xi, yi, x0, y0, x1, y1, x2, y2, a, b, c, n0, n1, n2, value;
+	__m256i i, j, i1, j1, upper;
+	int lane = 0;
+
+	for (; lane + 8 <= count; lane += 8) {
+		/* _fnlTransformNoiseCoordinate2D() */
+		xs = _mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_set1_epi32(x + lane), lane_offsets));
+		xs = _mm256_mul_ps(xs, frequency);
+		ys = _mm256_mul_ps(z_row, frequency);
+		t = _mm256_mul_ps(_mm256_add_ps(xs, ys), _mm256_set1_ps(F2));
+		xs = _mm256_add_ps(xs, t);
+		ys = _mm256_add_ps(ys, t);
+
+		/* _fnlSingleSimplex2D() */
+		i = FAST_FLOOR(256, xs);
+		j = FAST_FLOOR(256, ys);
+		xi = _mm256_sub_ps(xs, _mm256_cvtepi32_ps(i));
+		yi = _mm256_sub_ps(ys, _mm256_cvtepi32_ps(j));
+
+		t = _mm256_mul_ps(_mm256_add_ps(xi, yi), g2);
+		x0 = _mm256_sub_ps(xi, t);
+		y0 = _mm256_sub_ps(yi, t);
+
+		i = _mm256_mullo_epi32(i, prime_x);
+		j = _mm256_mullo_epi32(j, prime_y);
+
+		a = _mm256_sub_ps(_mm256_sub_ps(half, _mm256_mul_ps(x0, x0)), _mm256_mul_ps(y0, y0));
+		n0 = falloff_avx2(a, grad_coord_avx2(seed, i, j, x0, y0));
+
+		c = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(C_T), t), _mm256_add_ps(_mm256_set1_ps(C_A), a));
+		x2 = _mm256_add_ps(x0, _mm256_set1_ps(2 * (float) G2 - 1));
+		y2 = _mm256_add_ps(y0, _mm256_set1_ps(2 * (float) G2 - 1));
+		n2 = falloff_avx2(c, grad_coord_avx2(seed, _mm256_add_epi32(i, prime_x),
+											 _mm256_add_epi32(j, prime_y), x2, y2));
+
+		/* Both branches of `y0 > x0` are evaluated and blended */
+		upper = _mm256_castps_si256(_mm256_cmp_ps(y0, x0, _CMP_GT_OQ));
+		x1 = _mm256_add_ps(x0, _mm256_blendv_ps(g2_minus_one, g2, _mm256_castsi256_ps(upper)));
+		y1 = _mm256_add_ps(y0, _mm256_blendv_ps(g2, g2_minus_one, _mm256_castsi256_ps(upper)));
+		i1 = _mm256_add_epi32(i, _mm256_andnot_si256(upper, prime_x));
+		j1 = _mm256_add_epi32(j, _mm256_and_si256(upper, prime_y));
+		b = _mm256_sub_ps(_mm256_sub_ps(half, _mm256_mul_ps(x1, x1)), _mm256_mul_ps(y1, y1));
+		n1 = falloff_avx2(b, grad_coord_avx2(seed, i1, j1, x1, y1));
+
+		value = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(n0, n1), n2), _mm256_set1_ps(SIMPLEX_2D_SCALE));
+		value = _mm256_mul_ps(_mm256_set1_ps(scale), value);
+
+		_mm256_storeu_si256((__m256i *) &heights[lane], round_avx2(value));
+	}
+
+	noise_row_scalar(noise, x + lane, z, count - lane, scale, &heights[lane]);
+}
+
+/* SSE4.1 has no gather, the gradients are fetched lane by lane */
+__attribute__((target("sse4.1")))
+static inline __m128
+grad_coord_sse41(__m128i seed, __m128i x_primed, __m128i y_primed, __m128 xd, __m128 yd)
+{
+	__m128i hash = _mm_xor_si128(seed, _mm_xor_si128(x_primed, y_primed));
+	__m128 x_gradient, y_gradient;
+	alignas(16) int index[4];
+
+	hash = _mm_mullo_epi32(hash, _mm_set1_epi32(HASH_MULTIPLIER));
+	hash = _mm_xor_si128(hash, _mm_srai_epi32(hash, 15));
+	hash = _mm_and_si128(hash, _mm_set1_epi32(GRADIENT_MASK));
+	_mm_store_si128((__m128i *) index, hash);
+
+	x_gradient = _mm_setr_ps(GRADIENTS_2D[index[0]], GRADIENTS_2D[index[1]],
+							 GRADIENTS_2D[index[2]], GRADIENTS_2D[index[3]]);
+	y_gradient = _mm_setr_ps(GRADIENTS_2D[index[0] | 1], GRADIENTS_2D[index[1] | 1],
+							 GRADIENTS_2D[index[2] | 1], GRADIENTS_2D[index[3] | 1]);
+
+	return _mm_add_ps(_mm_mul_ps(xd, x_gradient), _mm_mul_ps(yd, y_gradient));
+}
+
+__attribute__((target("sse4.1")))
+static inline __m128
+falloff_sse41(__m128 a, __m128 gradient)
+{
+	__m128 a2 = _mm_mul_ps(a, a);
+	__m128 value = _mm_mul_ps(_mm_mul_ps(a2, a2), gradient);
+
+	return _mm_and_ps(value, _mm_cmpgt_ps(a, _mm_setzero_ps()));
+}
+
+__attribute__((target("sse4.1")))
+static inline __m128i
+round_sse41(__m128 value)
+{
+	__m128 sign_mask = _mm_set1_ps(-0.0f);
+	__m128 truncated = _mm_round_ps(value, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+	__m128 fraction = _mm_andnot_ps(sign_mask, _mm_sub_ps(value, truncated));
+	__m128 one = _mm_or_ps(_mm_set1_ps(1.0f), _mm_and_ps(value, sign_mask));
+	__m128 round_up = _mm_cmpge_ps(fraction, _mm_set1_ps(0.5f));
+
+	return _mm_cvttps_epi32(_mm_add_ps(truncated, _mm_and_ps(one, round_up)));
+}
+
+__attribute__((target("sse4.1")))
+void
+noise_row_sse41(fnl_state *noise, int x, int z, int count, float scale, int *heights)
+{
+	const __m128i prime_x = _mm_set1_epi32(PRIME_X), prime_y = _mm_set1_epi32(PRIME_Y);
+	const __m128i lane_offsets = _mm_setr_epi32(0, 1, 2, 3);
+	const __m128i seed = _mm_set1_epi32(noise->seed);
+	const __m128 frequency = _mm_set1_ps(noise->frequency);
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 g2 = _mm_set1_ps(G2);
+	const __m128 g2_minus_one = _mm_set1_ps((float) G2 - 1);
+	const __m128 z_row = _mm_set1_ps((float) z);
+	__m128 xs, ys, t, xi, yi, x0, y0, x1, y1, x2, y2, a, b, c, n0, n1, n2, value;
+	__m128i i, j, i1, j1, upper;
+	int lane = 0;
+
+	for (; lane + 4 <= count; lane += 4) {
+		xs = _mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32(x + lane), lane_offsets));
+		xs = _mm_mul_ps(xs, frequency);
+		ys = _mm_mul_ps(z_row, frequency);
+		t = _mm_mul_ps(_mm_add_ps(xs, ys), _mm_set1_ps(F2));
+		xs = _mm_add_ps(xs, t);
+		ys = _mm_add_ps(ys, t);
+
+		i = _mm_add_epi32(_mm_cvttps_epi32(xs), _mm_castps_si128(_mm_cmplt_ps(xs, _mm_setzero_ps())));
+		j = _mm_add_epi32(_mm_cvttps_epi32(ys), _mm_castps_si128(_mm_cmplt_ps(ys, _mm_setzero_ps())));
+		xi = _mm_sub_ps(xs, _mm_cvtepi32_ps(i));
+		yi = _mm_sub_ps(ys, _mm_cvtepi32_ps(j));
+
+		t = _mm_mul_ps(_mm_add_ps(xi, yi), g2);
+		x0 = _mm_sub_ps(xi, t);
+		y0 = _mm_sub_ps(yi, t);
+
+		i = _mm_mullo_epi32(i, prime_x);
+		j = _mm_mullo_epi32(j, prime_y);
+
+		a = _mm_sub_ps(_mm_sub_ps(half, _mm_mul_ps(x0, x0)), _mm_mul_ps(y0, y0));
+		n0 = falloff_sse41(a, grad_coord_sse41(seed, i, j, x0, y0));
+
+		c = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(C_T), t), _mm_add_ps(_mm_set1_ps(C_A), a));
+		x2 = _mm_add_ps(x0, _mm_set1_ps(2 * (float) G2 - 1));
+		y2 = _mm_add_ps(y0, _mm_set1_ps(2 * (float) G2 - 1));
+		n2 = falloff_sse41(c, grad_coord_sse41(seed, _mm_add_epi32(i, prime_x), _mm_add_epi32(j, prime_y), x2, y2));
+
+		upper = _mm_castps_si128(_mm_cmpgt_ps(y0, x0));
+		x1 = _mm_add_ps(x0, _mm_blendv_ps(g2_minus_one, g2, _mm_castsi128_ps(upper)));
+		y1 = _mm_add_ps(y0, _mm_blendv_ps(g2, g2_minus_one, _mm_castsi128_ps(upper)));
+		i1 = _mm_add_epi32(i, _mm_andnot_si128(upper, prime_x));
+		j1 = _mm_add_epi32(j, _mm_and_si128(upper, prime_y));
+		b = _mm_sub_ps(_mm_sub_ps(half, _mm_mul_ps(x1, x1)), _mm_mul_ps(y1, y1));
+		n1 = falloff_sse41(b, grad_coord_sse41(seed, i1, j1, x1, y1));
+
+		value = _mm_mul_ps(_mm_add_ps(_mm_add_ps(n0, n1), n2), _mm_set1_ps(SIMPLEX_2D_SCALE));
+		value = _mm_mul_ps(_mm_set1_ps(scale), value);
+
+		_mm_storeu_si128((__m128i *) &heights[lane], round_sse41(value));
+	}
+
+	noise_row_scalar(noise, x + lane, z, count - lane, scale, &heights[lane]);
+}
+
+/* AVX-512 has no float logic without DQ, lanes are selected with masks.
+ * The avx512f target implies FMA, contracting the multiplications and the
+ * additions would change the rounding of the scalar version */
+#define AVX512_KERNEL __attribute__((target("avx512f"), optimize("fp-contract=off")))
+
+AVX512_KERNEL
+static inline __m512
+grad_coord_avx512(__m512i seed, __m512i x_primed, __m512i y_primed, __m512 xd, __m512 yd)
+{
+	__m512i hash = _mm512_xor_si512(seed, _mm512_xor_si512(x_primed, y_primed));
+	__m512 x_gradient, y_gradient;
+
+	hash = _mm512_mullo_epi32(hash, _mm512_set1_epi32(HASH_MULTIPLIER));
+	hash = _mm512_xor_si512(hash, _mm512_srai_epi32(hash, 15));
+	hash = _mm512_and_si512(hash, _mm512_set1_epi32(GRADIENT_MASK));
+
+	x_gradient = _mm512_i32gather_ps(hash, GRADIENTS_2D, sizeof(float));
+	y_gradient = _mm512_i32gather_ps(_mm512_or_si512(hash, _mm512_set1_epi32(1)), GRADIENTS_2D, sizeof(float));
+
+	return _mm512_add_ps(_mm512_mul_ps(xd, x_gradient), _mm512_mul_ps(yd, y_gradient));
+}
+
+AVX512_KERNEL
+static inline __m512
+falloff_avx512(__m512 a, __m512 gradient)
+{
+	__m512 a2 = _mm512_mul_ps(a, a);
+	__mmask16 positive = _mm512_cmp_ps_mask(a, _mm512_setzero_ps(), _CMP_GT_OQ);
+
+	return _mm512_maskz_mul_ps(positive, _mm512_mul_ps(a2, a2), gradient);
+}
+
+AVX512_KERNEL
+static inline __m512i
+round_avx512(__m512 value)
+{
+	__m512i sign = _mm512_and_si512(_mm512_castps_si512(value), _mm512_set1_epi32(0x80000000));
+	__m512 one = _mm512_castsi512_ps(_mm512_or_si512(_mm512_castps_si512(_mm512_set1_ps(1.0f)), sign));
+	__m512 truncated = _mm512_roundscale_ps(value, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+	__m512 fraction = _mm512_abs_ps(_mm512_sub_ps(value, truncated));
+	__mmask16 round_up = _mm512_cmp_ps_mask(fraction, _mm512_set1_ps(0.5f), _CMP_GE_OQ);
+
+	return _mm512_cvttps_epi32(_mm512_mask_add_ps(truncated, round_up, truncated, one));
+}
+
+AVX512_KERNEL
+void
+noise_row_avx512(fnl_state *noise, int x, int z, int count, float scale, int *heights)
+{
+	const __m512i prime_x = _mm512_set1_epi32(PRIME_X), prime_y = _mm512_set1_epi32(PRIME_Y);
+	const __m512i lane_offsets = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+	const __m512i seed = _mm512_set1_epi32(noise->seed);
+	const __m512 frequency = _mm512_set1_ps(noise->frequency);
+	const __m512 half = _mm512_set1_ps(0.5f);
+	const __m512 g2 = _mm512_set1_ps(G2);
+	const __m512 g2_minus_one = _mm512_set1_ps((float) G2 - 1);
+	const __m512 z_row = _mm512_set1_ps((float) z);
+	__m512 xs, ys, t, xi, yi, x0, y0, x1, y1, x2, y2, a, b, c, n0, n1, n2, value;
+	__mmask16 negative, upper;
+	__m512i i, j, i1, j1;
+	int lane = 0;
+
+	for (; lane + 16 <= count; lane += 16) {
+		xs = _mm512_cvtepi32_ps(_mm512_add_epi32(_mm512_set1_epi32(x + lane), lane_offsets));
+		xs = _mm512_mul_ps(xs, frequency);
+		ys = _mm512_mul_ps(z_row, frequency);
+		t = _mm512_mul_ps(_mm512_add_ps(xs, ys), _mm512_set1_ps(F2));
+		xs = _mm512_add_ps(xs, t);
+		ys = _mm512_add_ps(ys, t);
+
+		negative = _mm512_cmp_ps_mask(xs, _mm512_setzero_ps(), _CMP_LT_OQ);
+		i = _mm512_mask_sub_epi32(_mm512_cvttps_epi32(xs), negative, _mm512_cvttps_epi32(xs), _mm512_set1_epi32(1));
+		negative = _mm512_cmp_ps_mask(ys, _mm512_setzero_ps(), _CMP_LT_OQ);
+		j = _mm512_mask_sub_epi32(_mm512_cvttps_epi32(ys), negative, _mm512_cvttps_epi32(ys), _mm512_set1_epi32(1));
+		xi = _mm512_sub_ps(xs, _mm512_cvtepi32_ps(i));
+		yi = _mm512_sub_ps(ys, _mm512_cvtepi32_ps(j));
+
+		t = _mm512_mul_ps(_mm512_add_ps(xi, yi), g2);
+		x0 = _mm512_sub_ps(xi, t);
+		y0 = _mm512_sub_ps(yi, t);
+
+		i = _mm512_mullo_epi32(i, prime_x);
+		j = _mm512_mullo_epi32(j, prime_y);
+
+		a = _mm512_sub_ps(_mm512_sub_ps(half, _mm512_mul_ps(x0, x0)), _mm512_mul_ps(y0, y0));
+		n0 = falloff_avx512(a, grad_coord_avx512(seed, i, j, x0, y0));
+
+		c = _mm512_add_ps(_mm512_mul_ps(_mm512_set1_ps(C_T), t), _mm512_add_ps(_mm512_set1_ps(C_A), a));
+		x2 = _mm512_add_ps(x0, _mm512_set1_ps(2 * (float) G2 - 1));
+		y2 = _mm512_add_ps(y0, _mm512_set1_ps(2 * (float) G2 - 1));
+		n2 = falloff_avx512(c, grad_coord_avx512(seed, _mm512_add_epi32(i, prime_x),
+												 _mm512_add_epi32(j, prime_y), x2, y2));
+
+		upper = _mm512_cmp_ps_mask(y0, x0, _CMP_GT_OQ);
+		x1 = _mm512_add_ps(x0, _mm512_mask_blend_ps(upper, g2_minus_one, g2));
+		y1 = _mm512_add_ps(y0, _mm512_mask_blend_ps(upper, g2, g2_minus_one));
+		i1 = _mm512_mask_add_epi32(i, ~upper, i, prime_x);
+		j1 = _mm512_mask_add_epi32(j, upper, j, prime_y);
+		b = _mm512_sub_ps(_mm512_sub_ps(half, _mm512_mul_ps(x1, x1)), _mm512_mul_ps(y1, y1));
+		n1 = falloff_avx512(b, grad_coord_avx512(seed, i1, j1, x1, y1));
+
+		value = _mm512_mul_ps(_mm512_add_ps(_mm512_add_ps(n0, n1), n2), _mm512_set1_ps(SIMPLEX_2D_SCALE));
+		value = _mm512_mul_ps(_mm512_set1_ps(scale), value);
+
+		_mm512_storeu_si512(&heights[lane], round_avx512(value));
+	}
+
+	noise_row_avx2(noise, x + lane, z, count - lane, scale, &heights[lane]);
+}
+
+void
+get_noise_heightmap(fnl_state *noise, int x0, int z0, int width, int depth, float scale, int *heights)
+{
+	noise_row_kernel noise_row = noise_row_scalar;
+	int z;
+
+	/* The kernels only implement the default noise of fnlCreateState() */
+	if (noise->noise_type == FNL_NOISE_OPENSIMPLEX2 && noise->fractal_type == FNL_FRACTAL_NONE)
+		noise_row = cpu_kernels.noise_row;
+
+	for (z = 0; z < depth; z++)
+		noise_row(noise, x0, z0 + z, width, scale, &heights[z * width]);
+}
@@ -0,0 +1,30 @@
+#ifndef NOISE_H
+#define NOISE_H
+
+#include "FastNoise/FastNoiseLite.h"
+
+/* Batch version of `roundf(scale * fnlGetNoise2D(noise, x, z))`, it fills
+ * heights[z * width + x] for the width x depth tile starting at (x0, z0).
+ * The default OpenSimplex2 noise without fractal is evaluated with the SIMD
+ * kernel of the host and gives the same result as the scalar version.
+ * */
+void
+get_noise_heightmap(fnl_state *noise, int x0, int z0, int width, int depth, float scale, int *heights);
+
+/* Heightmap row kernels, `get_noise_heightmap()` uses the one selected by
+ * `init_cpu_dispatch()` */
+typedef void (*noise_row_kernel)(fnl_state *noise, int x, int z, int count, float scale, int *heights);
+
+void
+noise_row_scalar(fnl_state *noise, int x, int z, int count, float scale, int *heights);
+
+void
+noise_row_sse41(fnl_state *noise, int x, int z, int count, float scale, int *heights);
+
+void
+noise_row_avx2(fnl_state *noise, int x, int z, int count, float scale, int *heights);
+
+void
+noise_row_avx512(fnl_state *noise, int x, int z, int count, float scale, int *heights);
+
+#endif //NOISE_H
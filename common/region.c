@@ -0,0 +1,615 @@
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+
+#include "region.h"
+#include "utils.h"
+
+#define LEVEL_MAGIC 0x4c435243 /* "CRCL" */
+#define LEVEL_VERSION 1
+#define LEVEL_FILE_NAME "level.dat"
+/* Header and one run per block, the worst case */
+#define MAX_PAYLOAD_SIZE (sizeof(struct payload_header) + sizeof(struct block_run) * SECTION_VOLUME * SECTIONS_PER_CHUNK)
+#define INITIAL_REGION_CAPACITY 16
+#define INITIAL_USED_SECTORS_CAPACITY 64
+
+#define get_sector_count(size) (((size) + REGION_SECTOR_SIZE - 1) / REGION_SECTOR_SIZE)
+#define is_sector_used(region, sector) (((region)->used_sectors[(sector) / 64] >> (sector) % 64) & 1)
+/* A corrupted table entry may point anywhere */
+#define is_sector_run_valid(region, first, count) \
+	((first) >= REGION_HEADER_SECTORS && (first) <= (region)->sector_count && \
+	 (count) <= (region)->sector_count - (first))
+
+struct level_header {
+	uint32_t magic;
+	uint32_t version;
+	int32_t seed;
+};
+
+struct payload_header {
+	int32_t x;
+	int32_t z;
+};
+
+/* The chunk blocks are run length encoded, in the section and then block
+ * order of `struct chunk`. A run never crosses the end of the chunk. */
+struct block_run {
+	uint8_t block;
+	uint8_t length[2];
+};
+
+static char *
+get_path(const char *directory, const char *file_name)
+{
+	char *path;
+	size_t size;
+
+	size = strlen(directory) + strlen(file_name) + 2;
+	path = malloc(size);
+	if (!path) {
+		print_error("Failed to allocate path!");
+		return NULL;
+	}
+
+	snprintf(path, size, "%s/%s", directory, file_name);
+
+	return path;
+}
+
+int
+open_level(const char *directory, int *seed)
+{
+	struct level_header header;
+	char *path;
+	FILE *file;
+	int ret = -1;
+
+	if (mkdir(directory, 0755) && errno != EEXIST) {
+		pprint_error("Failed to create the world directory '%s'", directory);
+		return -1;
+	}
+
+	path = get_path(directory, LEVEL_FILE_NAME);
+	if (!path)
+		return -1;
+
+	file = fopen(path, "rb");
+	if (file) {
+		if (fread(&header, sizeof(header), 1, file) != 1 || header.magic != LEVEL_MAGIC ||
+			header.version != LEVEL_VERSION) {
+			pprint_error("'%s' is not a valid level file", path);
+			goto close_file;
+		}
+
+		*seed = header.seed;
+		ret = 0;
+		goto close_file;
+	}
+
+	file = fopen(path, "wb");
+	if (!file) {
+		pprint_error("Failed to create '%s'", path);
+		goto free_path;
+	}
+
+	header = (struct level_header) { .magic = LEVEL_MAGIC, .version = LEVEL_VERSION, .seed = *seed };
+	if (fwrite(&header, sizeof(header), 1, file) != 1) {
+		pprint_error("Failed to write '%s'", path);
+		goto close_file;
+	}
+
+	ret = 0;
+
+close_file:
+	fclose(file);
+free_path:
+	free(path);
+	return ret;
+}
+
+int
+region_store_init(struct region_store *store, const char *directory)
+{
+	memset(store, 0, sizeof(struct region_store));
+
+	store->directory = strdup(directory);
+	if (!store->directory) {
+		print_error("Failed to allocate the world directory name!");
+		return -1;
+	}
+
+	if (pthread_mutex_init(&store->lock, NULL)) {
+		print_error("Failed to create the region store lock!");
+		free(store->directory);
+		return -1;
+	}
+
+	return 0;
+}
+
+static void
+close_region(struct region *region)
+{
+	if (region->map)
+		munmap((void *) region->map, region->map_size);
+	pthread_rwlock_destroy(&region->lock);
+	if (region->fd >= 0)
+		close(region->fd);
+	free(region->used_sectors);
+	free(region);
+}
+
+void
+region_store_destroy(struct region_store *store)
+{
+	uint32_t i;
+
+	for (i = 0; i < store->region_count; i++)
+		close_region(store->regions[i]);
+
+	pthread_mutex_destroy(&store->lock);
+	free(store->regions);
+	free(store->directory);
+	memset(store, 0, sizeof(struct region_store));
+}
+
+/* Map the whole file again, the caller holds the write lock */
+static int
+map_region(struct region *region)
+{
+	size_t size = (size_t) region->sector_count * REGION_SECTOR_SIZE;
+	void *map;
+
+	map = mmap(NULL, size, PROT_READ, MAP_SHARED, region->fd, 0);
+	if (map == MAP_FAILED) {
+		pprint_error("Failed to map the region (%d, %d)", region->x, region->z);
+		return -1;
+	}
+
+	if (region->map)
+		munmap((void *) region->map, region->map_size);
+
+	region->map = map;
+	region->map_size = size;
+
+	return 0;
+}
+
+static int
+grow_used_sectors(struct region *region, uint32_t sector_count)
+{
+	uint32_t capacity = region->used_sectors_capacity ? region->used_sectors_capacity : INITIAL_USED_SECTORS_CAPACITY;
+	uint64_t *used_sectors;
+
+	if (sector_count <= region->used_sectors_capacity)
+		return 0;
+
+	while (capacity < sector_count)
+		capacity *= 2;
+
+	used_sectors = realloc(region->used_sectors, capacity / 8);
+	if (!used_sectors) {
+		print_error("Failed to grow the used sectors bitmap!");
+		return -1;
+	}
+
+	memset(used_sectors + region->used_sectors_capacity / 64, 0, (capacity - region->used_sectors_capacity) / 8);
+	region->used_sectors = used_sectors;
+	region->used_sectors_capacity = capacity;
+
+	return 0;
+}
+
+static void
+mark_sectors(struct region *region, uint32_t first, uint32_t count, bool used)
+{
+	uint32_t i;
+
+	for (i = first; i < first + count; i++) {
+		if (used)
+			region->used_sectors[i / 64] |= 1ull << i % 64;
+		else
+			region->used_sectors[i / 64] &= ~(1ull << i % 64);
+	}
+}
+
+/* Sectors no table entry points to, left by overwritten chunks or by a
+ * save a crash interrupted, are free */
+static int
+init_used_sectors(struct region *region)
+{
+	const struct region_entry *entry;
+	uint32_t i, count;
+
+	if (grow_used_sectors(region, region->sector_count))
+		return -1;
+
+	mark_sectors(region, 0, REGION_HEADER_SECTORS, true);
+
+	for (i = 0; i < REGION_CHUNK_COUNT; i++) {
+		entry = &region->table[i];
+		count = get_sector_count(entry->size);
+		if (entry->sector && is_sector_run_valid(region, entry->sector, count))
+			mark_sectors(region, entry->sector, count, true);
+	}
+
+	return 0;
+}
+
+/* First fit, the file grows when no free run is long enough. Returns 0 if
+ * the file could not grow. The caller holds the write lock. */
+static uint32_t
+allocate_sectors(struct region *region, uint32_t count)
+{
+	uint32_t first = REGION_HEADER_SECTORS, i;
+
+	for (i = first; i < region->sector_count && i - first < count; i++)
+		if (is_sector_used(region, i))
+			first = i + 1;
+
+	if (first + count > region->sector_count) {
+		if (grow_used_sectors(region, first + count) ||
+			ftruncate(region->fd, (off_t) (first + count) * REGION_SECTOR_SIZE))
+			return 0;
+
+		region->sector_count = first + count;
+	}
+
+	mark_sectors(region, first, count, true);
+
+	return first;
+}
+
+static struct region *
+create_region(int32_t x, int32_t z)
+{
+	struct region *region;
+
+	region = calloc(1, sizeof(struct region));
+	if (!region) {
+		print_error("Failed to allocate region!");
+		return NULL;
+	}
+
+	region->x = x;
+	region->z = z;
+	region->fd = -1;
+
+	if (pthread_rwlock_init(&region->lock, NULL)) {
+		print_error("Failed to create the region lock!");
+		free(region);
+		return NULL;
+	}
+
+	return region;
+}
+
+/* Returns 1 if the region has no file and `create` is false. The caller
+ * holds the write lock of the region, or is the only one to know it. */
+static int
+open_region_file(const char *directory, struct region *region, bool create)
+{
+	char file_name[64];
+	struct stat info;
+	char *path;
+	int ret = -1;
+
+	snprintf(file_name, sizeof(file_name), "r.%d.%d.region", region->x, region->z);
+	path = get_path(directory, file_name);
+	if (!path)
+		return -1;
+
+	region->fd = open(path, O_RDWR | (create ? O_CREAT : 0), 0644);
+	if (region->fd < 0) {
+		/* Nothing was saved in this region yet */
+		if (!create && errno == ENOENT)
+			ret = 1;
+		else
+			pprint_error("Failed to open the region file '%s'", path);
+		goto free_path;
+	}
+
+	if (fstat(region->fd, &info))
+		goto close_file;
+
+	/* A new file, the table is all zeroes */
+	if (info.st_size < (off_t) (REGION_HEADER_SECTORS * REGION_SECTOR_SIZE) &&
+		ftruncate(region->fd, REGION_HEADER_SECTORS * REGION_SECTOR_SIZE))
+		goto close_file;
+
+	if (pread(region->fd, region->table, sizeof(region->table), 0) != sizeof(region->table))
+		goto close_file;
+
+	region->sector_count = max((size_t) info.st_size, REGION_HEADER_SECTORS * REGION_SECTOR_SIZE) / REGION_SECTOR_SIZE;
+
+	if (init_used_sectors(region))
+		goto close_file;
+
+	if (map_region(region))
+		goto close_file;
+
+	free(path);
+
+	return 0;
+
+close_file:
+	pprint_error("Failed to read the region file '%s'", path);
+	close(region->fd);
+	region->fd = -1;
+	/* Without a file the region is empty */
+	memset(region->table, 0, sizeof(region->table));
+	region->sector_count = 0;
+free_path:
+	free(path);
+	return ret;
+}
+
+/* A region without a file is kept too, so a missing file is only looked
+ * for once. Loads find it empty, the first save creates the file. Returns
+ * NULL if the region can not be allocated, or if `create` is true and its
+ * file can not be opened. */
+static struct region *
+get_region(struct region_store *store, int32_t x, int32_t z, bool create)
+{
+	struct region **regions, *region = NULL;
+	uint32_t i, capacity;
+	int ret;
+
+	pthread_mutex_lock(&store->lock);
+
+	for (i = 0; i < store->region_count; i++) {
+		if (store->regions[i]->x == x && store->regions[i]->z == z) {
+			region = store->regions[i];
+			goto open_file;
+		}
+	}
+
+	if (store->region_count == store->region_capacity) {
+		capacity = store->region_capacity ? store->region_capacity * 2 : INITIAL_REGION_CAPACITY;
+		regions = realloc(store->regions, sizeof(struct region *) * capacity);
+		if (!regions) {
+			print_error("Failed to grow the regions vector!");
+			goto unlock;
+		}
+
+		store->regions = regions;
+		store->region_capacity = capacity;
+	}
+
+	region = create_region(x, z);
+	if (!region)
+		goto unlock;
+
+	store->regions[store->region_count++] = region;
+
+	/* Nobody else knows the region yet */
+	if (!create) {
+		open_region_file(store->directory, region, false);
+		goto unlock;
+	}
+
+open_file:
+	/* The loads may be reading the empty table */
+	if (create && region->fd < 0) {
+		pthread_rwlock_wrlock(&region->lock);
+		ret = open_region_file(store->directory, region, true);
+		pthread_rwlock_unlock(&region->lock);
+		if (ret)
+			region = NULL;
+	}
+
+unlock:
+	pthread_mutex_unlock(&store->lock);
+	return region;
+}
+
+static uint32_t
+get_region_index(const struct chunk *chunk)
+{
+	return (chunk->x & (REGION_WIDTH - 1)) * REGION_WIDTH + (chunk->z & (REGION_WIDTH - 1));
+}
+
+static int
+decode_chunk(struct chunk *chunk, const uint8_t *payload, uint32_t size)
+{
+	uint32_t offset, length, count, section = 0, block = 0;
+	uint8_t blocks[SECTION_VOLUME];
+	struct payload_header header;
+	struct block_run run;
+
+	if (size < sizeof(header))
+		return -1;
+
+	memcpy(&header, payload, sizeof(header));
+	if (header.x != chunk->x || header.z != chunk->z)
+		return -1;
+
+	for (offset = sizeof(header); offset + sizeof(run) <= size; offset += sizeof(run)) {
+		memcpy(&run, payload + offset, sizeof(run));
+		length = run.length[0] | run.length[1] << 8;
+
+		while (length) {
+			if (section == SECTIONS_PER_CHUNK)
+				return -1;
+
+			/* A run covering a whole section needs no blocks */
+			if (!block && length >= SECTION_VOLUME) {
+				section_fill(&chunk->sections[section++], run.block);
+				length -= SECTION_VOLUME;
+				continue;
+			}
+
+			/* Runs can cross sections */
+			count = min(length, SECTION_VOLUME - block);
+			memset(blocks + block, run.block, count);
+			length -= count;
+			block += count;
+
+			if (block == SECTION_VOLUME) {
+				if (section_set_blocks(&chunk->sections[section], blocks))
+					return -1;
+				section++;
+				block = 0;
+			}
+		}
+	}
+
+	return section == SECTIONS_PER_CHUNK ? 0 : -1;
+}
+
+int
+region_store_load_chunk(struct region_store *store, struct chunk *chunk)
+{
+	struct region_entry entry;
+	struct region *region;
+	int ret = 1;
+
+	region = get_region(store, to_region_coordinate(chunk->x), to_region_coordinate(chunk->z), false);
+	if (!region)
+		return 1;
+
+	pthread_rwlock_rdlock(&region->lock);
+
+	entry = region->table[get_region_index(chunk)];
+	if (!entry.sector)
+		goto unlock;
+
+	if ((size_t) entry.sector * REGION_SECTOR_SIZE + entry.size > region->map_size ||
+		decode_chunk(chunk, region->map + (size_t) entry.sector * REGION_SECTOR_SIZE, entry.size)) {
+		pprint_error("The chunk (%d, %d) is corrupted in its region file", chunk->x, chunk->z);
+		ret = -1;
+		goto unlock;
+	}
+
+	ret = 0;
+
+unlock:
+	pthread_rwlock_unlock(&region->lock);
+	return ret;
+}
+
+static uint32_t
+write_run(uint8_t *payload, uint32_t size, uint8_t block, uint32_t length)
+{
+	struct block_run run = { .block = block, .length = { length & 0xff, length >> 8 } };
+
+	memcpy(payload + size, &run, sizeof(run));
+
+	return size + sizeof(run);
+}
+
+static uint32_t
+encode_chunk(const struct chunk *chunk, uint8_t *payload)
+{
+	struct payload_header header = { .x = chunk->x, .z = chunk->z };
+	uint32_t size = sizeof(header), i, length = 0;
+	const struct chunk_section *section;
+	uint8_t blocks[SECTION_VOLUME];
+	uint8_t block = BLOCK_AIR;
+	int s;
+
+	memcpy(payload, &header, sizeof(header));
+
+	for (s = 0; s < SECTIONS_PER_CHUNK; s++) {
+		section = &chunk->sections[s];
+
+		/* A uniform section is a single run, or extends the last one */
+		if (section_is_uniform(section)) {
+			if (length && (section->palette[0] != block || length + SECTION_VOLUME > UINT16_MAX)) {
+				size = write_run(payload, size, block, length);
+				length = 0;
+			}
+
+			block = section->palette[0];
+			length += SECTION_VOLUME;
+			continue;
+		}
+
+		section_get_blocks(section, blocks);
+
+		for (i = 0; i < SECTION_VOLUME; i++) {
+			if (length && (blocks[i] != block || length == UINT16_MAX)) {
+				size = write_run(payload, size, block, length);
+				length = 0;
+			}
+
+			block = blocks[i];
+			length++;
+		}
+	}
+
+	return write_run(payload, size, block, length);
+}
+
+int
+region_store_save_chunk(struct region_store *store, const struct chunk *chunk)
+{
+	uint32_t index = get_region_index(chunk), sectors, size;
+	struct region_entry entry, old_entry;
+	struct region *region;
+	uint8_t *payload;
+	int ret = -1;
+
+	payload = malloc(MAX_PAYLOAD_SIZE);
+	if (!payload) {
+		print_error("Failed to allocate chunk payload!");
+		return -1;
+	}
+
+	/* Compressed before the lock, only the file access is serialized */
+	size = encode_chunk(chunk, payload);
+	sectors = get_sector_count(size);
+
+	region = get_region(store, to_region_coordinate(chunk->x), to_region_coordinate(chunk->z), true);
+	if (!region)
+		goto free_payload;
+
+	pthread_rwlock_wrlock(&region->lock);
+
+	entry.size = size;
+	entry.sector = allocate_sectors(region, sectors);
+	if (!entry.sector)
+		goto free_sectors;
+
+	pthread_rwlock_unlock(&region->lock);
+
+	/* No table entry points to the new sectors, the loads do not read them
+	 * and the lock is not needed. The old chunk stays in the file until
+	 * the new one is on the disk. */
+	if (pwrite(region->fd, payload, size, (off_t) entry.sector * REGION_SECTOR_SIZE) != size ||
+		fdatasync(region->fd)) {
+		pthread_rwlock_wrlock(&region->lock);
+		goto free_sectors;
+	}
+
+	pthread_rwlock_wrlock(&region->lock);
+
+	if ((size_t) region->sector_count * REGION_SECTOR_SIZE > region->map_size && map_region(region))
+		goto free_sectors;
+
+	if (pwrite(region->fd, &entry, sizeof(entry), sizeof(entry) * index) != sizeof(entry))
+		goto free_sectors;
+
+	old_entry = region->table[index];
+	region->table[index] = entry;
+
+	/* The sectors of the old chunk are the ones freed now */
+	entry = old_entry;
+	ret = 0;
+
+free_sectors:
+	if (entry.sector && is_sector_run_valid(region, entry.sector, get_sector_count(entry.size)))
+		mark_sectors(region, entry.sector, get_sector_count(entry.size), false);
+	pthread_rwlock_unlock(&region->lock);
+	if (ret)
+		pprint_error("Failed to write the chunk (%d, %d) to its region file", chunk->x, chunk->z);
+free_payload:
+	free(payload);
+	return ret;
+}
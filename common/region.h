@@ -0,0 +1,83 @@
+#ifndef REGION_H
+#define REGION_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "world.h"
+
+/* A region file holds REGION_WIDTH x REGION_WIDTH chunks. It starts with
+ * a table of `struct region_entry`, one per chunk in x-major order, and
+ * then the compressed chunks, each one in whole REGION_SECTOR_SIZE
+ * sectors. Everything is in the host byte order.
+ *
+ * A saved chunk always goes to free sectors, and is synced before its
+ * table entry points to it. A crash leaves the old or the new chunk, and
+ * at worst sectors no entry points to, which are free again once the file
+ * is opened.
+ * */
+#define REGION_WIDTH_SHIFT 5
+#define REGION_WIDTH (1 << REGION_WIDTH_SHIFT)
+#define REGION_CHUNK_COUNT (REGION_WIDTH * REGION_WIDTH)
+#define REGION_SECTOR_SIZE 4096
+#define REGION_HEADER_SECTORS ((sizeof(struct region_entry) * REGION_CHUNK_COUNT) / REGION_SECTOR_SIZE)
+
+/* Convert a chunk coordinate to the coordinate of the region holding it */
+#define to_region_coordinate(value) ((int32_t) (value) >> REGION_WIDTH_SHIFT)
+
+struct region_entry {
+	/* First sector of the chunk, 0 if the chunk is not in the file */
+	uint32_t sector;
+	/* Compressed size in bytes */
+	uint32_t size;
+};
+
+/* An open region file, mapped read only, or a region with no file yet
+ * (fd is -1 and the table is empty). Loads take the lock for reading and
+ * saves for writing, since they may create, grow and remap the file. */
+struct region {
+	int32_t x;
+	int32_t z;
+	int fd;
+	pthread_rwlock_t lock;
+	const uint8_t *map;
+	size_t map_size;
+	uint32_t sector_count;
+	/* One bit per sector, set for the header, the chunks of the table and
+	 * the sectors a save is writing */
+	uint64_t *used_sectors;
+	uint32_t used_sectors_capacity;
+	struct region_entry table[REGION_CHUNK_COUNT];
+};
+
+/* The region files of a world directory, opened on demand and kept open */
+struct region_store {
+	char *directory;
+	pthread_mutex_t lock;
+	struct region **regions;
+	uint32_t region_count;
+	uint32_t region_capacity;
+};
+
+/* Reads the seed of the level in `directory`, creating the directory and
+ * the level with `*seed` if there is none yet */
+int
+open_level(const char *directory, int *seed);
+
+int
+region_store_init(struct region_store *store, const char *directory);
+
+void
+region_store_destroy(struct region_store *store);
+
+/* Fill the blocks of `chunk` from its region file, it can be called from
+ * any thread. Returns 1 if the chunk was never saved. */
+int
+region_store_load_chunk(struct region_store *store, struct chunk *chunk);
+
+/* Can be called from any thread */
+int
+region_store_save_chunk(struct region_store *store, const struct chunk *chunk);
+
+#endif //REGION_H
@@ -0,0 +1,219 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "section_indices.h"
+#include "world.h"
+#include "utils.h"
+
+#define INITIAL_BUCKET_COUNT 256
+
+static pthread_mutex_t table_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct section_indices **buckets = NULL;
+static uint32_t bucket_count = 0;
+static uint32_t shared_count = 0;
+static size_t shared_size = 0;
+
+static inline size_t
+get_word_count(uint8_t bits)
+{
+	return SECTION_VOLUME / 64 * bits;
+}
+
+static inline size_t
+get_buffer_size(uint8_t bits)
+{
+	return sizeof(struct section_indices) + sizeof(uint64_t) * get_word_count(bits);
+}
+
+struct section_indices *
+create_section_indices(uint8_t bits)
+{
+	struct section_indices *indices;
+
+	indices = calloc(1, get_buffer_size(bits));
+	if (!indices) {
+		print_error("Failed to allocate section indices!");
+		return NULL;
+	}
+
+	indices->bits = bits;
+	atomic_init(&indices->refs, 1);
+
+	return indices;
+}
+
+static uint64_t
+hash_indices(const struct section_indices *indices)
+{
+	uint64_t hash = indices->bits;
+	size_t i;
+
+	for (i = 0; i < get_word_count(indices->bits); i++) {
+		hash = (hash ^ indices->words[i]) * 0x9e3779b97f4a7c15ULL;
+		hash ^= hash >> 32;
+	}
+
+	return hash;
+}
+
+static bool
+are_indices_equal(const struct section_indices *a, const struct section_indices *b)
+{
+	return a->hash == b->hash && a->bits == b->bits &&
+		!memcmp(a->words, b->words, sizeof(uint64_t) * get_word_count(a->bits));
+}
+
+/* Double the buckets, the caller holds the lock. On failure the chains
+ * just get longer. */
+static void
+grow_buckets(void)
+{
+	uint32_t i, count = bucket_count ? bucket_count * 2 : INITIAL_BUCKET_COUNT;
+	struct section_indices **new_buckets, *indices, *next;
+
+	new_buckets = calloc(count, sizeof(struct section_indices *));
+	if (!new_buckets)
+		return;
+
+	for (i = 0; i < bucket_count; i++) {
+		for (indices = buckets[i]; indices; indices = next) {
+			next = indices->next;
+			indices->next = new_buckets[indices->hash & (count - 1)];
+			new_buckets[indices->hash & (count - 1)] = indices;
+		}
+	}
+
+	free(buckets);
+	buckets = new_buckets;
+	bucket_count = count;
+}
+
+struct section_indices *
+share_section_indices(struct section_indices *indices)
+{
+	struct section_indices *other;
+	uint32_t bucket;
+
+	/* Hashed before the lock, only the table access is serialized */
+	indices->hash = hash_indices(indices);
+
+	pthread_mutex_lock(&table_lock);
+
+	if (shared_count >= bucket_count)
+		grow_buckets();
+
+	if (!bucket_count) {
+		pthread_mutex_unlock(&table_lock);
+		return indices;
+	}
+
+	bucket = indices->hash & (bucket_count - 1);
+	for (other = buckets[bucket]; other; other = other->next) {
+		if (are_indices_equal(other, indices)) {
+			atomic_fetch_add_explicit(&other->refs, 1, memory_order_relaxed);
+			pthread_mutex_unlock(&table_lock);
+			free(indices);
+			return other;
+		}
+	}
+
+	indices->shared = true;
+	indices->next = buckets[bucket];
+	buckets[bucket] = indices;
+	shared_count++;
+	shared_size += get_buffer_size(indices->bits);
+
+	pthread_mutex_unlock(&table_lock);
+
+	return indices;
+}
+
+/* The caller holds the lock */
+static void
+remove_shared_indices(struct section_indices *indices)
+{
+	struct section_indices **link = &buckets[indices->hash & (bucket_count - 1)];
+
+	while (*link != indices)
+		link = &(*link)->next;
+	*link = indices->next;
+
+	indices->shared = false;
+	shared_count--;
+	shared_size -= get_buffer_size(indices->bits);
+
+	/* Nothing is left once every chunk is destroyed */
+	if (!shared_count) {
+		free(buckets);
+		buckets = NULL;
+		bucket_count = 0;
+	}
+}
+
+struct section_indices *
+unshare_section_indices(struct section_indices *indices)
+{
+	struct section_indices *copy;
+
+	/* Only the owner of a private buffer can see it */
+	if (!indices->shared)
+		return indices;
+
+	pthread_mutex_lock(&table_lock);
+	if (atomic_load_explicit(&indices->refs, memory_order_relaxed) == 1) {
+		remove_shared_indices(indices);
+		pthread_mutex_unlock(&table_lock);
+		return indices;
+	}
+	pthread_mutex_unlock(&table_lock);
+
+	copy = create_section_indices(indices->bits);
+	if (!copy)
+		return NULL;
+
+	memcpy(copy->words, indices->words, sizeof(uint64_t) * get_word_count(indices->bits));
+	release_section_indices(indices);
+
+	return copy;
+}
+
+void
+release_section_indices(struct section_indices *indices)
+{
+	if (!indices)
+		return;
+
+	if (!indices->shared) {
+		free(indices);
+		return;
+	}
+
+	pthread_mutex_lock(&table_lock);
+	if (atomic_fetch_sub_explicit(&indices->refs, 1, memory_order_relaxed) == 1) {
+		remove_shared_indices(indices);
+		free(indices);
+	}
+	pthread_mutex_unlock(&table_lock);
+}
+
+size_t
+get_section_indices_memory_size(const struct section_indices *indices)
+{
+	if (!indices)
+		return 0;
+
+	if (!indices->shared)
+		return get_buffer_size(indices->bits);
+
+	return get_buffer_size(indices->bits) / max(atomic_load_explicit(&indices->refs, memory_order_relaxed), 1u);
+}
+
+void
+get_shared_indices_stats(uint32_t *count, size_t *size)
+{
+	pthread_mutex_lock(&table_lock);
+	*count = shared_count;
+	*size = shared_size;
+	pthread_mutex_unlock(&table_lock);
+}
@@ -0,0 +1,52 @@
+#ifndef SECTION_INDICES_H
+#define SECTION_INDICES_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* The packed palette indices of a chunk section. Sections with the same
+ * indices share a single buffer, found with a global hash table when the
+ * buffer is shared. A shared buffer is immutable, a section copies it
+ * before its first write (copy on write).
+ * */
+struct section_indices {
+	/* Next buffer of the same hash table bucket */
+	struct section_indices *next;
+	uint64_t hash;
+	/* Sections using the buffer, only changed with the table lock */
+	atomic_uint refs;
+	uint8_t bits;
+	/* In the hash table, and so immutable */
+	bool shared;
+	uint64_t words[];
+};
+
+/* Zeroed private indices of `bits` per block */
+struct section_indices *
+create_section_indices(uint8_t bits);
+
+/* Takes a private buffer and returns the shared buffer with the same
+ * indices, which can be `indices` itself. If the table can't grow the
+ * buffer simply stays private. */
+struct section_indices *
+share_section_indices(struct section_indices *indices);
+
+/* Returns a private buffer with the same indices, or NULL (and `indices`
+ * is still valid) if the copy can't be allocated */
+struct section_indices *
+unshare_section_indices(struct section_indices *indices);
+
+void
+release_section_indices(struct section_indices *indices);
+
+/* Memory of the buffer, split between the sections sharing it */
+size_t
+get_section_indices_memory_size(const struct section_indices *indices);
+
+/* Shared buffers and their size, each one counted once */
+void
+get_shared_indices_stats(uint32_t *count, size_t *size);
+
+#endif //SECTION_INDICES_H
@@ -1,12 +1,23 @@
 #include <cglm/cglm.h>
 #include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <sched.h>
 #include <time.h>
 #include <math.h>
 
 #include <stdio.h>
 
-#define FNL_IMPL
 #include "terrain.h"
+#include "noise.h"
+#include "utils.h"
+
+/* Columns whose top is bellow this height are covered by sand */
+#define SAND_LEVEL -8
+/* How many dirt blocks there are between the surface and the stone */
+#define DIRT_DEPTH 3
+/* The noise is negated, so the valleys of the noise are the mountains */
+#define TERRAIN_SCALE -16
 
 int
 get_seed()
@@ -22,17 +33,158 @@ init_noise_generator(fnl_state *noise, int seed)
 	noise->seed = seed;
 }
 
+int
+get_column_height(fnl_state *noise, int x, int z)
+{
+	return roundf(TERRAIN_SCALE * fnlGetNoise2D(noise, x, z));
+}
+
+static uint8_t
+get_block_at_depth(int height, int depth)
+{
+	if (height <= SAND_LEVEL)
+		return depth <= DIRT_DEPTH ? BLOCK_SAND : BLOCK_STONE_BRICKS;
+	if (depth == 0)
+		return BLOCK_GRASS;
+	if (depth <= DIRT_DEPTH)
+		return BLOCK_COARSE_DIRT;
+	return BLOCK_STONE_BRICKS;
+}
+
+int
+generate_chunk(struct chunk *chunk, fnl_state *noise)
+{
+	int heights[CHUNK_WIDTH * CHUNK_WIDTH];
+	int x, y, z, height, top, section, bottom, min_top, max_top;
+	uint8_t blocks[SECTION_VOLUME];
+
+	get_noise_heightmap(noise, chunk->x * CHUNK_WIDTH, chunk->z * CHUNK_WIDTH,
+						CHUNK_WIDTH, CHUNK_WIDTH, TERRAIN_SCALE, heights);
+
+	min_top = INT_MAX;
+	max_top = INT_MIN;
+	for (x = 0; x < CHUNK_WIDTH * CHUNK_WIDTH; x++) {
+		min_top = min(min_top, min(heights[x], WORLD_MAX_Y) - WORLD_MIN_Y);
+		max_top = max(max_top, min(heights[x], WORLD_MAX_Y) - WORLD_MIN_Y);
+	}
+
+	/* Filled a section at a time, so each palette is built once */
+	for (section = 0; section < SECTIONS_PER_CHUNK; section++) {
+		bottom = section * SECTION_HEIGHT;
+
+		/* Above every column, or bellow the dirt and the sand of all of them */
+		if (bottom > max_top) {
+			section_fill(&chunk->sections[section], BLOCK_AIR);
+			continue;
+		}
+		if (bottom + SECTION_HEIGHT - 1 < min_top - DIRT_DEPTH) {
+			section_fill(&chunk->sections[section], BLOCK_STONE_BRICKS);
+			continue;
+		}
+
+		memset(blocks, BLOCK_AIR, SECTION_VOLUME);
+
+		for (z = 0; z < CHUNK_WIDTH; z++) {
+			for (x = 0; x < CHUNK_WIDTH; x++) {
+				height = heights[z * CHUNK_WIDTH + x];
+				top = min(height, WORLD_MAX_Y) - WORLD_MIN_Y;
+
+				for (y = bottom; y <= min(top, bottom + SECTION_HEIGHT - 1); y++)
+					blocks[block_index(x, y - bottom, z)] = get_block_at_depth(height, top - y);
+			}
+		}
+
+		if (section_set_blocks(&chunk->sections[section], blocks))
+			return -1;
+	}
+
+	return 0;
+}
+
+static void
+run_terrain_task(struct pool_task *task)
+{
+	struct terrain_task *terrain_task = (struct terrain_task *) task;
+
+	/* A corrupted chunk is generated again */
+	if (terrain_task->regions && !region_store_load_chunk(terrain_task->regions, terrain_task->chunk))
+		return;
+
+	terrain_task->failed = generate_chunk(terrain_task->chunk, terrain_task->noise);
+	terrain_task->chunk->unsaved = terrain_task->regions != NULL;
+}
+
 void
-generate_terrain(vec3 *data, fnl_state *noise, int xi, int zi, int xf, int zf)
+init_terrain_task(struct terrain_task *terrain_task, fnl_state *noise, struct region_store *regions,
+				  struct chunk *chunk)
+{
+	terrain_task->task.run = run_terrain_task;
+	terrain_task->noise = noise;
+	terrain_task->regions = regions;
+	terrain_task->chunk = chunk;
+	terrain_task->failed = false;
+}
+
+int
+generate_world(struct world *world, fnl_state *noise, struct worker_pool *workers, int radius)
 {
-	int x, z, index = 0;
+	uint32_t i, submitted = 0, completed = 0, task_count = 4 * radius * radius;
+	struct terrain_task *tasks;
+	struct chunk *chunk;
+	int ret = -1;
+
+	tasks = malloc(sizeof(struct terrain_task) * task_count);
+	if (!tasks) {
+		print_error("Failed to allocate terrain tasks vector!");
+		goto return_error;
+	}
+
+	for (i = 0; i < task_count; i++) {
+		chunk = create_chunk(i / (2 * radius) - radius, i % (2 * radius) - radius);
+		if (!chunk)
+			goto free_chunks;
+
+		init_terrain_task(&tasks[i], noise, NULL, chunk);
+	}
+
+	while (completed < task_count) {
+		while (submitted < task_count && !worker_pool_submit(workers, &tasks[submitted].task))
+			submitted++;
+
+		if (worker_pool_poll(workers))
+			completed++;
+		else
+			sched_yield();
+	}
 
-	for (x = xi; x < xf; x++) {
-		for (z = zi; z < zf; z++) {
-			data[index][0] = (float) x;
-			data[index][1] = -roundf(16 * fnlGetNoise2D(noise, x, z));
-			data[index][2] = (float) z;
-			index++;
+	/* Insert in a fixed order, so the table layout does not depend on
+	 * which worker finished first */
+	for (i = 0; i < task_count; i++) {
+		if (tasks[i].failed) {
+			print_error("Failed to generate the world!");
+			break;
 		}
+
+		tasks[i].chunk->state = CHUNK_GENERATED;
+		if (world_insert_chunk(world, tasks[i].chunk))
+			break;
+	}
+
+	if (i == task_count) {
+		ret = 0;
+		goto free_tasks;
 	}
+
+	/* The chunks already inserted belong to the world now */
+	for (; i < task_count; i++)
+		destroy_chunk(tasks[i].chunk);
+	goto free_tasks;
+
+free_chunks:
+	while (i--)
+		destroy_chunk(tasks[i].chunk);
+free_tasks:
+	free(tasks);
+return_error:
+	return ret;
 }
@@ -1,15 +1,42 @@
 #ifndef TERRAIN_H
 #define TERRAIN_H
 
+#include "worker_pool.h"
+#include "region.h"
 #include "types.h"
 
+/* Loads a single chunk from the region files, or generates it if it was
+ * never saved, on a worker thread */
+struct terrain_task {
+	struct pool_task task;
+	fnl_state *noise;
+	/* NULL to always generate */
+	struct region_store *regions;
+	struct chunk *chunk;
+	bool failed;
+};
+
 int
 get_seed();
 
 void
 init_noise_generator(fnl_state *noise, int seed);
 
+/* World Y coordinate of the highest block of the (x, z) column, the scalar
+ * reference of the heightmap computed in `generate_chunk()` */
+int
+get_column_height(fnl_state *noise, int x, int z);
+
+int
+generate_chunk(struct chunk *chunk, fnl_state *noise);
+
 void
-generate_terrain(vec3 *data, fnl_state *noise, int xi, int yi, int xf, int yf);
+init_terrain_task(struct terrain_task *terrain_task, fnl_state *noise, struct region_store *regions,
+				  struct chunk *chunk);
+
+/* Generate the (2 * radius)^2 chunks around the world origin in parallel,
+ * the result does not depend on the number of workers */
+int
+generate_world(struct world *world, fnl_state *noise, struct worker_pool *workers, int radius);
 
 #endif //TERRAIN_H
@@ -5,6 +5,10 @@
 #include <stdbool.h>
 
 #include "FastNoise/FastNoiseLite.h"
+#include "world_streamer.h"
+#include "worker_pool.h"
+#include "region.h"
+#include "world.h"
 
 enum key { SPACE = 0, A, W, S, D, key_count };
 enum coodinates { X = 0, Y, coordinate_count };
@@ -22,6 +26,8 @@ struct glfw_callback_data {
 struct game_configs {
 	float mouse_speed;
 	float FoV;
+	/* In chunks, around the player */
+	int view_distance;
 };
 
 struct player_info {
@@ -33,12 +39,16 @@ struct player_info {
 
 struct game_terrain {
 	fnl_state noise;
+	struct world world;
+	struct world_streamer streamer;
+	struct region_store regions;
 };
 
 struct game_data {
 	struct game_configs configs;
 	struct player_info player;
 	struct game_terrain terrain;
+	struct worker_pool workers;
 	double last_frame_time;
 };
 
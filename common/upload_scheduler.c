@@ -0,0 +1,212 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "upload_scheduler.h"
+#include "utils.h"
+
+#define INITIAL_PENDING_CAPACITY 64
+/* In squared chunks, a chunk out of the view is uploaded after the chunks
+ * in the view up to 8 chunks away */
+#define OUT_OF_VIEW_PENALTY 64.0f
+#define STATS_REPORT_INTERVAL_US 1e6
+
+static bool stats_enabled = false;
+
+void
+set_upload_stats_enabled(bool enabled)
+{
+	stats_enabled = enabled;
+}
+
+static double
+get_elapsed_us(const struct timespec *start, const struct timespec *end)
+{
+	return (end->tv_sec - start->tv_sec) * 1e6 + (end->tv_nsec - start->tv_nsec) / 1e3;
+}
+
+void
+upload_scheduler_init(struct upload_scheduler *scheduler, uint64_t max_bytes, double max_us)
+{
+	memset(scheduler, 0, sizeof(struct upload_scheduler));
+
+	scheduler->max_bytes = max_bytes;
+	scheduler->max_us = max_us;
+	clock_gettime(CLOCK_MONOTONIC, &scheduler->report_start);
+}
+
+void
+upload_scheduler_destroy(struct upload_scheduler *scheduler)
+{
+	uint32_t i;
+
+	for (i = 0; i < scheduler->count; i++)
+		world_streamer_release_mesh(scheduler->heap[i].mesh_task);
+
+	free(scheduler->heap);
+	scheduler->heap = NULL;
+	scheduler->count = scheduler->capacity = 0;
+}
+
+static void
+sift_down(struct upload_scheduler *scheduler, uint32_t i)
+{
+	struct pending_upload *heap = scheduler->heap;
+	struct pending_upload pending = heap[i];
+	uint32_t child;
+
+	while ((child = 2 * i + 1) < scheduler->count) {
+		if (child + 1 < scheduler->count && heap[child + 1].priority < heap[child].priority)
+			child++;
+
+		if (pending.priority <= heap[child].priority)
+			break;
+
+		heap[i] = heap[child];
+		i = child;
+	}
+
+	heap[i] = pending;
+}
+
+int
+upload_scheduler_collect(struct upload_scheduler *scheduler, struct world_streamer *streamer)
+{
+	struct pending_upload *heap;
+	struct mesh_task *mesh_task;
+	uint32_t capacity;
+
+	/* The priorities are computed in `upload_scheduler_begin_frame()`, so
+	 * the new meshes are only appended */
+	while ((mesh_task = world_streamer_pop_mesh(streamer))) {
+		if (scheduler->count == scheduler->capacity) {
+			capacity = scheduler->capacity ? scheduler->capacity * 2 : INITIAL_PENDING_CAPACITY;
+			heap = realloc(scheduler->heap, sizeof(struct pending_upload) * capacity);
+			if (!heap) {
+				print_error("Failed to grow the pending uploads heap!");
+				world_streamer_release_mesh(mesh_task);
+				return -1;
+			}
+
+			scheduler->heap = heap;
+			scheduler->capacity = capacity;
+		}
+
+		scheduler->heap[scheduler->count++] = (struct pending_upload) { .priority = 0, .mesh_task = mesh_task };
+	}
+
+	return 0;
+}
+
+void
+upload_scheduler_drop(struct upload_scheduler *scheduler, int32_t x, int32_t z)
+{
+	struct mesh_task *mesh_task;
+	uint32_t i = 0;
+
+	/* The heap order is restored by the next `upload_scheduler_begin_frame()` */
+	while (i < scheduler->count) {
+		mesh_task = scheduler->heap[i].mesh_task;
+		if (mesh_task->x != x || mesh_task->z != z) {
+			i++;
+			continue;
+		}
+
+		world_streamer_release_mesh(mesh_task);
+		scheduler->heap[i] = scheduler->heap[--scheduler->count];
+	}
+}
+
+static float
+get_upload_priority(const struct mesh_task *mesh_task, const vec3 position, vec4 planes[6])
+{
+	vec3 box[2];
+	float dx, dz;
+
+	get_chunk_origin(mesh_task->x, mesh_task->z, box[0]);
+	glm_vec3_add(box[0], (vec3) { CHUNK_WIDTH, CHUNK_HEIGHT, CHUNK_WIDTH }, box[1]);
+
+	/* Horizontal distance to the chunk center, in chunks */
+	dx = (box[0][0] + CHUNK_WIDTH / 2 - position[0]) / CHUNK_WIDTH;
+	dz = (box[0][2] + CHUNK_WIDTH / 2 - position[2]) / CHUNK_WIDTH;
+
+	if (glm_aabb_frustum(box, planes))
+		return dx * dx + dz * dz;
+
+	return dx * dx + dz * dz + OUT_OF_VIEW_PENALTY;
+}
+
+void
+upload_scheduler_begin_frame(struct upload_scheduler *scheduler, const vec3 position, mat4 view_proj)
+{
+	vec4 planes[6];
+	uint32_t i;
+
+	/* The camera moves every frame, so every priority changes and the heap
+	 * is built again, which is linear */
+	glm_frustum_planes(view_proj, planes);
+
+	for (i = 0; i < scheduler->count; i++)
+		scheduler->heap[i].priority = get_upload_priority(scheduler->heap[i].mesh_task, position, planes);
+
+	for (i = scheduler->count / 2; i-- > 0;)
+		sift_down(scheduler, i);
+
+	memset(&scheduler->frame, 0, sizeof(struct upload_stats));
+	clock_gettime(CLOCK_MONOTONIC, &scheduler->frame_start);
+}
+
+struct mesh_task *
+upload_scheduler_next(struct upload_scheduler *scheduler)
+{
+	struct mesh_task *mesh_task;
+	struct timespec now;
+
+	if (!scheduler->count)
+		return NULL;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	scheduler->frame.elapsed_us = get_elapsed_us(&scheduler->frame_start, &now);
+
+	if (scheduler->frame.uploads &&
+		(scheduler->frame.bytes >= scheduler->max_bytes || scheduler->frame.elapsed_us >= scheduler->max_us))
+		return NULL;
+
+	mesh_task = scheduler->heap[0].mesh_task;
+	scheduler->heap[0] = scheduler->heap[--scheduler->count];
+	if (scheduler->count)
+		sift_down(scheduler, 0);
+
+	scheduler->frame.uploads++;
+	scheduler->frame.bytes += get_chunk_mesh_size(&mesh_task->mesh);
+
+	return mesh_task;
+}
+
+void
+upload_scheduler_end_frame(struct upload_scheduler *scheduler)
+{
+	struct upload_stats *report = &scheduler->report;
+	struct timespec now;
+	double elapsed_us;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	scheduler->frame.elapsed_us = get_elapsed_us(&scheduler->frame_start, &now);
+
+	report->frames++;
+	report->uploads += scheduler->frame.uploads;
+	report->bytes += scheduler->frame.bytes;
+	report->elapsed_us += scheduler->frame.elapsed_us;
+
+	elapsed_us = get_elapsed_us(&scheduler->report_start, &now);
+	if (elapsed_us < STATS_REPORT_INTERVAL_US)
+		return;
+
+	if (stats_enabled)
+		printf("uploads: %u pending, %.1f per frame, %.1f KiB per frame, %.3f ms per frame\n",
+			   scheduler->count, (double) report->uploads / report->frames,
+			   report->bytes / 1024.0 / report->frames, report->elapsed_us / 1e3 / report->frames);
+
+	memset(report, 0, sizeof(struct upload_stats));
+	scheduler->report_start = now;
+}
@@ -0,0 +1,71 @@
+#ifndef UPLOAD_SCHEDULER_H
+#define UPLOAD_SCHEDULER_H
+
+#include <cglm/cglm.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "world_streamer.h"
+
+struct upload_stats {
+	uint32_t frames;
+	uint32_t uploads;
+	uint64_t bytes;
+	double elapsed_us;
+};
+
+struct pending_upload {
+	float priority;
+	struct mesh_task *mesh_task;
+};
+
+/* Finished chunk meshes waiting for the GPU, in a binary min heap by
+ * priority. The closest chunks in the view frustum go first, and the
+ * uploads of a frame stop once the byte or the time budget is used.
+ * */
+struct upload_scheduler {
+	struct pending_upload *heap;
+	uint32_t count;
+	uint32_t capacity;
+	uint64_t max_bytes;
+	double max_us;
+	struct timespec frame_start;
+	struct upload_stats frame;
+	/* Summed since the last report */
+	struct upload_stats report;
+	struct timespec report_start;
+};
+
+/* Print the upload statistics about once per second */
+void
+set_upload_stats_enabled(bool enabled);
+
+void
+upload_scheduler_init(struct upload_scheduler *scheduler, uint64_t max_bytes, double max_us);
+
+void
+upload_scheduler_destroy(struct upload_scheduler *scheduler);
+
+/* Take the meshes finished by the streamer since the last call */
+int
+upload_scheduler_collect(struct upload_scheduler *scheduler, struct world_streamer *streamer);
+
+/* The chunk was unloaded, its pending mesh is stale */
+void
+upload_scheduler_drop(struct upload_scheduler *scheduler, int32_t x, int32_t z);
+
+/* Sort the pending meshes for the current camera and reset the budget */
+void
+upload_scheduler_begin_frame(struct upload_scheduler *scheduler, const vec3 position, mat4 view_proj);
+
+/* Returns NULL when the queue is empty or the frame budget is used, at
+ * least one mesh is returned per frame so the queue always moves.
+ * Release the mesh once it is uploaded. */
+struct mesh_task *
+upload_scheduler_next(struct upload_scheduler *scheduler);
+
+void
+upload_scheduler_end_frame(struct upload_scheduler *scheduler);
+
+#endif //UPLOAD_SCHEDULER_H
@@ -0,0 +1,132 @@
+#include <stdlib.h>
+#include <unistd.h>
+#include <sched.h>
+
+#include "worker_pool.h"
+#include "utils.h"
+
+static void *
+worker_main(void *data)
+{
+	struct worker_pool *pool = data;
+	struct pool_task *task;
+
+	for (;;) {
+		while (sem_wait(&pool->pending_count))
+			;
+
+		if (atomic_load_explicit(&pool->stop, memory_order_acquire))
+			break;
+
+		/* The semaphore is posted after the push, but an earlier push of
+		 * another producer may still be in progress, so the pop can fail */
+		while (!(task = lf_queue_pop(&pool->pending)))
+			sched_yield();
+
+		task->run(task);
+
+		/* The submitter drains the completed queue every frame */
+		while (!lf_queue_push(&pool->completed, task))
+			sched_yield();
+	}
+
+	return NULL;
+}
+
+uint32_t
+get_worker_count()
+{
+	long cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+
+	if (cpu_count <= 2)
+		return 1;
+
+	return cpu_count - 1;
+}
+
+int
+worker_pool_init(struct worker_pool *pool, uint32_t thread_count, uint32_t queue_capacity)
+{
+	uint32_t i;
+
+	pool->threads = malloc(sizeof(pthread_t) * thread_count);
+	if (!pool->threads) {
+		print_error("Failed to allocate worker threads vector!");
+		goto return_error;
+	}
+
+	if (lf_queue_init(&pool->pending, queue_capacity))
+		goto free_threads;
+
+	/* Every submitted task can end up completed at the same time */
+	if (lf_queue_init(&pool->completed, queue_capacity))
+		goto destroy_pending_queue;
+
+	if (sem_init(&pool->pending_count, 0, 0)) {
+		print_error("Failed to create worker pool semaphore!");
+		goto destroy_completed_queue;
+	}
+
+	atomic_init(&pool->stop, false);
+
+	for (i = 0; i < thread_count; i++) {
+		if (pthread_create(&pool->threads[i], NULL, worker_main, pool)) {
+			pprint_error("Failed to create worker thread %u/%u", i + 1, thread_count);
+			break;
+		}
+	}
+
+	pool->thread_count = i;
+	if (i != thread_count) {
+		worker_pool_destroy(pool);
+		return -1;
+	}
+
+	return 0;
+
+destroy_completed_queue:
+	lf_queue_destroy(&pool->completed);
+destroy_pending_queue:
+	lf_queue_destroy(&pool->pending);
+free_threads:
+	free(pool->threads);
+return_error:
+	return -1;
+}
+
+void
+worker_pool_destroy(struct worker_pool *pool)
+{
+	uint32_t i;
+
+	atomic_store_explicit(&pool->stop, true, memory_order_release);
+
+	for (i = 0; i < pool->thread_count; i++)
+		sem_post(&pool->pending_count);
+
+	for (i = 0; i < pool->thread_count; i++)
+		pthread_join(pool->threads[i], NULL);
+
+	sem_destroy(&pool->pending_count);
+	lf_queue_destroy(&pool->completed);
+	lf_queue_destroy(&pool->pending);
+	free(pool->threads);
+	pool->thread_count = 0;
+}
+
+int
+worker_pool_submit(struct worker_pool *pool, struct pool_task *task)
+{
+	if (!lf_queue_push(&pool->pending, task))
+		return -1;
+
+	sem_post(&pool->pending_count);
+
+	return 0;
+}
+
+struct pool_task *
+worker_pool_poll(struct worker_pool *pool)
+{
+	return lf_queue_pop(&pool->completed);
+}
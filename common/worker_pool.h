@@ -0,0 +1,46 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <semaphore.h>
+#include <pthread.h>
+#include <stdint.h>
+
+#include "lf_queue.h"
+
+/* Embed it in the job data, `run` is called on a worker thread and the
+ * task is returned to the submitter by `worker_pool_poll()` */
+struct pool_task {
+	void (*run)(struct pool_task *task);
+};
+
+struct worker_pool {
+	pthread_t *threads;
+	uint32_t thread_count;
+	/* Tasks waiting for a worker */
+	struct lf_queue pending;
+	sem_t pending_count;
+	/* Finished tasks waiting for the submitter */
+	struct lf_queue completed;
+	atomic_bool stop;
+};
+
+/* Number of workers that leaves one core to the main thread */
+uint32_t
+get_worker_count();
+
+int
+worker_pool_init(struct worker_pool *pool, uint32_t thread_count, uint32_t queue_capacity);
+
+/* Pending tasks are dropped, the ones already running are finished */
+void
+worker_pool_destroy(struct worker_pool *pool);
+
+/* Returns -1 if the pending queue is full */
+int
+worker_pool_submit(struct worker_pool *pool, struct pool_task *task);
+
+/* Non blocking, returns NULL if no task was completed since the last call */
+struct pool_task *
+worker_pool_poll(struct worker_pool *pool);
+
+#endif //WORKER_POOL_H
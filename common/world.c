@@ -0,0 +1,644 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "world.h"
+#include "utils.h"
+
+static_assert(CHUNK_WIDTH == 16 && SECTION_HEIGHT == 16, "The layout masks are for 16 blocks wide sections");
+
+static const char *section_layout_names[section_layout_count] = {
+	[SECTION_LAYOUT_LINEAR] = "linear",
+	[SECTION_LAYOUT_MORTON] = "morton",
+};
+
+/* x, y and z bits of each layout */
+static const uint32_t section_axis_masks[section_layout_count][3] = {
+	[SECTION_LAYOUT_LINEAR] = { 0x00f, 0xf00, 0x0f0 },
+	[SECTION_LAYOUT_MORTON] = { 0x249, 0x492, 0x924 },
+};
+
+static enum section_layout section_layout = SECTION_LAYOUT_LINEAR;
+/* x-major index to packed index and back, only for the Morton layout */
+static uint16_t packed_indices[SECTION_VOLUME];
+static uint16_t unpacked_indices[SECTION_VOLUME];
+
+/* Spread the bits of `value` so `mask` holds them, in order */
+static uint32_t
+deposit_bits(uint32_t value, uint32_t mask)
+{
+	uint32_t result = 0, bit;
+
+	for (; mask; mask &= mask - 1, value >>= 1) {
+		bit = mask & -mask;
+		if (value & 1)
+			result |= bit;
+	}
+
+	return result;
+}
+
+void
+set_section_layout(enum section_layout layout)
+{
+	const uint32_t *masks = section_axis_masks[layout];
+	uint32_t x, y, z, i;
+
+	section_layout = layout;
+	if (layout == SECTION_LAYOUT_LINEAR)
+		return;
+
+	for (y = 0; y < SECTION_HEIGHT; y++) {
+		for (z = 0; z < CHUNK_WIDTH; z++) {
+			for (x = 0; x < CHUNK_WIDTH; x++) {
+				i = deposit_bits(x, masks[0]) | deposit_bits(y, masks[1]) | deposit_bits(z, masks[2]);
+				packed_indices[block_index(x, y, z)] = i;
+				unpacked_indices[i] = block_index(x, y, z);
+			}
+		}
+	}
+}
+
+enum section_layout
+get_section_layout()
+{
+	return section_layout;
+}
+
+const char *
+get_section_layout_name(enum section_layout layout)
+{
+	return section_layout_names[layout];
+}
+
+int
+parse_section_layout(const char *name, enum section_layout *layout)
+{
+	int i;
+
+	for (i = 0; i < section_layout_count; i++) {
+		if (!strcmp(name, section_layout_names[i])) {
+			*layout = i;
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+static inline uint32_t
+to_packed_index(uint32_t i)
+{
+	return section_layout == SECTION_LAYOUT_LINEAR ? i : packed_indices[i];
+}
+
+uint32_t
+get_section_index(int x, int y, int z)
+{
+	return to_packed_index(block_index(x, y, z));
+}
+
+void
+get_section_axis_masks(enum section_layout layout, uint32_t masks[3])
+{
+	memcpy(masks, section_axis_masks[layout], sizeof(section_axis_masks[layout]));
+}
+
+static inline uint64_t
+pack_chunk_key(int32_t x, int32_t z)
+{
+	return ((uint64_t) (uint32_t) x << 32) | (uint32_t) z;
+}
+
+/* splitmix64 finalizer, neighbor chunks end up far away in the table */
+static inline uint64_t
+hash_chunk_key(uint64_t key)
+{
+	key ^= key >> 30;
+	key *= 0xbf58476d1ce4e5b9ULL;
+	key ^= key >> 27;
+	key *= 0x94d049bb133111ebULL;
+	key ^= key >> 31;
+	return key;
+}
+
+struct chunk *
+create_chunk(int32_t x, int32_t z)
+{
+	struct chunk *chunk;
+	int i;
+
+	/* Zeroed memory is a section of index bits 0 whose palette is air */
+	chunk = calloc(1, sizeof(struct chunk));
+	if (!chunk) {
+		pprint_error("Failed to allocate chunk (%d, %d)", x, z);
+		return NULL;
+	}
+
+	chunk->x = x;
+	chunk->z = z;
+
+	for (i = 0; i < SECTIONS_PER_CHUNK; i++)
+		chunk->sections[i].palette_count = 1;
+
+	return chunk;
+}
+
+void
+destroy_chunk(struct chunk *chunk)
+{
+	int i;
+
+	if (!chunk)
+		return;
+
+	for (i = 0; i < SECTIONS_PER_CHUNK; i++)
+		release_section_indices(chunk->sections[i].indices);
+
+	free(chunk);
+}
+
+static inline uint32_t
+get_index(const struct chunk_section *section, uint32_t i)
+{
+	uint32_t offset = i * section->bits;
+
+	if (!section->bits)
+		return 0;
+
+	return (section->indices->words[offset / 64] >> (offset % 64)) & ((1u << section->bits) - 1);
+}
+
+/* The indices are zeroed when allocated, so only set bits are or-ed in */
+static inline void
+or_index(struct section_indices *indices, uint32_t i, uint32_t index)
+{
+	uint32_t offset = i * indices->bits;
+
+	indices->words[offset / 64] |= (uint64_t) index << (offset % 64);
+}
+
+/* The indices must be private, see `make_section_writable()` */
+static inline void
+set_index(struct chunk_section *section, uint32_t i, uint32_t index)
+{
+	uint64_t *words = section->indices->words;
+	uint32_t offset = i * section->bits;
+	uint64_t mask = (((uint64_t) 1 << section->bits) - 1) << (offset % 64);
+
+	words[offset / 64] = (words[offset / 64] & ~mask) | ((uint64_t) index << (offset % 64));
+}
+
+void
+section_get_packed_blocks(const struct chunk_section *section, uint8_t *blocks)
+{
+	uint32_t i, j, bits = section->bits, per_word = bits ? 64 / bits : 0;
+	uint64_t word, mask = ((uint64_t) 1 << bits) - 1;
+
+	if (!bits) {
+		memset(blocks, section->palette[0], SECTION_VOLUME);
+		return;
+	}
+
+	/* A whole word at a time, the indices never cross words */
+	for (i = 0; i < SECTION_VOLUME; i += per_word) {
+		word = section->indices->words[i / per_word];
+
+		if (bits == DIRECT_BITS) {
+			for (j = 0; j < per_word; j++, word >>= bits)
+				blocks[i + j] = word & mask;
+		} else {
+			for (j = 0; j < per_word; j++, word >>= bits)
+				blocks[i + j] = section->palette[word & mask];
+		}
+	}
+}
+
+void
+section_get_blocks(const struct chunk_section *section, uint8_t *blocks)
+{
+	uint8_t packed[SECTION_VOLUME];
+	uint32_t i;
+
+	if (section_layout == SECTION_LAYOUT_LINEAR || section_is_uniform(section)) {
+		section_get_packed_blocks(section, blocks);
+		return;
+	}
+
+	section_get_packed_blocks(section, packed);
+	for (i = 0; i < SECTION_VOLUME; i++)
+		blocks[unpacked_indices[i]] = packed[i];
+}
+
+static uint8_t
+get_palette_bits(uint32_t palette_count)
+{
+	uint8_t bits = 0;
+
+	while ((1u << bits) < palette_count)
+		bits = bits ? bits * 2 : 1;
+
+	return bits > PALETTE_MAX_BITS ? DIRECT_BITS : bits;
+}
+
+int
+section_set_blocks(struct chunk_section *section, const uint8_t *blocks)
+{
+	uint8_t palette_indices[256], palette[PALETTE_CAPACITY];
+	struct section_indices *indices;
+	uint32_t i, palette_count = 0;
+	bool used[256] = { 0 };
+	uint8_t bits;
+
+	for (i = 0; i < SECTION_VOLUME; i++) {
+		if (used[blocks[i]])
+			continue;
+
+		used[blocks[i]] = true;
+		if (palette_count < PALETTE_CAPACITY)
+			palette[palette_count] = blocks[i];
+		palette_indices[blocks[i]] = palette_count++;
+	}
+
+	bits = get_palette_bits(palette_count);
+	if (!bits) {
+		section_fill(section, blocks[0]);
+		return 0;
+	}
+
+	indices = create_section_indices(bits);
+	if (!indices)
+		return -1;
+
+	for (i = 0; i < SECTION_VOLUME; i++)
+		or_index(indices, to_packed_index(i), bits == DIRECT_BITS ? blocks[i] : palette_indices[blocks[i]]);
+
+	/* The generated and loaded sections are often the same */
+	release_section_indices(section->indices);
+	section->indices = share_section_indices(indices);
+	section->bits = bits;
+	section->palette_count = bits == DIRECT_BITS ? 0 : palette_count;
+	memcpy(section->palette, palette, min(palette_count, PALETTE_CAPACITY));
+
+	return 0;
+}
+
+void
+section_fill(struct chunk_section *section, uint8_t block)
+{
+	release_section_indices(section->indices);
+	section->indices = NULL;
+	section->bits = 0;
+	section->palette_count = 1;
+	section->palette[0] = block;
+}
+
+uint8_t
+chunk_get_block(const struct chunk *chunk, int x, int y, int z)
+{
+	const struct chunk_section *section = &chunk->sections[y / SECTION_HEIGHT];
+	uint32_t index = get_index(section, get_section_index(x, y % SECTION_HEIGHT, z));
+
+	return section->bits == DIRECT_BITS ? index : section->palette[index];
+}
+
+/* Repack the indices in the next width, with DIRECT_BITS the indices are
+ * replaced by the blocks */
+static int
+widen_section(struct chunk_section *section)
+{
+	uint8_t bits = get_palette_bits(section->palette_count + 1);
+	struct section_indices *indices;
+	uint32_t i, index;
+
+	indices = create_section_indices(bits);
+	if (!indices)
+		return -1;
+
+	for (i = 0; i < SECTION_VOLUME; i++) {
+		index = get_index(section, i);
+		or_index(indices, i, bits == DIRECT_BITS ? section->palette[index] : index);
+	}
+
+	release_section_indices(section->indices);
+	section->indices = indices;
+	section->bits = bits;
+	if (bits == DIRECT_BITS)
+		section->palette_count = 0;
+
+	return 0;
+}
+
+/* Copy the indices before the first write if they are shared */
+static int
+make_section_writable(struct chunk_section *section)
+{
+	struct section_indices *indices;
+
+	indices = unshare_section_indices(section->indices);
+	if (!indices)
+		return -1;
+
+	section->indices = indices;
+
+	return 0;
+}
+
+int
+chunk_set_block(struct chunk *chunk, int x, int y, int z, uint8_t block)
+{
+	struct chunk_section *section = &chunk->sections[y / SECTION_HEIGHT];
+	uint32_t i = get_section_index(x, y % SECTION_HEIGHT, z), index;
+
+	/* Keeps the indices shared */
+	if (chunk_get_block(chunk, x, y, z) == block)
+		return 0;
+
+	if (section->bits == DIRECT_BITS) {
+		if (make_section_writable(section))
+			return -1;
+		set_index(section, i, block);
+		return 0;
+	}
+
+	for (index = 0; index < section->palette_count; index++)
+		if (section->palette[index] == block)
+			break;
+
+	if (index == section->palette_count) {
+		if (index == 1u << section->bits && widen_section(section))
+			return -1;
+
+		/* Widened indices are private */
+		if (section->bits == DIRECT_BITS) {
+			set_index(section, i, block);
+			return 0;
+		}
+
+		section->palette[section->palette_count++] = block;
+	}
+
+	if (make_section_writable(section))
+		return -1;
+	set_index(section, i, index);
+
+	return 0;
+}
+
+size_t
+get_chunk_memory_size(const struct chunk *chunk)
+{
+	size_t size = sizeof(struct chunk);
+	int i;
+
+	for (i = 0; i < SECTIONS_PER_CHUNK; i++)
+		size += get_section_indices_memory_size(chunk->sections[i].indices);
+
+	return size;
+}
+
+static struct chunk_table *
+create_chunk_table(uint32_t capacity)
+{
+	struct chunk_table *table;
+	uint32_t pow2_capacity = 16;
+
+	while (pow2_capacity < capacity)
+		pow2_capacity <<= 1;
+
+	table = calloc(1, sizeof(struct chunk_table) + sizeof(struct chunk_slot) * pow2_capacity);
+	if (!table) {
+		print_error("Failed to allocate world chunk table!");
+		return NULL;
+	}
+
+	table->capacity = pow2_capacity;
+
+	return table;
+}
+
+int
+world_init(struct world *world, uint32_t capacity)
+{
+	struct chunk_table *table;
+
+	/* Keep the load factor bellow 1/2 to have short probe sequences */
+	table = create_chunk_table(capacity * 2);
+	if (!table)
+		return -1;
+
+	if (pthread_mutex_init(&world->write_lock, NULL)) {
+		print_error("Failed to create the world lock!");
+		free(table);
+		return -1;
+	}
+
+	atomic_init(&world->table, table);
+	world->count = 0;
+
+	return 0;
+}
+
+void
+world_destroy(struct world *world)
+{
+	struct chunk *chunk;
+	uint32_t cursor = 0;
+
+	while ((chunk = world_next_chunk(world, &cursor)))
+		destroy_chunk(chunk);
+
+	/* Nobody reads anymore */
+	epoch_reclaim_all();
+
+	free(atomic_load(&world->table));
+	atomic_store(&world->table, NULL);
+	pthread_mutex_destroy(&world->write_lock);
+	world->count = 0;
+}
+
+/* Marks a removed chunk, the probe sequences go on past it */
+static struct chunk tombstone;
+
+/* The slot of `key`, or the empty slot ending its probe sequence, for the
+ * writers only. The table is never full, so there is always an empty slot
+ * to stop. */
+static struct chunk_slot *
+find_slot(const struct chunk_table *table, uint64_t key)
+{
+	uint32_t mask = table->capacity - 1;
+	uint32_t slot = hash_chunk_key(key) & mask;
+	const struct chunk_slot *chunk_slot;
+
+	for (;; slot = (slot + 1) & mask) {
+		chunk_slot = &table->slots[slot];
+		if (!atomic_load_explicit(&chunk_slot->chunk, memory_order_acquire) ||
+			atomic_load_explicit(&chunk_slot->key, memory_order_relaxed) == key)
+			return (struct chunk_slot *) chunk_slot;
+	}
+}
+
+static void
+free_chunk_table(void *table)
+{
+	free(table);
+}
+
+/* Copy the chunks to a new table, without the tombstones, and retire the
+ * old one. The caller holds the write lock. */
+static int
+rebuild_chunk_table(struct world *world)
+{
+	struct chunk_table *table = atomic_load_explicit(&world->table, memory_order_relaxed);
+	struct chunk_table *new_table;
+	struct chunk_slot *slot;
+	struct chunk *chunk;
+	uint32_t i;
+
+	/* Only drop the tombstones if the chunks alone are still bellow 1/4 */
+	new_table = create_chunk_table((world->count + 1) * 4 > table->capacity ? table->capacity * 2 : table->capacity);
+	if (!new_table)
+		return -1;
+
+	for (i = 0; i < table->capacity; i++) {
+		chunk = atomic_load_explicit(&table->slots[i].chunk, memory_order_relaxed);
+		if (!chunk || chunk == &tombstone)
+			continue;
+
+		slot = find_slot(new_table, atomic_load_explicit(&table->slots[i].key, memory_order_relaxed));
+		atomic_store_explicit(&slot->key, atomic_load_explicit(&table->slots[i].key, memory_order_relaxed),
+							  memory_order_relaxed);
+		atomic_store_explicit(&slot->chunk, chunk, memory_order_relaxed);
+		new_table->used++;
+	}
+
+	/* The slots are visible with the table */
+	atomic_store_explicit(&world->table, new_table, memory_order_release);
+	epoch_retire(&table->retire_node, table, free_chunk_table);
+
+	return 0;
+}
+
+struct chunk *
+world_get_chunk(const struct world *world, int32_t x, int32_t z)
+{
+	const struct chunk_table *table = atomic_load_explicit(&world->table, memory_order_acquire);
+	uint64_t key = pack_chunk_key(x, z);
+	uint32_t mask = table->capacity - 1;
+	uint32_t slot = hash_chunk_key(key) & mask;
+	struct chunk *chunk;
+
+	/* Same probe as `find_slot()`, but the slot is read once: an empty slot
+	 * can be taken by another key right after it was seen empty */
+	for (;; slot = (slot + 1) & mask) {
+		chunk = atomic_load_explicit(&table->slots[slot].chunk, memory_order_acquire);
+		if (!chunk)
+			return NULL;
+		if (atomic_load_explicit(&table->slots[slot].key, memory_order_relaxed) == key)
+			return chunk == &tombstone ? NULL : chunk;
+	}
+}
+
+int
+world_insert_chunk(struct world *world, struct chunk *chunk)
+{
+	uint64_t key = pack_chunk_key(chunk->x, chunk->z);
+	struct chunk_table *table;
+	struct chunk_slot *slot;
+	struct chunk *old;
+	int ret = -1;
+
+	pthread_mutex_lock(&world->write_lock);
+
+	table = atomic_load_explicit(&world->table, memory_order_relaxed);
+	if ((table->used + 1) * 2 > table->capacity) {
+		if (rebuild_chunk_table(world))
+			goto unlock;
+		table = atomic_load_explicit(&world->table, memory_order_relaxed);
+	}
+
+	slot = find_slot(table, key);
+	old = atomic_load_explicit(&slot->chunk, memory_order_relaxed);
+	if (old && old != &tombstone) {
+		pprint_error("Chunk (%d, %d) is already in the world", chunk->x, chunk->z);
+		goto unlock;
+	}
+
+	/* A tombstone already has the key */
+	if (!old) {
+		atomic_store_explicit(&slot->key, key, memory_order_relaxed);
+		table->used++;
+	}
+	atomic_store_explicit(&slot->chunk, chunk, memory_order_release);
+	world->count++;
+
+	ret = 0;
+
+unlock:
+	pthread_mutex_unlock(&world->write_lock);
+	return ret;
+}
+
+struct chunk *
+world_remove_chunk(struct world *world, int32_t x, int32_t z)
+{
+	struct chunk_slot *slot;
+	struct chunk *chunk;
+
+	pthread_mutex_lock(&world->write_lock);
+
+	slot = find_slot(atomic_load_explicit(&world->table, memory_order_relaxed), pack_chunk_key(x, z));
+	chunk = atomic_load_explicit(&slot->chunk, memory_order_relaxed);
+	if (!chunk || chunk == &tombstone) {
+		chunk = NULL;
+	} else {
+		atomic_store_explicit(&slot->chunk, &tombstone, memory_order_release);
+		world->count--;
+	}
+
+	pthread_mutex_unlock(&world->write_lock);
+
+	return chunk;
+}
+
+static void
+destroy_retired_chunk(void *chunk)
+{
+	destroy_chunk(chunk);
+}
+
+void
+world_retire_chunk(struct chunk *chunk)
+{
+	epoch_retire(&chunk->retire_node, chunk, destroy_retired_chunk);
+}
+
+struct chunk *
+world_next_chunk(const struct world *world, uint32_t *cursor)
+{
+	const struct chunk_table *table = atomic_load_explicit(&world->table, memory_order_acquire);
+	struct chunk *chunk;
+
+	while (*cursor < table->capacity) {
+		chunk = atomic_load_explicit(&table->slots[(*cursor)++].chunk, memory_order_acquire);
+		if (chunk && chunk != &tombstone)
+			return chunk;
+	}
+
+	return NULL;
+}
+
+uint8_t
+world_get_block(const struct world *world, int32_t x, int32_t y, int32_t z)
+{
+	struct chunk *chunk;
+
+	if (y < WORLD_MIN_Y || y > WORLD_MAX_Y)
+		return BLOCK_AIR;
+
+	chunk = world_get_chunk(world, to_chunk_coordinate(x), to_chunk_coordinate(z));
+	if (!chunk)
+		return BLOCK_AIR;
+
+	return chunk_get_block(chunk, to_local_coordinate(x), y - WORLD_MIN_Y, to_local_coordinate(z));
+}
@@ -0,0 +1,238 @@
+#ifndef WORLD_H
+#define WORLD_H
+
+#include <stdatomic.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "section_indices.h"
+#include "epoch.h"
+
+/* A chunk is a CHUNK_WIDTH x CHUNK_WIDTH column of the world split vertically
+ * in SECTIONS_PER_CHUNK cubic sections */
+#define CHUNK_WIDTH_SHIFT 4
+#define CHUNK_WIDTH (1 << CHUNK_WIDTH_SHIFT)
+#define SECTION_HEIGHT CHUNK_WIDTH
+#define SECTIONS_PER_CHUNK 4
+#define CHUNK_HEIGHT (SECTION_HEIGHT * SECTIONS_PER_CHUNK)
+#define SECTION_VOLUME (CHUNK_WIDTH * SECTION_HEIGHT * CHUNK_WIDTH)
+/* World Y coordinate of the first block of the lowest section */
+#define WORLD_MIN_Y (-32)
+#define WORLD_MAX_Y (WORLD_MIN_Y + CHUNK_HEIGHT - 1)
+
+/* Convert a world block coordinate to the coordinate of the chunk holding it */
+#define to_chunk_coordinate(value) ((int32_t) (value) >> CHUNK_WIDTH_SHIFT)
+/* Convert a world block coordinate to the chunk local one */
+#define to_local_coordinate(value) ((int32_t) (value) & (CHUNK_WIDTH - 1))
+/* Index of a section block, in x-major order */
+#define block_index(x, y, z) ((((y) * CHUNK_WIDTH) + (z)) * CHUNK_WIDTH + (x))
+
+/* Order of the blocks in the packed section indices, the unpacked blocks
+ * are always in x-major order. In the Morton (Z-order) layout the bits of
+ * x, y and z are interleaved, so the neighbors along every axis are close
+ * in memory. */
+enum section_layout {
+	SECTION_LAYOUT_LINEAR,
+	SECTION_LAYOUT_MORTON,
+	section_layout_count
+};
+
+/* Next and previous index along the axis whose bits are `mask`, see
+ * `get_section_axis_masks()`. The carry goes through the bits of the
+ * other axes, so it works in both layouts. It wraps around the section. */
+#define section_index_increment(index, mask) (((((index) | ~(mask)) + 1) & (mask)) | ((index) & ~(mask)))
+#define section_index_decrement(index, mask) (((((index) & (mask)) - 1) & (mask)) | ((index) & ~(mask)))
+
+/* The textures of each face are in `block_textures`, see mesher.c */
+enum block_type {
+	BLOCK_AIR = 0,
+	BLOCK_STONE_BRICKS,
+	BLOCK_BRICKS,
+	BLOCK_GRASS,
+	BLOCK_SAND,
+	BLOCK_COARSE_DIRT,
+	block_type_count
+};
+
+/* Palette indices are at most PALETTE_MAX_BITS wide, a section with more
+ * distinct blocks stores the blocks themselves in DIRECT_BITS */
+#define PALETTE_MAX_BITS 4
+#define PALETTE_CAPACITY (1 << PALETTE_MAX_BITS)
+#define DIRECT_BITS 8
+
+/* The blocks of a section as indices in a palette of its distinct blocks,
+ * packed in `bits` per block in the section layout order. The
+ * bits are 0, 1, 2, 4 or 8, so an index never crosses a 64 bit word, and
+ * they widen when a block that is not in the palette is set. A section of
+ * a single block has no indices.
+ * */
+struct chunk_section {
+	/* NULL for 0 bits */
+	struct section_indices *indices;
+	uint8_t bits;
+	uint8_t palette_count;
+	uint8_t palette[PALETTE_CAPACITY];
+};
+
+/* Sections of a single block, the whole section is `palette[0]`. Sections
+ * are made uniform when filled with `section_set_blocks()`, but setting
+ * the blocks one by one never shrinks the indices back. */
+#define section_is_uniform(section) (!(section)->bits)
+#define section_is_empty(section) (section_is_uniform(section) && (section)->palette[0] == BLOCK_AIR)
+
+/* Progress of a chunk through the streaming, see world_streamer.c */
+enum chunk_state {
+	CHUNK_GENERATING = 0,
+	CHUNK_GENERATED,
+	CHUNK_MESHING,
+	CHUNK_MESHED
+};
+
+struct chunk {
+	int32_t x;
+	int32_t z;
+	/* Only used by the thread that owns the world */
+	uint8_t state;
+	/* Worker tasks reading or writing the blocks, it can't be freed before
+	 * they are done */
+	uint8_t pins;
+	/* Generated, but not in the region files yet */
+	bool unsaved;
+	/* Bytes of its mesh, on the GPU or waiting for the upload */
+	uint32_t mesh_size;
+	/* Bytes of its blocks, measured by the streamer when no task writes
+	 * them, 0 while generating */
+	size_t memory_size;
+	/* Last streamer update that found it in the view distance, the least
+	 * recently visible chunks are evicted first */
+	uint64_t last_visible;
+	struct chunk_section sections[SECTIONS_PER_CHUNK];
+	/* Used once removed from the world, see `world_retire_chunk()` */
+	struct epoch_node retire_node;
+};
+
+struct chunk_slot {
+	_Atomic uint64_t key;
+	/* NULL if the slot was never used, the key of a used slot never
+	 * changes, so the readers never see a half written slot */
+	_Atomic(struct chunk *) chunk;
+};
+
+/* Open addressing hash table with linear probing. A removed chunk leaves
+ * a tombstone, only reused by the same key, and the tombstones are dropped
+ * when the table is rebuilt. */
+struct chunk_table {
+	uint32_t capacity;
+	/* Slots with a chunk or a tombstone */
+	uint32_t used;
+	struct epoch_node retire_node;
+	struct chunk_slot slots[];
+};
+
+/* Chunks keyed by their packed chunk coordinate. The lookups never lock
+ * nor retry, so any thread can look chunks up while another one inserts
+ * and removes them. Insertions and removals are serialized with a lock.
+ * The replaced tables and the removed chunks are freed by epochs.
+ * */
+struct world {
+	_Atomic(struct chunk_table *) table;
+	pthread_mutex_t write_lock;
+	/* Only changed with the write lock */
+	uint32_t count;
+};
+
+/* Only before any chunk is created, the chunks of another layout can't
+ * be read anymore */
+void
+set_section_layout(enum section_layout layout);
+
+enum section_layout
+get_section_layout();
+
+const char *
+get_section_layout_name(enum section_layout layout);
+
+int
+parse_section_layout(const char *name, enum section_layout *layout);
+
+/* Index of a block in the packed indices, in the current layout */
+uint32_t
+get_section_index(int x, int y, int z);
+
+/* The bits of x, y and z in a packed index of `layout` */
+void
+get_section_axis_masks(enum section_layout layout, uint32_t masks[3]);
+
+/* A chunk full of air */
+struct chunk *
+create_chunk(int32_t x, int32_t z);
+
+void
+destroy_chunk(struct chunk *chunk);
+
+/* Unpack the SECTION_VOLUME blocks of the section, in x-major order */
+void
+section_get_blocks(const struct chunk_section *section, uint8_t *blocks);
+
+/* Unpack the blocks in the order of the layout, see `get_section_index()` */
+void
+section_get_packed_blocks(const struct chunk_section *section, uint8_t *blocks);
+
+/* Replace all the blocks of the section, the palette only keeps the
+ * blocks used */
+int
+section_set_blocks(struct chunk_section *section, const uint8_t *blocks);
+
+/* Make the section uniform, it never fails */
+void
+section_fill(struct chunk_section *section, uint8_t block);
+
+/* `y` is chunk local, in other words it goes from 0 to CHUNK_HEIGHT - 1 */
+uint8_t
+chunk_get_block(const struct chunk *chunk, int x, int y, int z);
+
+/* Fails if the section indices had to widen and the allocation failed */
+int
+chunk_set_block(struct chunk *chunk, int x, int y, int z, uint8_t block);
+
+/* Memory used by the chunk and its blocks, the shared indices are split
+ * between their sections */
+size_t
+get_chunk_memory_size(const struct chunk *chunk);
+
+int
+world_init(struct world *world, uint32_t capacity);
+
+void
+world_destroy(struct world *world);
+
+/* Wait free. The threads that do not remove chunks must look them up
+ * between `epoch_enter()` and `epoch_leave()`, and can only use the
+ * chunk until `epoch_leave()`. */
+struct chunk *
+world_get_chunk(const struct world *world, int32_t x, int32_t z);
+
+int
+world_insert_chunk(struct world *world, struct chunk *chunk);
+
+/* Other threads may still read the chunk, retire it instead of destroying it */
+struct chunk *
+world_remove_chunk(struct world *world, int32_t x, int32_t z);
+
+/* Destroy a removed chunk once no thread can be reading it */
+void
+world_retire_chunk(struct chunk *chunk);
+
+/* Iterate the chunks, `*cursor` starts at 0. Chunks can be removed while
+ * iterating, but not inserted. Returns NULL after the last chunk. */
+struct chunk *
+world_next_chunk(const struct world *world, uint32_t *cursor);
+
+/* Coordinates are in world space, outside the loaded world everything is
+ * air. The same rules of `world_get_chunk()` apply. */
+uint8_t
+world_get_block(const struct world *world, int32_t x, int32_t y, int32_t z);
+
+#endif //WORLD_H
@@ -0,0 +1,601 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <sched.h>
+#include <math.h>
+
+#include "world_streamer.h"
+#include "constants.h"
+#include "terrain.h"
+#include "utils.h"
+
+#define INITIAL_UNLOADED_CAPACITY 64
+#define INITIAL_EVICTABLE_CAPACITY 256
+#define STATS_REPORT_INTERVAL_US 1e6
+
+static size_t chunk_budget = DEFAULT_CHUNK_MEMORY_BUDGET_MIB * 1024 * 1024;
+static size_t mesh_budget = DEFAULT_MESH_MEMORY_BUDGET_MIB * 1024 * 1024;
+static bool stats_enabled = false;
+
+/* Saves an unloaded chunk and frees it */
+struct save_task {
+	struct pool_task task;
+	struct region_store *regions;
+	struct chunk *chunk;
+};
+
+/* Results of the task submitters */
+#define SUBMIT_QUEUE_FULL 1
+
+void
+set_memory_budget(size_t chunk_bytes, size_t mesh_bytes)
+{
+	chunk_budget = chunk_bytes;
+	mesh_budget = mesh_bytes;
+}
+
+void
+set_streamer_stats_enabled(bool enabled)
+{
+	stats_enabled = enabled;
+}
+
+static void
+run_mesh_task(struct pool_task *task)
+{
+	struct mesh_task *mesh_task = (struct mesh_task *) task;
+	const struct chunk *neighbors[4] = {
+		mesh_task->neighbors[0], mesh_task->neighbors[1], mesh_task->neighbors[2], mesh_task->neighbors[3]
+	};
+
+	mesh_task->failed = mesh_chunk_with_neighbors(&mesh_task->mesh, mesh_task->chunk, neighbors) != 0;
+}
+
+static void
+run_save_task(struct pool_task *task)
+{
+	struct save_task *save_task = (struct save_task *) task;
+
+	/* On failure it is generated again next time */
+	region_store_save_chunk(save_task->regions, save_task->chunk);
+}
+
+static int32_t
+get_chunk_distance(const struct world_streamer *streamer, int32_t x, int32_t z)
+{
+	return max(abs(x - streamer->center_x), abs(z - streamer->center_z));
+}
+
+void
+world_streamer_init(struct world_streamer *streamer, struct world *world, fnl_state *noise,
+					struct worker_pool *workers, struct region_store *regions, int view_distance)
+{
+	memset(streamer, 0, sizeof(struct world_streamer));
+
+	streamer->world = world;
+	streamer->noise = noise;
+	streamer->workers = workers;
+	streamer->regions = regions;
+	streamer->view_distance = view_distance;
+	streamer->chunk_budget = chunk_budget;
+	streamer->mesh_budget = mesh_budget;
+	streamer->dirty = true;
+	clock_gettime(CLOCK_MONOTONIC, &streamer->report_start);
+}
+
+void
+world_streamer_release_mesh(struct mesh_task *mesh_task)
+{
+	chunk_mesh_destroy(&mesh_task->mesh);
+	free(mesh_task);
+}
+
+/* A chunk that failed to generate or to mesh is only logged, the next
+ * update submits it again */
+static void
+finish_task(struct world_streamer *streamer, struct pool_task *task)
+{
+	struct terrain_task *terrain_task;
+	struct save_task *save_task;
+	struct mesh_task *mesh_task;
+	int i;
+
+	streamer->tasks_in_flight--;
+	streamer->dirty = true;
+
+	if (task->run == run_save_task) {
+		save_task = (struct save_task *) task;
+		world_retire_chunk(save_task->chunk);
+		free(save_task);
+		return;
+	}
+
+	if (task->run != run_mesh_task) {
+		terrain_task = (struct terrain_task *) task;
+		terrain_task->chunk->pins--;
+
+		if (terrain_task->failed) {
+			pprint_error("Failed to generate the chunk (%d, %d)", terrain_task->chunk->x, terrain_task->chunk->z);
+			world_remove_chunk(streamer->world, terrain_task->chunk->x, terrain_task->chunk->z);
+			world_retire_chunk(terrain_task->chunk);
+			free(terrain_task);
+			return;
+		}
+
+		/* Nothing else pinned it while it was generating */
+		terrain_task->chunk->state = CHUNK_GENERATED;
+		terrain_task->chunk->memory_size = get_chunk_memory_size(terrain_task->chunk);
+		free(terrain_task);
+		return;
+	}
+
+	mesh_task = (struct mesh_task *) task;
+	mesh_task->chunk->pins--;
+	for (i = 0; i < 4; i++)
+		mesh_task->neighbors[i]->pins--;
+
+	if (mesh_task->failed) {
+		pprint_error("Failed to mesh the chunk (%d, %d)", mesh_task->x, mesh_task->z);
+		mesh_task->chunk->state = CHUNK_GENERATED;
+		world_streamer_release_mesh(mesh_task);
+		return;
+	}
+
+	mesh_task->chunk->state = CHUNK_MESHED;
+	mesh_task->chunk->mesh_size = get_chunk_mesh_size(&mesh_task->mesh);
+	mesh_task->next = NULL;
+	if (streamer->meshes_tail)
+		streamer->meshes_tail->next = mesh_task;
+	else
+		streamer->meshes_head = mesh_task;
+	streamer->meshes_tail = mesh_task;
+}
+
+void
+world_streamer_destroy(struct world_streamer *streamer)
+{
+	struct world *world = streamer->world;
+	struct mesh_task *mesh_task;
+	struct pool_task *task;
+	struct chunk *chunk;
+	uint32_t cursor = 0;
+
+	/* The tasks point to chunks of the world, they must finish before it
+	 * is destroyed */
+	while (streamer->tasks_in_flight) {
+		task = worker_pool_poll(streamer->workers);
+		if (task)
+			finish_task(streamer, task);
+		else
+			sched_yield();
+	}
+
+	if (streamer->regions)
+		while ((chunk = world_next_chunk(world, &cursor)))
+			if (chunk->unsaved)
+				region_store_save_chunk(streamer->regions, chunk);
+
+	while ((mesh_task = world_streamer_pop_mesh(streamer)))
+		world_streamer_release_mesh(mesh_task);
+
+	free(streamer->unloaded);
+	streamer->unloaded = NULL;
+	streamer->unloaded_count = streamer->unloaded_capacity = 0;
+
+	free(streamer->evictable);
+	streamer->evictable = NULL;
+	streamer->evictable_capacity = 0;
+}
+
+static int
+push_unloaded(struct world_streamer *streamer, int32_t x, int32_t z)
+{
+	struct unloaded_chunk *unloaded;
+	uint32_t capacity;
+
+	if (streamer->unloaded_count == streamer->unloaded_capacity) {
+		capacity = streamer->unloaded_capacity ? streamer->unloaded_capacity * 2 : INITIAL_UNLOADED_CAPACITY;
+		unloaded = realloc(streamer->unloaded, sizeof(struct unloaded_chunk) * capacity);
+		if (!unloaded) {
+			print_error("Failed to grow the unloaded chunks vector!");
+			return -1;
+		}
+
+		streamer->unloaded = unloaded;
+		streamer->unloaded_capacity = capacity;
+	}
+
+	streamer->unloaded[streamer->unloaded_count++] = (struct unloaded_chunk) { .x = x, .z = z };
+
+	return 0;
+}
+
+/* A mesh of an unloaded chunk waiting for the backend is stale */
+static void
+drop_finished_meshes(struct world_streamer *streamer, int32_t x, int32_t z)
+{
+	struct mesh_task **link = &streamer->meshes_head;
+	struct mesh_task *mesh_task;
+
+	streamer->meshes_tail = NULL;
+
+	while ((mesh_task = *link)) {
+		if (mesh_task->x == x && mesh_task->z == z) {
+			*link = mesh_task->next;
+			world_streamer_release_mesh(mesh_task);
+			continue;
+		}
+
+		streamer->meshes_tail = mesh_task;
+		link = &mesh_task->next;
+	}
+}
+
+/* The chunk is not in the world anymore, but it is only freed once saved */
+static int
+submit_save(struct world_streamer *streamer, struct chunk *chunk)
+{
+	struct save_task *save_task;
+
+	save_task = malloc(sizeof(struct save_task));
+	if (!save_task) {
+		print_error("Failed to allocate save task!");
+		return -1;
+	}
+
+	save_task->task.run = run_save_task;
+	save_task->regions = streamer->regions;
+	save_task->chunk = chunk;
+
+	if (worker_pool_submit(streamer->workers, &save_task->task)) {
+		free(save_task);
+		return SUBMIT_QUEUE_FULL;
+	}
+
+	streamer->tasks_in_flight++;
+
+	return 0;
+}
+
+static int
+push_evictable(struct world_streamer *streamer, struct chunk *chunk, uint32_t count)
+{
+	struct chunk **evictable;
+	uint32_t capacity;
+
+	if (count == streamer->evictable_capacity) {
+		capacity = streamer->evictable_capacity ? streamer->evictable_capacity * 2 : INITIAL_EVICTABLE_CAPACITY;
+		evictable = realloc(streamer->evictable, sizeof(struct chunk *) * capacity);
+		if (!evictable) {
+			print_error("Failed to grow the evictable chunks vector!");
+			return -1;
+		}
+
+		streamer->evictable = evictable;
+		streamer->evictable_capacity = capacity;
+	}
+
+	streamer->evictable[count] = chunk;
+
+	return 0;
+}
+
+static int
+compare_last_visible(const void *a, const void *b)
+{
+	const struct chunk *chunk_a = *(const struct chunk **) a;
+	const struct chunk *chunk_b = *(const struct chunk **) b;
+
+	return (chunk_a->last_visible > chunk_b->last_visible) - (chunk_a->last_visible < chunk_b->last_visible);
+}
+
+static int
+evict_chunk(struct world_streamer *streamer, struct chunk *chunk)
+{
+	struct streamer_stats *stats = &streamer->stats;
+	int ret;
+
+	if (chunk->state == CHUNK_MESHED && push_unloaded(streamer, chunk->x, chunk->z))
+		return -1;
+
+	/* Dirty chunks are written back before they are dropped. Once the save
+	 * is submitted nothing may fail, the task frees the chunk when done. */
+	if (streamer->regions && chunk->unsaved) {
+		ret = submit_save(streamer, chunk);
+		if (ret) {
+			/* Still loaded, its mesh stays */
+			if (chunk->state == CHUNK_MESHED)
+				streamer->unloaded_count--;
+			return ret;
+		}
+		stats->written_back++;
+	}
+
+	drop_finished_meshes(streamer, chunk->x, chunk->z);
+
+	stats->chunks--;
+	stats->meshes -= chunk->mesh_size != 0;
+	stats->chunk_bytes -= chunk->memory_size;
+	stats->mesh_bytes -= chunk->mesh_size;
+	stats->evicted++;
+
+	/* Retired once saved */
+	world_remove_chunk(streamer->world, chunk->x, chunk->z);
+	if (!streamer->regions || !chunk->unsaved)
+		world_retire_chunk(chunk);
+
+	return 0;
+}
+
+/* Count the resident chunks, and evict the cached ones until the chunks
+ * fit in the budgets again */
+static int
+evict_chunks(struct world_streamer *streamer)
+{
+	struct streamer_stats *stats = &streamer->stats;
+	struct world *world = streamer->world;
+	uint32_t cursor = 0, count = 0, i;
+	struct chunk *chunk;
+	int32_t distance;
+	int ret;
+
+	streamer->scans++;
+	stats->chunks = stats->meshes = 0;
+	stats->chunk_bytes = stats->mesh_bytes = 0;
+
+	while ((chunk = world_next_chunk(world, &cursor))) {
+		distance = get_chunk_distance(streamer, chunk->x, chunk->z);
+		if (distance <= streamer->view_distance)
+			chunk->last_visible = streamer->scans;
+
+		stats->chunks++;
+		stats->meshes += chunk->mesh_size != 0;
+		/* The blocks of a pinned chunk may be written by a worker, it
+		 * keeps the size measured before */
+		if (!chunk->pins && chunk->state != CHUNK_GENERATING)
+			chunk->memory_size = get_chunk_memory_size(chunk);
+		stats->chunk_bytes += chunk->memory_size;
+		stats->mesh_bytes += chunk->mesh_size;
+
+		/* Pinned chunks are evicted once their tasks finish */
+		if (chunk->pins || distance <= streamer->view_distance + 2)
+			continue;
+
+		if (push_evictable(streamer, chunk, count++))
+			return -1;
+	}
+
+	qsort(streamer->evictable, count, sizeof(struct chunk *), compare_last_visible);
+
+	for (i = 0; i < count; i++) {
+		if (stats->chunk_bytes <= streamer->chunk_budget && stats->mesh_bytes <= streamer->mesh_budget)
+			break;
+
+		ret = evict_chunk(streamer, streamer->evictable[i]);
+		/* Try again on the next update */
+		if (ret == SUBMIT_QUEUE_FULL) {
+			streamer->dirty = true;
+			return 0;
+		}
+		if (ret)
+			return -1;
+	}
+
+	return 0;
+}
+
+static int
+submit_generation(struct world_streamer *streamer, int32_t x, int32_t z)
+{
+	struct terrain_task *terrain_task;
+	struct chunk *chunk;
+
+	terrain_task = malloc(sizeof(struct terrain_task));
+	if (!terrain_task) {
+		print_error("Failed to allocate terrain task!");
+		return -1;
+	}
+
+	chunk = create_chunk(x, z);
+	if (!chunk)
+		goto free_task;
+
+	/* In the world before the task finishes, so it is not submitted again */
+	if (world_insert_chunk(streamer->world, chunk))
+		goto free_chunk;
+
+	init_terrain_task(terrain_task, streamer->noise, streamer->regions, chunk);
+
+	if (worker_pool_submit(streamer->workers, &terrain_task->task)) {
+		world_remove_chunk(streamer->world, x, z);
+		world_retire_chunk(chunk);
+		free(terrain_task);
+		return SUBMIT_QUEUE_FULL;
+	}
+
+	/* The worker owns the blocks until the task is done */
+	chunk->pins = 1;
+	streamer->tasks_in_flight++;
+
+	return 0;
+
+free_chunk:
+	destroy_chunk(chunk);
+free_task:
+	free(terrain_task);
+	return -1;
+}
+
+static int
+submit_mesh(struct world_streamer *streamer, struct chunk *chunk)
+{
+	struct world *world = streamer->world;
+	struct mesh_task *mesh_task;
+	struct chunk *neighbors[4] = {
+		world_get_chunk(world, chunk->x - 1, chunk->z),
+		world_get_chunk(world, chunk->x + 1, chunk->z),
+		world_get_chunk(world, chunk->x, chunk->z - 1),
+		world_get_chunk(world, chunk->x, chunk->z + 1),
+	};
+	int i;
+
+	/* The mesh of the chunk border depends on the neighbor blocks */
+	for (i = 0; i < 4; i++)
+		if (!neighbors[i] || neighbors[i]->state == CHUNK_GENERATING)
+			return 0;
+
+	mesh_task = malloc(sizeof(struct mesh_task));
+	if (!mesh_task) {
+		print_error("Failed to allocate mesh task!");
+		return -1;
+	}
+
+	mesh_task->task.run = run_mesh_task;
+	mesh_task->chunk = chunk;
+	mesh_task->x = chunk->x;
+	mesh_task->z = chunk->z;
+	memcpy(mesh_task->neighbors, neighbors, sizeof(neighbors));
+	chunk_mesh_init(&mesh_task->mesh);
+
+	if (worker_pool_submit(streamer->workers, &mesh_task->task)) {
+		free(mesh_task);
+		return SUBMIT_QUEUE_FULL;
+	}
+
+	chunk->state = CHUNK_MESHING;
+	chunk->pins++;
+	for (i = 0; i < 4; i++)
+		neighbors[i]->pins++;
+	streamer->tasks_in_flight++;
+
+	return 0;
+}
+
+static int
+submit_chunk_tasks(struct world_streamer *streamer, int32_t x, int32_t z, int distance)
+{
+	struct chunk *chunk;
+
+	chunk = world_get_chunk(streamer->world, x, z);
+	if (!chunk)
+		return submit_generation(streamer, x, z);
+
+	if (chunk->state == CHUNK_GENERATED && distance <= streamer->view_distance)
+		return submit_mesh(streamer, chunk);
+
+	return 0;
+}
+
+/* Walk the rings around the player from the inside out, so the closest
+ * chunks are the first ones submitted */
+static int
+submit_tasks(struct world_streamer *streamer)
+{
+	int32_t x = streamer->center_x, z = streamer->center_z;
+	int distance, i, ret;
+
+	ret = submit_chunk_tasks(streamer, x, z, 0);
+
+	for (distance = 1; !ret && distance <= streamer->view_distance + 1; distance++) {
+		for (i = -distance; !ret && i <= distance; i++) {
+			ret = submit_chunk_tasks(streamer, x + i, z - distance, distance);
+			if (!ret)
+				ret = submit_chunk_tasks(streamer, x + i, z + distance, distance);
+		}
+
+		for (i = -distance + 1; !ret && i < distance; i++) {
+			ret = submit_chunk_tasks(streamer, x - distance, z + i, distance);
+			if (!ret)
+				ret = submit_chunk_tasks(streamer, x + distance, z + i, distance);
+		}
+	}
+
+	/* Try again on the next update */
+	if (ret == SUBMIT_QUEUE_FULL) {
+		streamer->dirty = true;
+		return 0;
+	}
+
+	return ret;
+}
+
+static void
+report_stats(struct world_streamer *streamer)
+{
+	const struct streamer_stats *stats = &streamer->stats;
+	struct timespec now;
+
+	if (!stats_enabled)
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if ((now.tv_sec - streamer->report_start.tv_sec) * 1e6 +
+		(now.tv_nsec - streamer->report_start.tv_nsec) / 1e3 < STATS_REPORT_INTERVAL_US)
+		return;
+
+	printf("chunks: %u resident, %.1f/%.1f MiB, %u meshes, %.1f/%.1f MiB, %lu evicted, %lu written back\n",
+		   stats->chunks, stats->chunk_bytes / 1048576.0, streamer->chunk_budget / 1048576.0,
+		   stats->meshes, stats->mesh_bytes / 1048576.0, streamer->mesh_budget / 1048576.0,
+		   (unsigned long) stats->evicted, (unsigned long) stats->written_back);
+
+	streamer->report_start = now;
+}
+
+int
+world_streamer_update(struct world_streamer *streamer, const vec3 position)
+{
+	/* Blocks are centered at their integer coordinates */
+	int32_t center_x = to_chunk_coordinate(floorf(position[0] + 0.5f));
+	int32_t center_z = to_chunk_coordinate(floorf(position[2] + 0.5f));
+	struct pool_task *task;
+
+	while ((task = worker_pool_poll(streamer->workers)))
+		finish_task(streamer, task);
+
+	/* Free the chunks retired on the previous updates */
+	epoch_collect();
+
+	report_stats(streamer);
+
+	if (center_x != streamer->center_x || center_z != streamer->center_z) {
+		streamer->center_x = center_x;
+		streamer->center_z = center_z;
+		streamer->dirty = true;
+	}
+
+	if (!streamer->dirty)
+		return 0;
+
+	streamer->dirty = false;
+
+	if (evict_chunks(streamer))
+		return -1;
+
+	return submit_tasks(streamer);
+}
+
+struct mesh_task *
+world_streamer_pop_mesh(struct world_streamer *streamer)
+{
+	struct mesh_task *mesh_task = streamer->meshes_head;
+
+	if (!mesh_task)
+		return NULL;
+
+	streamer->meshes_head = mesh_task->next;
+	if (!streamer->meshes_head)
+		streamer->meshes_tail = NULL;
+
+	return mesh_task;
+}
+
+bool
+world_streamer_pop_unloaded(struct world_streamer *streamer, struct unloaded_chunk *chunk)
+{
+	if (!streamer->unloaded_count)
+		return false;
+
+	*chunk = streamer->unloaded[--streamer->unloaded_count];
+
+	return true;
+}
@@ -0,0 +1,124 @@
+#ifndef WORLD_STREAMER_H
+#define WORLD_STREAMER_H
+
+#include <cglm/cglm.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "FastNoise/FastNoiseLite.h"
+#include "worker_pool.h"
+#include "mesher.h"
+#include "region.h"
+#include "world.h"
+
+/* A chunk mesh built on a worker thread */
+struct mesh_task {
+	struct pool_task task;
+	struct chunk *chunk;
+	/* Pinned with the chunk until the mesh is done */
+	struct chunk *neighbors[4];
+	int32_t x;
+	int32_t z;
+	struct chunk_mesh mesh;
+	bool failed;
+	/* Next finished mesh waiting for the backend */
+	struct mesh_task *next;
+};
+
+/* Chunk coordinate whose mesh must not be drawn anymore */
+struct unloaded_chunk {
+	int32_t x;
+	int32_t z;
+};
+
+/* Resident chunks, updated on every scan for new tasks */
+struct streamer_stats {
+	uint32_t chunks;
+	/* Chunks with a mesh that is not empty */
+	uint32_t meshes;
+	size_t chunk_bytes;
+	size_t mesh_bytes;
+	/* Since the streamer was created */
+	uint64_t evicted;
+	uint64_t written_back;
+};
+
+/* Keeps the chunks around the player loaded, generated and meshed. All the
+ * chunk work runs on the worker pool, the main thread only submits tasks
+ * and collects the results.
+ * A chunk is generated up to `view_distance + 1` chunks from the player
+ * and meshed up to `view_distance`, once its four neighbors are generated.
+ * Further than `view_distance + 2` it is only kept as a cache, the extra
+ * chunk keeps the player from reloading chunks when walking on a chunk
+ * border. Once the blocks or the meshes of the loaded chunks go over their
+ * memory budget, the cached chunks are evicted, the least recently visible
+ * first. A budget of 0 evicts them as soon as they leave.
+ * Generated chunks are saved to the region files when evicted, and the
+ * chunks already saved are loaded from them instead of generated.
+ * */
+struct world_streamer {
+	struct world *world;
+	fnl_state *noise;
+	struct worker_pool *workers;
+	/* NULL if the chunks are not saved */
+	struct region_store *regions;
+	int view_distance;
+	size_t chunk_budget;
+	size_t mesh_budget;
+	/* Chunk of the player on the last update */
+	int32_t center_x;
+	int32_t center_z;
+	/* Scans for new tasks so far, the clock of the eviction */
+	uint64_t scans;
+	/* Something changed since the last scan for new tasks */
+	bool dirty;
+	uint32_t tasks_in_flight;
+	/* Finished meshes, in the order they were completed */
+	struct mesh_task *meshes_head;
+	struct mesh_task *meshes_tail;
+	/* Chunks unloaded since the last `world_streamer_pop_unloaded()` */
+	struct unloaded_chunk *unloaded;
+	uint32_t unloaded_count;
+	uint32_t unloaded_capacity;
+	/* Cached chunks sorted for the eviction, kept between scans */
+	struct chunk **evictable;
+	uint32_t evictable_capacity;
+	struct streamer_stats stats;
+	struct timespec report_start;
+};
+
+/* Bytes kept for the chunk blocks and for the chunk meshes by the next
+ * streamers, see `struct world_streamer` */
+void
+set_memory_budget(size_t chunk_bytes, size_t mesh_bytes);
+
+/* Print the resident chunk statistics every second */
+void
+set_streamer_stats_enabled(bool enabled);
+
+void
+world_streamer_init(struct world_streamer *streamer, struct world *world, fnl_state *noise,
+					struct worker_pool *workers, struct region_store *regions, int view_distance);
+
+/* Waits for the tasks in flight and saves the loaded chunks, so call it
+ * before destroying the workers */
+void
+world_streamer_destroy(struct world_streamer *streamer);
+
+/* Never waits for the workers, the chunks are loaded as the tasks finish */
+int
+world_streamer_update(struct world_streamer *streamer, const vec3 position);
+
+/* Returns NULL if there is no new mesh, release it when done */
+struct mesh_task *
+world_streamer_pop_mesh(struct world_streamer *streamer);
+
+void
+world_streamer_release_mesh(struct mesh_task *mesh_task);
+
+/* Returns false if no chunk was unloaded */
+bool
+world_streamer_pop_unloaded(struct world_streamer *streamer, struct unloaded_chunk *chunk);
+
+#endif //WORLD_STREAMER_H
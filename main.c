@@ -1,8 +1,16 @@
+#include <stdbool.h>
 #include <getopt.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <errno.h>
 
+#include "upload_scheduler.h"
+#include "cpu_dispatch.h"
+#include "constants.h"
+#include "benchmark.h"
+#include "mesher.h"
 #include "gl_backend.h"
 #include "vk_backend.h"
 #include "utils.h"
@@ -12,28 +20,77 @@
     "Usage:\tmainCraft.run --backend vulkan\n" \
     "Options:\n" \
     "\t-b,\t--backend\t Selct backend (vulkan or opengl).\n" \
+    "\t-s,\t--simd\t Widest instruction set used (scalar, sse4.1, avx2 or avx512).\n" \
+    "\t-m,\t--mesher\t Chunk mesher (naive, greedy or binary).\n" \
+    "\t-l,\t--layout\t Order of the blocks in the chunk sections (linear or morton).\n" \
+    "\t\t--bench-meshers\t Time every mesher on the same chunks and exit.\n" \
+    "\t\t--bench-layouts\t Time and count the cache misses of every section layout and exit.\n" \
+    "\t\t--chunk-budget\t MiB kept for the chunk blocks, 0 drops the chunks out of the view at once.\n" \
+    "\t\t--mesh-budget\t MiB kept for the chunk meshes, 0 drops the meshes out of the view at once.\n" \
+    "\t\t--stats\t Print the chunk upload and memory statistics every second.\n" \
     "\t-h,\t--help\t Show This Message.\n\n" \
 
 
 enum backend_type { vulkan, opengl };
 
+/* Long only options */
+#define BENCH_MESHERS_OPTION 256
+#define STATS_OPTION 257
+#define BENCH_LAYOUTS_OPTION 258
+#define CHUNK_BUDGET_OPTION 259
+#define MESH_BUDGET_OPTION 260
+#define BENCHMARK_RADIUS 8
+
 // Inicialization of long options of opt
 #define LONG_OPTIONS \
 	{ \
 		{"backend", required_argument, NULL, 'b'}, \
+		{"simd", required_argument, NULL, 's'}, \
+		{"mesher", required_argument, NULL, 'm'}, \
+		{"layout", required_argument, NULL, 'l'}, \
+		{"bench-meshers", no_argument, NULL, BENCH_MESHERS_OPTION}, \
+		{"bench-layouts", no_argument, NULL, BENCH_LAYOUTS_OPTION}, \
+		{"chunk-budget", required_argument, NULL, CHUNK_BUDGET_OPTION}, \
+		{"mesh-budget", required_argument, NULL, MESH_BUDGET_OPTION}, \
+		{"stats", no_argument, NULL, STATS_OPTION}, \
 		{"help", no_argument, NULL, 'h'}, \
 		{0, 0, 0, 0} \
 	}
 
+/* Returns -1 if `text` is not a whole number of MiB, or does not fit in
+ * size_t once in bytes */
+static int
+parse_mebibytes(const char *text, size_t *bytes)
+{
+	unsigned long value;
+	char *end;
+
+	errno = 0;
+	value = strtoul(text, &end, 10);
+	if (end == text || *end || *text == '-' || errno == ERANGE || value > SIZE_MAX / (1024 * 1024))
+		return -1;
+
+	*bytes = (size_t) value * 1024 * 1024;
+
+	return 0;
+}
+
 /* main program */
 int
 main(const int argc, char *const *argv)
 {
+	enum simd_level max_simd_level = SIMD_AVX512;
+	enum section_layout layout = SECTION_LAYOUT_LINEAR;
+	enum mesher_type mesher = MESHER_BINARY;
 	enum backend_type backend = vulkan;
+	bool bench_meshers = false;
+	bool bench_layouts = false;
+	size_t chunk_budget = (size_t) DEFAULT_CHUNK_MEMORY_BUDGET_MIB * 1024 * 1024;
+	size_t mesh_budget = (size_t) DEFAULT_MESH_MEMORY_BUDGET_MIB * 1024 * 1024;
 	struct option longOptions[] = LONG_OPTIONS;
 	int option = 0;
 
-	while ((option = getopt_long(argc, argv, "b:h", longOptions, NULL)) != -1) {
+	while ((option = getopt_long(argc, argv, "b:s:m:l:h", longOptions, NULL)) != -1) {
 		switch (option){
 		case 'b':
 			if (!strcmp(optarg, "vulkan"))
@@ -45,6 +102,46 @@ main(const int argc, char *const *argv)
 				exit(EXIT_FAILURE);
 			}
 			break;
+		case 's':
+			if (parse_simd_level(optarg, &max_simd_level)) {
+				pprint_error("'%s' is not a valid instruction set\n", optarg);
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case 'm':
+			if (parse_mesher_type(optarg, &mesher)) {
+				pprint_error("'%s' is not a valid mesher\n", optarg);
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case 'l':
+			if (parse_section_layout(optarg, &layout)) {
+				pprint_error("'%s' is not a valid layout\n", optarg);
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case BENCH_MESHERS_OPTION:
+			bench_meshers = true;
+			break;
+		case BENCH_LAYOUTS_OPTION:
+			bench_layouts = true;
+			break;
+		case CHUNK_BUDGET_OPTION:
+			if (parse_mebibytes(optarg, &chunk_budget)) {
+				pprint_error("'%s' is not a valid budget\n", optarg);
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case MESH_BUDGET_OPTION:
+			if (parse_mebibytes(optarg, &mesh_budget)) {
+				pprint_error("'%s' is not a valid budget\n", optarg);
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case STATS_OPTION:
+			set_upload_stats_enabled(true);
+			set_streamer_stats_enabled(true);
+			break;
 		case 'h':
 			printf(HELP_MESSAGE);
 			exit(EXIT_SUCCESS);
@@ -56,6 +153,20 @@ main(const int argc, char *const *argv)
 		}
 	}
 
+	init_cpu_dispatch(max_simd_level);
+
+	if (bench_meshers)
+		exit(run_mesher_benchmark(BENCHMARK_RADIUS) ? EXIT_FAILURE : EXIT_SUCCESS);
+
+	set_mesher_type(mesher);
+
+	if (bench_layouts)
+		exit(run_layout_benchmark(BENCHMARK_RADIUS) ? EXIT_FAILURE : EXIT_SUCCESS);
+
+	/* Before any chunk exists */
+	set_section_layout(layout);
+	set_memory_budget(chunk_budget, mesh_budget);
+
 	if (backend == opengl)
 		exit(run_gl(argc, argv));
 	else
@@ -2,12 +2,15 @@
 #extension GL_ARB_separate_shader_objects : enable
 
 layout(set = 0, binding = 1) uniform sampler samp;
-layout(set = 0, binding = 2) uniform texture2D textures[6];
+layout(set = 0, binding = 2) uniform texture2DArray textures;
 
 layout(location = 1) in vec2 fragTexCoord;
+layout(location = 2) flat in uint fragTextureLayer;
+layout(location = 3) in float fragShade;
 
 layout(location = 0) out vec4 outColor;
 
 void main() {
-    outColor = texture(sampler2D(textures[2], samp), fragTexCoord);
+    vec4 color = texture(sampler2DArray(textures, samp), vec3(fragTexCoord, fragTextureLayer));
+    outColor = vec4(color.rgb * fragShade, color.a);
 }
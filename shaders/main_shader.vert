@@ -5,19 +5,28 @@ layout(set = 0, binding = 0) uniform VP {
 	mat4 view_proj;
 } camera;
 
-layout(location = 0) in vec3 inPosition;
-layout(location = 1) in vec2 inTexCoord;
-layout(location = 2) in vec3 inModelPosition;
+/* World position of the chunk being drawn */
+layout(push_constant) uniform Chunk {
+	vec3 origin;
+} chunk;
+
+/* Packed `struct vertex`, see game_objects.h
+ * x: x (5 bits) | y (7 bits) | z (5 bits) | face (3 bits) | AO (2 bits)
+ * y: u (8 bits) | v (8 bits) | texture layer (8 bits) */
+layout(location = 0) in uvec2 inVertex;
 
 layout(location = 1) out vec2 fragTexCoord;
+layout(location = 2) flat out uint fragTextureLayer;
+layout(location = 3) out float fragShade;
 
 void main() {
-	mat4 modelMatrix = mat4(vec4(1.0, 0.0, 0.0,   0.0),
-							vec4(0.0, 1.0, 0.0,   0.0),
-							vec4(0.0, 0.0, 1.0,   0.0),
-							vec4(inModelPosition, 1.0));
+	vec3 position = vec3(bitfieldExtract(inVertex.x, 0, 5),
+						 bitfieldExtract(inVertex.x, 5, 7),
+						 bitfieldExtract(inVertex.x, 12, 5));
+	uint ao = bitfieldExtract(inVertex.x, 20, 2);
 
-	gl_Position = camera.view_proj * modelMatrix * vec4(inPosition, 1.0);
-	fragTexCoord = inTexCoord;
+	gl_Position = camera.view_proj * vec4(chunk.origin + position, 1.0);
+	fragTexCoord = vec2(bitfieldExtract(inVertex.y, 0, 8), bitfieldExtract(inVertex.y, 8, 8));
+	fragTextureLayer = bitfieldExtract(inVertex.y, 16, 8);
+	fragShade = 0.4 + 0.2 * float(ao);
 }
-
@@ -2,6 +2,9 @@
 #include <stdio.h>
 
 #include "vk_resource_manager.h"
+#include "vk_command_buffer.h"
+#include "vk_deletion_queue.h"
+#include "vk_gpu_objects.h"
 #include "player_view.h"
 #include "vk_window.h"
 #include "vk_draw.h"
@@ -23,13 +26,34 @@ vk_main_loop(struct vk_program *program)
 
 		update_position_and_view(window, &program->game_window.input, game, camera->view, -1.0f);
 
+		ret = world_streamer_update(&game->terrain.streamer, game->player.position);
+		if (ret)
+			break;
+
 		ret = acquire_swapchain_image(program, current_frame, &imageIndex);
 		if (ret == VK_ERROR_OUT_OF_DATE_KHR)
 			continue;
 		if (ret == -1)
 			break;
 
-		update_view_projection(dev->logical_device, camera, imageIndex);
+		/* The frame that last used this part of the ring is done */
+		frame_ring_begin_frame(&dev->frame_ring, current_frame);
+
+		/* Before the uploads, they may reuse the freed ranges */
+		collect_deferred_destructions(dev);
+
+		ret = update_view_projection(&dev->frame_ring, camera);
+		if (ret)
+			break;
+
+		ret = stream_chunk_meshes(dev, &game->terrain.streamer, game->player.position);
+		if (ret)
+			break;
+
+		ret = record_draw_cmd(&dev->cmd_submission, &dev->swapchain, &dev->render, &dev->game_objs,
+							  &dev->upload_engine, imageIndex);
+		if (ret)
+			break;
 
 		ret = draw_frame(program, current_frame, imageIndex);
 		if (ret)
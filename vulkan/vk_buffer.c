@@ -1,31 +1,12 @@
-#include <string.h>
-
-#include "vk_command_buffer.h"
 #include "vk_buffer.h"
 #include "utils.h"
 
 
-int64_t
-find_memory_type(VkPhysicalDevice physical_device, uint32_t type_filter, VkMemoryPropertyFlags prop)
-{
-	VkPhysicalDeviceMemoryProperties mem_prop;
-	uint32_t i;
-
-	vkGetPhysicalDeviceMemoryProperties(physical_device, &mem_prop);
-
-	for (i = 0; i < mem_prop.memoryTypeCount; i++)
-		if ((type_filter & (1 << i)) && (mem_prop.memoryTypes[i].propertyFlags & prop) == prop)
-			return i;
-
-	return -1;
-}
-
-int
-create_buffer(struct vk_device *dev, VkDeviceSize size, VkBufferUsageFlags usage,
-			 VkMemoryPropertyFlags properties, VkBuffer *buffer, VkDeviceMemory *buffer_memory)
+static int
+init_buffer(struct vk_device *dev, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+			bool shared, VkBuffer *buffer, struct memory_allocation *buffer_memory)
 {
 	VkMemoryRequirements mem_requirements;
-	int64_t mem_type;
 	VkResult result;
 
 	VkBufferCreateInfo buffer_info = {
@@ -35,6 +16,17 @@ create_buffer(struct vk_device *dev, VkDeviceSize size, VkBufferUsageFlags usage
 		.sharingMode = VK_SHARING_MODE_EXCLUSIVE
 	};
 
+	uint32_t families[] = {
+		dev->cmd_submission.family_indices[graphics],
+		dev->cmd_submission.family_indices[transfer]
+	};
+
+	if (shared && dev->cmd_submission.cmd_buffers_count[transfer] > 0) {
+		buffer_info.sharingMode = VK_SHARING_MODE_CONCURRENT;
+		buffer_info.queueFamilyIndexCount = array_size(families);
+		buffer_info.pQueueFamilyIndices = families;
+	}
+
 	result = vkCreateBuffer(dev->logical_device, &buffer_info, NULL, buffer);
 	if (result != VK_SUCCESS) {
 		print_error("Failed to create buffer!");
@@ -42,25 +34,13 @@ create_buffer(struct vk_device *dev, VkDeviceSize size, VkBufferUsageFlags usage
 	}
 
 	vkGetBufferMemoryRequirements(dev->logical_device, *buffer, &mem_requirements);
-	mem_type = find_memory_type(dev->physical_device, mem_requirements.memoryTypeBits, properties);
-	if (mem_type == -1) {
-		print_error("Failed to find suitable memory type!");
-		goto destroy_buffer;
-	}
-
-	VkMemoryAllocateInfo alloc_info = {
-		.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-		.allocationSize = mem_requirements.size,
-		.memoryTypeIndex = (uint32_t) mem_type
-	};
 
-	result = vkAllocateMemory(dev->logical_device, &alloc_info, NULL, buffer_memory);
-	if (result != VK_SUCCESS) {
+	if (allocate_device_memory(&dev->allocator, &mem_requirements, properties, MEMORY_LINEAR, buffer_memory)) {
 		print_error("Failed to allocate buffer memory!");
 		goto destroy_buffer;
 	}
 
-	result = vkBindBufferMemory(dev->logical_device, *buffer, *buffer_memory, 0);
+	result = vkBindBufferMemory(dev->logical_device, *buffer, buffer_memory->memory, buffer_memory->offset);
 	if (result != VK_SUCCESS) {
 		print_error("Failed to bind buffer with buffer memory!");
 		goto free_memory_buffer;
@@ -69,7 +49,7 @@ create_buffer(struct vk_device *dev, VkDeviceSize size, VkBufferUsageFlags usage
 	return 0;
 
 free_memory_buffer:
-	vkFreeMemory(dev->logical_device, *buffer_memory, NULL);
+	free_device_memory(&dev->allocator, buffer_memory);
 destroy_buffer:
 	vkDestroyBuffer(dev->logical_device, *buffer, NULL);
 return_error:
@@ -77,82 +57,22 @@ return_error:
 }
 
 int
-copy_buffer(struct vk_cmd_submission *cmd_sub, VkBuffer src_buffer, VkBuffer dst_buffer, VkDeviceSize size)
+create_buffer(struct vk_device *dev, VkDeviceSize size, VkBufferUsageFlags usage,
+			 VkMemoryPropertyFlags properties, VkBuffer *buffer, struct memory_allocation *buffer_memory)
 {
-	VkCommandBuffer cmd_buffer;
-	VkResult result;
-	VkQueue queue;
-
-	if (cmd_sub->cmd_buffers_count[transfer] > 0) {
-		cmd_buffer = cmd_sub->cmd_buffers[transfer][0];
-		queue = cmd_sub->queue_handles[transfer];
-	} else {
-		cmd_buffer = cmd_sub->cmd_buffers[graphics][0];
-		queue = cmd_sub->queue_handles[graphics];
-	}
-
-	result = begin_single_time_commands(cmd_buffer);
-	if (result != VK_SUCCESS)
-		return -1;
-
-	VkBufferCopy copy_region = {
-		.size = size
-	};
-
-	vkCmdCopyBuffer(cmd_buffer, src_buffer, dst_buffer, 1, &copy_region);
-
-	result = end_single_time_commands(cmd_buffer, queue);
-	if (result != VK_SUCCESS)
-		return -1;
-
-	return 0;
+	return init_buffer(dev, size, usage, properties, false, buffer, buffer_memory);
 }
 
 int
-create_gpu_buffer(struct vk_device *dev, VkDeviceMemory *buffer_memory, VkBuffer *buffer,
-				  void *buffer_data, VkDeviceSize buffer_size, VkBufferUsageFlags usage)
+create_shared_buffer(struct vk_device *dev, VkDeviceSize size, VkBufferUsageFlags usage,
+					 VkMemoryPropertyFlags properties, VkBuffer *buffer, struct memory_allocation *buffer_memory)
 {
-	VkDeviceMemory staging_buffer_memory, local_buffer_memory;
-	VkBuffer staging_buffer, local_buffer;
-	VkResult result;
-	void *data;
-	int ret;
-
-	ret = create_buffer(dev, buffer_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-					   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-					   &staging_buffer, &staging_buffer_memory);
-	if (ret)
-		goto return_error;
-
-	result = vkMapMemory(dev->logical_device, staging_buffer_memory, 0, buffer_size, 0, &data);
-	if (result != VK_SUCCESS) {
-		print_error("Failed to map buffer to system memory!");
-		goto destoy_staging_buffer;
-	}
-
-	memcpy(data, buffer_data, (size_t) buffer_size);
-	vkUnmapMemory(dev->logical_device, staging_buffer_memory);
-
-	ret = create_buffer(dev, buffer_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage,
-					   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &local_buffer, &local_buffer_memory);
-	if (ret)
-		goto destoy_staging_buffer;
-
-	if (copy_buffer(&dev->cmd_submission, staging_buffer, local_buffer, buffer_size)) {
-		vkDestroyBuffer(dev->logical_device, local_buffer, NULL);
-		vkFreeMemory(dev->logical_device, local_buffer_memory, NULL);
-		goto destoy_staging_buffer;
-	}
-
-	*buffer = local_buffer;
-	*buffer_memory = local_buffer_memory;
-
-	ret = 0;
-
-destoy_staging_buffer:
-	vkDestroyBuffer(dev->logical_device, staging_buffer, NULL);
-	vkFreeMemory(dev->logical_device, staging_buffer_memory, NULL);
-return_error:
-	return ret;
+	return init_buffer(dev, size, usage, properties, true, buffer, buffer_memory);
 }
 
+void
+destroy_buffer(struct vk_device *dev, VkBuffer buffer, struct memory_allocation *buffer_memory)
+{
+	vkDestroyBuffer(dev->logical_device, buffer, NULL);
+	free_device_memory(&dev->allocator, buffer_memory);
+}
@@ -6,21 +6,18 @@
 #include "vk_types.h"
 
 
-int64_t
-find_memory_type(VkPhysicalDevice physical_device, uint32_t type_filter, VkMemoryPropertyFlags prop);
-
-int
-copy_buffer(struct vk_cmd_submission *cmd_sub, VkBuffer src_buffer, VkBuffer dst_buffer, VkDeviceSize size);
-
-int
-create_gpu_buffer(struct vk_device *dev, VkDeviceMemory *buffer_memory, VkBuffer *buffer,
-				  void *buffer_data, VkDeviceSize buffer_size, VkBufferUsageFlags usage);
-
 int
 create_buffer(struct vk_device *dev, VkDeviceSize size, VkBufferUsageFlags usage,
-			  VkMemoryPropertyFlags properties, VkBuffer *buffer, VkDeviceMemory *buffer_memory);
+			  VkMemoryPropertyFlags properties, VkBuffer *buffer, struct memory_allocation *buffer_memory);
 
+/* Used by the graphics and the transfer families at once, with no
+ * ownership transfer. The families are given with the concurrent sharing
+ * mode, when they differ. */
 int
-copy_buffer(struct vk_cmd_submission *cmd_sub, VkBuffer src_buffer, VkBuffer dst_buffer, VkDeviceSize size);
+create_shared_buffer(struct vk_device *dev, VkDeviceSize size, VkBufferUsageFlags usage,
+					 VkMemoryPropertyFlags properties, VkBuffer *buffer, struct memory_allocation *buffer_memory);
+
+void
+destroy_buffer(struct vk_device *dev, VkBuffer buffer, struct memory_allocation *buffer_memory);
 
 #endif //VK_BUFFER_H
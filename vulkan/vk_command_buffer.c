@@ -3,6 +3,7 @@
 
 #include "vk_command_buffer.h"
 #include "constants.h"
+#include "mesher.h"
 #include "utils.h"
 
 
@@ -84,17 +85,12 @@ create_command_pools(struct vk_device *dev)
 	const uint32_t *family_index = dev->cmd_submission.family_indices;
 	VkCommandPool *cmd_pool = dev->cmd_submission.command_pools;
 
-	/* If we don't have a transfer queue we need to use the graphics queue to
-	 * transfer the buffers and images, then we need to set the flag
-	 * VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT to reuse graphics
-	 * command buffers to transfer things and render things by reseting command
-	 * buffers.
+	/* The graphics command buffers are recorded again every frame and, if we
+	 * don't have a transfer queue, they are also reused to transfer the
+	 * buffers and images, so they must be resetable.
 	 *  */
-	if (dev->cmd_submission.queue_count[transfer])
-		cmd_pool[graphics] = alloc_command_pool(dev->logical_device, family_index[graphics], 0);
-	else
-		cmd_pool[graphics] = alloc_command_pool(dev->logical_device, family_index[graphics],
-												VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+	cmd_pool[graphics] = alloc_command_pool(dev->logical_device, family_index[graphics],
+											VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
 	if (cmd_pool[graphics] == VK_NULL_HANDLE)
 		goto return_error;
 
@@ -146,17 +142,20 @@ return_error:
 }
 
 int
-record_draw_cmd(struct vk_cmd_submission *cmd_sub, struct vk_swapchain *swapchain,
-				struct vk_render *render, struct vk_game_objects *game_objects)
+record_draw_cmd(struct vk_cmd_submission *cmd_sub, struct vk_swapchain *swapchain, struct vk_render *render,
+				struct vk_game_objects *game_objects, struct upload_engine *upload_engine, uint32_t image_index)
 {
-	struct vk_vertex_object *obj = &game_objects->cube;
-	VkCommandBuffer **cmd_buffers = cmd_sub->cmd_buffers;
-	VkBuffer vertex_buffers[] = { obj->vertex_buffer };
-	VkBuffer index_buffer = obj->index_buffer;
-	uint32_t index_count = obj->indices_count;
+	VkCommandBuffer cmd_buffer = cmd_sub->cmd_buffers[graphics][image_index];
+	struct mesh_arenas *arenas = &game_objects->arenas;
 	VkDeviceSize offsets[] = { 0 };
+	struct vk_mesh_move *move;
+	struct vk_chunk_mesh *mesh;
+	uint32_t first_index;
+	int32_t vertex_offset;
+	uint32_t arena;
 	VkResult result;
-	int i;
+	vec3 origin;
+	int i, j;
 
 	VkClearValue clear_values[] = {
 		/* workarround: https://gcc.gnu.org/bugzilla/show_bug.cgi?id=80454 */
@@ -164,51 +163,133 @@ record_draw_cmd(struct vk_cmd_submission *cmd_sub, struct vk_swapchain *swapchai
 		{ .depthStencil = { .depth = 1.0f, .stencil = 0.0f } }
 	};
 
+	/* Recorded again every frame, the chunk meshes change as the player
+	 * moves. The pool resets the buffer on begin. */
 	VkCommandBufferBeginInfo begin_info = {
 		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-		.flags = 0,
+		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
 	};
 
-	for (i = 0; i < swapchain->images_count; i++) {
-		result = vkBeginCommandBuffer(cmd_buffers[graphics][i], &begin_info);
-		if (result != VK_SUCCESS) {
-			print_error("Failed to begin recording command buffer!");
-			return -1;
-		}
+	result = vkBeginCommandBuffer(cmd_buffer, &begin_info);
+	if (result != VK_SUCCESS) {
+		print_error("Failed to begin recording command buffer!");
+		return -1;
+	}
+
+	upload_engine_acquire(upload_engine, cmd_buffer);
+
+	/* The meshes moved by the compaction are drawn from their new range.
+	 * The copies of the previous frames may still write the ranges read or
+	 * written now, and a copy may read what an earlier one wrote. */
+	VkMemoryBarrier copy_barrier = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+		.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT
+	};
+
+	for (i = 0; i < game_objects->mesh_move_count; i++) {
+		move = &game_objects->mesh_moves[i];
+
+		for (j = 0; j < i; j++)
+			if (are_arena_ranges_overlapping(&move->src, &game_objects->mesh_moves[j].dst))
+				break;
+
+		if (i == 0 || j < i)
+			vkCmdPipelineBarrier(cmd_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+								 0, 1, &copy_barrier, 0, NULL, 0, NULL);
+
+		VkBufferCopy copy_region = {
+			.srcOffset = move->src.offset,
+			.dstOffset = move->dst.offset,
+			.size = move->size
+		};
+
+		vkCmdCopyBuffer(cmd_buffer, arenas->arenas[move->src.arena].buffer,
+						arenas->arenas[move->dst.arena].buffer, 1, &copy_region);
+	}
 
-		VkRenderPassBeginInfo render_pass_info = {
-			.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-			.renderPass = render->render_pass,
-			.framebuffer = render->swapChain_framebuffers[i],
-			.renderArea.offset = { 0, 0 },
-			.renderArea.extent = swapchain->state.extent,
-			.clearValueCount = array_size(clear_values),
-			.pClearValues = clear_values
+	if (game_objects->mesh_move_count) {
+		VkMemoryBarrier barrier = {
+			.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+			.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+			.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT
 		};
 
-		vkCmdBeginRenderPass(cmd_buffers[graphics][i], &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
+		vkCmdPipelineBarrier(cmd_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+							 0, 1, &barrier, 0, NULL, 0, NULL);
+	}
+
+	VkRenderPassBeginInfo render_pass_info = {
+		.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+		.renderPass = render->render_pass,
+		.framebuffer = render->swapChain_framebuffers[image_index],
+		.renderArea.offset = { 0, 0 },
+		.renderArea.extent = swapchain->state.extent,
+		.clearValueCount = array_size(clear_values),
+		.pClearValues = clear_values
+	};
+
+	vkCmdBeginRenderPass(cmd_buffer, &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
+
+	vkCmdBindPipeline(cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, render->graphics_pipeline);
+
+	/* Dynamic states of the pipeline, it is kept when the window is resized */
+	VkViewport viewport = {
+		.x = 0.0f,
+		.y = 0.0f,
+		.width = swapchain->state.extent.width,
+		.height = swapchain->state.extent.height,
+		.minDepth = 0.0f,
+		.maxDepth = 1.0f
+	};
+
+	VkRect2D scissor = {
+		.offset = { 0, 0 },
+		.extent = swapchain->state.extent
+	};
+
+	vkCmdSetViewport(cmd_buffer, 0, 1, &viewport);
+	vkCmdSetScissor(cmd_buffer, 0, 1, &scissor);
 
-		vkCmdBindPipeline(cmd_buffers[graphics][i], VK_PIPELINE_BIND_POINT_GRAPHICS, render->graphics_pipeline);
+	vkCmdBindDescriptorSets(cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+							render->pipeline_layout, 0, 1, &cmd_sub->descriptor_sets[image_index],
+							1, &game_objects->camera.offset);
 
-		vkCmdBindVertexBuffers(cmd_buffers[graphics][i], 0, array_size(vertex_buffers), vertex_buffers, offsets);
+	/* Every arena is bound once, as the vertex and the index buffer. Then
+	 * one draw per chunk, the vertices are relative to the chunk origin. */
+	for (arena = 0; arena < arenas->arena_count; arena++) {
+		vkCmdBindVertexBuffers(cmd_buffer, 0, 1, &arenas->arenas[arena].buffer, offsets);
 
-		vkCmdBindVertexBuffers(cmd_buffers[graphics][i], 1, 1, &obj->position_buffer[i], offsets);
+		vkCmdBindIndexBuffer(cmd_buffer, arenas->arenas[arena].buffer, 0, VK_INDEX_TYPE_UINT32);
 
-		vkCmdBindIndexBuffer(cmd_buffers[graphics][i], index_buffer, 0, VK_INDEX_TYPE_UINT16);
+		for (i = 0; i < game_objects->chunk_mesh_count; i++) {
+			mesh = &game_objects->chunk_meshes[i];
+			if (mesh->range.arena != arena ||
+				abs(mesh->x - game_objects->center_x) > game_objects->draw_distance ||
+				abs(mesh->z - game_objects->center_z) > game_objects->draw_distance)
+				continue;
 
-		vkCmdBindDescriptorSets(cmd_buffers[graphics][i], VK_PIPELINE_BIND_POINT_GRAPHICS,
-								render->pipeline_layout, 0, 1, &cmd_sub->descriptor_sets[i], 0, NULL);
+			get_chunk_origin(mesh->x, mesh->z, origin);
 
-		vkCmdDrawIndexed(cmd_buffers[graphics][i], index_count, obj->position_count, 0, 0, 0);
+			vkCmdPushConstants(cmd_buffer, render->pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT,
+							   0, sizeof(vec3), origin);
 
-		vkCmdEndRenderPass(cmd_buffers[graphics][i]);
+			/* The ranges are aligned to more than a vertex */
+			vertex_offset = mesh->range.offset / sizeof(struct vertex);
+			first_index = (mesh->range.offset + sizeof(struct vertex) * mesh->vertex_count) / sizeof(uint32_t);
 
-		result = vkEndCommandBuffer(cmd_buffers[graphics][i]);
-		if (result != VK_SUCCESS) {
-			print_error("Failed to record command buffer!");
-			return -1;
+			vkCmdDrawIndexed(cmd_buffer, mesh->index_count, 1, first_index, vertex_offset, 0);
 		}
 	}
+
+	vkCmdEndRenderPass(cmd_buffer);
+
+	result = vkEndCommandBuffer(cmd_buffer);
+	if (result != VK_SUCCESS) {
+		print_error("Failed to record command buffer!");
+		return -1;
+	}
+
 	return 0;
 }
 
@@ -248,8 +329,8 @@ end_single_time_commands(VkCommandBuffer cmd_buffer, VkQueue queue)
 		.pCommandBuffers = &cmd_buffer
 	};
 
-	/* TODO: Maybe we could be interesting use fences to do that if we have a more
-	 * complex scenario with a lot of transfer and other stuffs going on
+	/* Only the uploads done once at startup come here, the ones of the
+	 * frames go through the upload engine and never wait the queue
 	 * */
 	result = vkQueueSubmit(queue, 1, &submit_info, VK_NULL_HANDLE);
 	if (result != VK_SUCCESS) {
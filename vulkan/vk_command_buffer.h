@@ -23,9 +23,12 @@ free_command_buffer_vector(VkCommandBuffer *cmd_buffers[]);
 int
 create_cmd_submission_infra(struct vk_device *device, uint32_t buffer_count);
 
+/* Record the draw of the current chunk meshes to the command buffer of the
+ * swapchain image, it must not be in use by the GPU. The buffers uploaded
+ * for the frame are acquired first. */
 int
-record_draw_cmd(struct vk_cmd_submission *cmd_sub, struct vk_swapchain *swapchain,
-				struct vk_render *render, struct vk_game_objects *game_objects);
+record_draw_cmd(struct vk_cmd_submission *cmd_sub, struct vk_swapchain *swapchain, struct vk_render *render,
+				struct vk_game_objects *game_objects, struct upload_engine *upload_engine, uint32_t image_index);
 
 VkResult
 begin_single_time_commands(VkCommandBuffer cmd_buffer);
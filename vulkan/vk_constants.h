@@ -11,7 +11,17 @@
 #endif
 
 #define MAX_FRAMES_IN_FLIGHT 2
-#define CUBES_POSITION_BUFFER_SIZE 1048576 // 1 MB
+/* Budget of the chunk mesh uploads of a frame, see `struct upload_scheduler` */
+#define UPLOAD_BYTES_PER_FRAME (2 * 1024 * 1024)
+#define UPLOAD_TIME_PER_FRAME_US 2000.0
+/* Per frame part of the frame ring, the staged meshes can go a little over
+ * the upload budget, see `struct frame_ring` */
+#define FRAME_RING_SIZE (2 * UPLOAD_BYTES_PER_FRAME)
+/* Size of the device memory blocks split between the resources, see
+ * `struct memory_allocator` */
+#define MEMORY_BLOCK_SIZE (64 * 1024 * 1024)
+/* Chunk meshes moved to the front of the mesh arenas each frame */
+#define MESH_MOVES_PER_FRAME 4
 
 extern const char *validation_layers[1];
 extern const char *device_extensions[1];
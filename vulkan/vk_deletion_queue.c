@@ -0,0 +1,146 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "vk_deletion_queue.h"
+#include "vk_buffer.h"
+#include "vk_image.h"
+#include "vk_draw.h"
+#include "utils.h"
+
+#define INITIAL_DELETION_QUEUE_CAPACITY 64
+
+static void
+destroy_deferred(struct vk_device *dev, const struct deferred_destruction *deferred)
+{
+	struct memory_allocation memory;
+
+	switch (deferred->kind) {
+	case deferred_buffer:
+		memory = deferred->buffer.memory;
+		destroy_buffer(dev, deferred->buffer.buffer, &memory);
+		break;
+	case deferred_image:
+		if (deferred->image.view)
+			vkDestroyImageView(dev->logical_device, deferred->image.view, NULL);
+		memory = deferred->image.memory;
+		destroy_image(dev, deferred->image.image, &memory);
+		break;
+	case deferred_arena_range:
+		free_arena_range(dev, &dev->game_objs.arenas, &deferred->range);
+		break;
+	case deferred_image_view:
+		vkDestroyImageView(dev->logical_device, deferred->image_view, NULL);
+		break;
+	case deferred_framebuffer:
+		vkDestroyFramebuffer(dev->logical_device, deferred->framebuffer, NULL);
+		break;
+	case deferred_swapchain:
+		vkDestroySwapchainKHR(dev->logical_device, deferred->swapchain, NULL);
+		break;
+	}
+}
+
+void
+defer_destruction(struct vk_device *dev, struct deferred_destruction *deferred)
+{
+	struct deletion_queue *queue = &dev->deletion_queue;
+	struct deferred_destruction *entries;
+	uint32_t capacity;
+
+	if (queue->count == queue->capacity) {
+		capacity = queue->capacity ? queue->capacity * 2 : INITIAL_DELETION_QUEUE_CAPACITY;
+		entries = realloc(queue->entries, sizeof(struct deferred_destruction) * capacity);
+		if (!entries) {
+			print_error("Failed to grow the deletion queue, waiting for the device!");
+			vkDeviceWaitIdle(dev->logical_device);
+			destroy_deferred(dev, deferred);
+			return;
+		}
+
+		queue->entries = entries;
+		queue->capacity = capacity;
+	}
+
+	if (!deferred->frame)
+		deferred->frame = get_recording_frame(&dev->draw_sync);
+
+	queue->entries[queue->count++] = *deferred;
+}
+
+void
+defer_buffer_destruction(struct vk_device *dev, VkBuffer buffer, const struct memory_allocation *memory)
+{
+	struct deferred_destruction deferred = {
+		.kind = deferred_buffer,
+		.buffer.buffer = buffer,
+		.buffer.memory = *memory
+	};
+
+	defer_destruction(dev, &deferred);
+}
+
+void
+defer_image_destruction(struct vk_device *dev, VkImage image, VkImageView view,
+						const struct memory_allocation *memory)
+{
+	struct deferred_destruction deferred = {
+		.kind = deferred_image,
+		.image.image = image,
+		.image.view = view,
+		.image.memory = *memory
+	};
+
+	defer_destruction(dev, &deferred);
+}
+
+void
+defer_arena_range_free(struct vk_device *dev, const struct arena_range *range)
+{
+	struct deferred_destruction deferred = {
+		.kind = deferred_arena_range,
+		.range = *range
+	};
+
+	defer_destruction(dev, &deferred);
+}
+
+/* Destroying an entry may defer a new one, like the buffer of an arena left
+ * empty by a range, it is appended and visited by the same loop */
+static void
+collect_until(struct vk_device *dev, uint64_t completed)
+{
+	struct deletion_queue *queue = &dev->deletion_queue;
+	struct deferred_destruction deferred;
+	uint32_t i = 0;
+
+	while (i < queue->count) {
+		if (queue->entries[i].frame > completed) {
+			i++;
+			continue;
+		}
+
+		deferred = queue->entries[i];
+		queue->entries[i] = queue->entries[--queue->count];
+		destroy_deferred(dev, &deferred);
+	}
+}
+
+void
+collect_deferred_destructions(struct vk_device *dev)
+{
+	struct vk_draw_sync *sync = &dev->draw_sync;
+
+	if (!dev->deletion_queue.count)
+		return;
+
+	collect_until(dev, get_timeline_value(dev->logical_device, sync->frame_timeline, &sync->frame_completed));
+}
+
+void
+deletion_queue_destroy(struct vk_device *dev)
+{
+	collect_until(dev, UINT64_MAX);
+
+	free(dev->deletion_queue.entries);
+	memset(&dev->deletion_queue, 0, sizeof(struct deletion_queue));
+}
@@ -0,0 +1,73 @@
+#ifndef VK_DELETION_QUEUE_H
+#define VK_DELETION_QUEUE_H
+
+#include <vulkan/vulkan.h>
+#include <stdint.h>
+
+#include "vk_mesh_arena.h"
+#include "vk_memory.h"
+
+struct vk_device;
+
+enum deferred_kind {
+	deferred_buffer, deferred_image, deferred_arena_range, deferred_image_view, deferred_framebuffer,
+	deferred_swapchain
+};
+
+/* A resource the frames in flight may still use, destroyed once the frame
+ * timeline reaches `frame`. Left at 0 it is the frame being recorded. */
+struct deferred_destruction {
+	enum deferred_kind kind;
+	uint64_t frame;
+	union {
+		struct {
+			VkBuffer buffer;
+			struct memory_allocation memory;
+		} buffer;
+		struct {
+			VkImage image;
+			VkImageView view;
+			struct memory_allocation memory;
+		} image;
+		struct arena_range range;
+		VkImageView image_view;
+		VkFramebuffer framebuffer;
+		VkSwapchainKHR swapchain;
+	};
+};
+
+/* Lets the resources go while frames are in flight, without idling the
+ * device. Each one is stamped with the frame being recorded, the last one
+ * that can use it, and destroyed by the first frame that finds it done.
+ * */
+struct deletion_queue {
+	struct deferred_destruction *entries;
+	uint32_t count;
+	uint32_t capacity;
+};
+
+/* If the queue can not grow the device is waited and the resource is
+ * destroyed right away, so these never fail */
+void
+defer_destruction(struct vk_device *dev, struct deferred_destruction *deferred);
+
+void
+defer_buffer_destruction(struct vk_device *dev, VkBuffer buffer, const struct memory_allocation *memory);
+
+/* The view may be VK_NULL_HANDLE */
+void
+defer_image_destruction(struct vk_device *dev, VkImage image, VkImageView view,
+						const struct memory_allocation *memory);
+
+void
+defer_arena_range_free(struct vk_device *dev, const struct arena_range *range);
+
+/* Never waits, what is still in use is checked again next frame */
+void
+collect_deferred_destructions(struct vk_device *dev);
+
+/* The device must be idle, everything left is destroyed */
+void
+deletion_queue_destroy(struct vk_device *dev);
+
+#endif //VK_DELETION_QUEUE_H
@@ -17,38 +17,15 @@ void
 get_vertex_attribute_descriptions(uint32_t binding, uint32_t first_location,
 								  VkVertexInputAttributeDescription *attribute_descriptions)
 {
+	/* Both words of the packed vertex, main_shader.vert decodes them */
 	attribute_descriptions[0].binding = binding;
 	attribute_descriptions[0].location = first_location;
-	attribute_descriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-	attribute_descriptions[0].offset = offsetof(struct vertex, pos);
-
-	attribute_descriptions[1].binding = binding;
-	attribute_descriptions[1].location = first_location + 1;
-	attribute_descriptions[1].format = VK_FORMAT_R32G32_SFLOAT;
-	attribute_descriptions[1].offset = offsetof(struct vertex, texCoord);
-}
-
-void
-get_vec3_binding_description(uint32_t binding, VkVertexInputRate input_rate,
-							 VkVertexInputBindingDescription *binding_description)
-{
-	binding_description[0].binding = binding;
-	binding_description[0].stride = sizeof(vec3);
-	binding_description[0].inputRate = input_rate;
-}
-
-void
-get_vec3_attribute_descriptions(uint32_t binding, uint32_t first_location,
-								VkVertexInputAttributeDescription *attribute_descriptions)
-{
-	attribute_descriptions[0].binding = binding;
-	attribute_descriptions[0].location = first_location;
-	attribute_descriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-	attribute_descriptions[0].offset = 0;
+	attribute_descriptions[0].format = VK_FORMAT_R32G32_UINT;
+	attribute_descriptions[0].offset = offsetof(struct vertex, position);
 }
 
 VkDescriptorSetLayout
-create_descriptor_set_layout_binding(VkDevice logical_device, uint32_t cube_texture_count)
+create_descriptor_set_layout_binding(VkDevice logical_device)
 {
 	VkDescriptorSetLayout descriptor_set_layout;
 	VkResult result;
@@ -56,7 +33,7 @@ create_descriptor_set_layout_binding(VkDevice logical_device, uint32_t cube_text
 	VkDescriptorSetLayoutBinding bindings[] = {
 		(VkDescriptorSetLayoutBinding) {
 			.binding = 0,
-			.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+			.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
 			.descriptorCount = 1,
 			.stageFlags = VK_SHADER_STAGE_VERTEX_BIT
 		},
@@ -69,7 +46,7 @@ create_descriptor_set_layout_binding(VkDevice logical_device, uint32_t cube_text
 		},
 		(VkDescriptorSetLayoutBinding) {
 			.binding = 2,
-			.descriptorCount = cube_texture_count,
+			.descriptorCount = 1,
 			.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
 			.pImmutableSamplers = NULL,
 			.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT
@@ -92,14 +69,14 @@ create_descriptor_set_layout_binding(VkDevice logical_device, uint32_t cube_text
 }
 
 VkDescriptorPool
-create_descriptor_pool(VkDevice logical_device, struct vk_swapchain *swapchain, uint32_t texture_count)
+create_descriptor_pool(VkDevice logical_device, struct vk_swapchain *swapchain)
 {
 	VkDescriptorPool descriptor_pool;
 	VkResult result;
 
 	VkDescriptorPoolSize pool_sizes[] = {
 		(VkDescriptorPoolSize) {
-			.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+			.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
 			.descriptorCount = swapchain->images_count
 		},
 		(VkDescriptorPoolSize) {
@@ -108,7 +85,7 @@ create_descriptor_pool(VkDevice logical_device, struct vk_swapchain *swapchain,
 		},
 		(VkDescriptorPoolSize) {
 			.type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
-			.descriptorCount = swapchain->images_count * texture_count
+			.descriptorCount = swapchain->images_count
 		}
 	};
 
@@ -135,9 +112,7 @@ create_descriptor_sets(struct vk_device *dev, struct vk_cmd_submission *cmd_sub,
 {
 	uint32_t swapchain_images_size = dev->swapchain.images_count;
 	VkDescriptorSetLayout layouts[swapchain_images_size];
-	struct view_projection *camera = &dev->game_objs.camera;
-	struct vk_vertex_object *cube = &dev->game_objs.cube;
-	VkDescriptorImageInfo image_info[cube->texture_count];
+	struct vk_block_textures *textures = &dev->game_objs.textures;
 	VkDescriptorSet *descriptor_sets;
 	VkResult result;
 	size_t i;
@@ -167,19 +142,20 @@ create_descriptor_sets(struct vk_device *dev, struct vk_cmd_submission *cmd_sub,
 		goto descriptor_sets_vector;
 	}
 
-	for (i = 0; i < cube->texture_count; i++) {
-		image_info[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		image_info[i].imageView = cube->texture_images_view[i];
-		image_info[i].sampler = VK_NULL_HANDLE;
-	}
+	VkDescriptorImageInfo image_info = {
+		.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		.imageView = textures->image_view,
+		.sampler = VK_NULL_HANDLE
+	};
 
 	VkDescriptorImageInfo sampler_info = {
 		.sampler = dev->render.texture_sampler
 	};
 
 	for (i = 0; i < swapchain_images_size; i++) {
+		/* The offset of the frame is given when the set is bound */
 		VkDescriptorBufferInfo buffer_info = {
-			.buffer = camera->buffers[i],
+			.buffer = dev->frame_ring.buffer,
 			.offset = 0,
 			.range = sizeof(mat4),
 		};
@@ -191,7 +167,7 @@ create_descriptor_sets(struct vk_device *dev, struct vk_cmd_submission *cmd_sub,
 				.dstSet = descriptor_sets[i],
 				.dstBinding = 0,
 				.dstArrayElement = 0,
-				.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+				.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
 				.descriptorCount = 1,
 				.pBufferInfo = &buffer_info
 			},
@@ -210,8 +186,8 @@ create_descriptor_sets(struct vk_device *dev, struct vk_cmd_submission *cmd_sub,
 				.dstBinding = 2,
 				.dstArrayElement = 0,
 				.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
-				.descriptorCount = array_size(image_info),
-				.pImageInfo = image_info
+				.descriptorCount = 1,
+				.pImageInfo = &image_info
 			}
 		};
 
@@ -9,15 +9,77 @@
 #include "vk_draw.h"
 #include "utils.h"
 
+int
+create_timeline_semaphore(VkDevice logical_device, VkSemaphore *semaphore)
+{
+	VkResult result;
+
+	VkSemaphoreTypeCreateInfo type_info = {
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+		.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+		.initialValue = 0
+	};
+
+	VkSemaphoreCreateInfo semaphore_info = {
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+		.pNext = &type_info
+	};
+
+	result = vkCreateSemaphore(logical_device, &semaphore_info, NULL, semaphore);
+	if (result != VK_SUCCESS) {
+		print_error("Failed to create timeline semaphore!");
+		return -1;
+	}
+
+	return 0;
+}
+
+uint64_t
+get_timeline_value(VkDevice logical_device, VkSemaphore timeline, uint64_t *completed)
+{
+	uint64_t value;
+
+	if (vkGetSemaphoreCounterValue(logical_device, timeline, &value) == VK_SUCCESS)
+		*completed = max(*completed, value);
+
+	return *completed;
+}
+
+int
+wait_timeline(VkDevice logical_device, VkSemaphore timeline, uint64_t *completed, uint64_t value)
+{
+	VkResult result;
+
+	if (value <= *completed || value <= get_timeline_value(logical_device, timeline, completed))
+		return 0;
+
+	VkSemaphoreWaitInfo wait_info = {
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+		.semaphoreCount = 1,
+		.pSemaphores = &timeline,
+		.pValues = &value
+	};
+
+	result = vkWaitSemaphores(logical_device, &wait_info, UINT64_MAX);
+	if (result != VK_SUCCESS) {
+		print_error("Failed to wait timeline semaphore!");
+		return -1;
+	}
+
+	*completed = value;
+
+	return 0;
+}
+
 int
 create_sync_objects(VkDevice logical_device, struct vk_draw_sync *sync, uint32_t images_count)
 {
 	VkResult result;
 	int i;
 
-	sync->images_in_flight = calloc(sizeof(VkFence), images_count);
-	if (!sync->images_in_flight) {
-		print_error("Failed to allocate images_in_fligth vector");
+	sync->image_frames = calloc(sizeof(uint64_t), images_count);
+	if (!sync->image_frames) {
+		print_error("Failed to allocate image_frames vector");
 		return -1;
 	}
 
@@ -25,13 +87,7 @@ create_sync_objects(VkDevice logical_device, struct vk_draw_sync *sync, uint32_t
 		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO
 	};
 
-	VkFenceCreateInfo fence_info = {
-		.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
-		/* Create a fence that is already 'unlock', in other words
-		 * this fence start will not block anything at beggining */
-		.flags = VK_FENCE_CREATE_SIGNALED_BIT
-	};
-
+	/* The swapchain only takes binary semaphores */
 	for (i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
 		result = vkCreateSemaphore(logical_device, &semaphore_info, NULL, &sync->image_available_semaphore[i]);
 		if (result != VK_SUCCESS) {
@@ -44,19 +100,15 @@ create_sync_objects(VkDevice logical_device, struct vk_draw_sync *sync, uint32_t
 			print_error("Failed to create semaphores!");
 			break;
 		}
-
-		result = vkCreateFence(logical_device, &fence_info, NULL, &sync->in_flight_fences[i]);
-		if (result != VK_SUCCESS) {
-			print_error("Failed to create fences!");
-			break;
-		}
 	}
 
-	if (i != MAX_FRAMES_IN_FLIGHT) {
+	if (i != MAX_FRAMES_IN_FLIGHT || create_timeline_semaphore(logical_device, &sync->frame_timeline)) {
 		sync_objects_cleanup(logical_device, sync);
 		return -1;
 	}
 
+	sync->frame_submitted = sync->frame_completed = 0;
+
 	return 0;
 }
 
@@ -70,24 +122,30 @@ sync_objects_cleanup(VkDevice logical_device, struct vk_draw_sync *sync)
 			vkDestroySemaphore(logical_device, sync->render_finished_semaphore[i], NULL);
 		if (sync->image_available_semaphore[i])
 			vkDestroySemaphore(logical_device, sync->image_available_semaphore[i], NULL);
-		if (sync->in_flight_fences[i])
-			vkDestroyFence(logical_device, sync->in_flight_fences[i], NULL);
 	}
 
-	free(sync->images_in_flight);
+	if (sync->frame_timeline)
+		vkDestroySemaphore(logical_device, sync->frame_timeline, NULL);
+
+	free(sync->image_frames);
 }
 
-void
-update_view_projection(const VkDevice logical_device, struct view_projection *camera, uint32_t current_image)
+int
+update_view_projection(struct frame_ring *ring, struct view_projection *camera)
 {
-	mat4 view_proj;
-	void* data;
+	VkDeviceSize offset;
+	mat4 *view_proj;
 
-	glm_mat4_mulN((mat4 *[]){ &camera->proj, &camera->view }, 2, view_proj);
+	view_proj = frame_ring_alloc(ring, sizeof(mat4), &offset);
+	if (!view_proj) {
+		print_error("No room left for the view-projection in the frame ring!");
+		return -1;
+	}
 
-	vkMapMemory(logical_device, camera->buffers_memory[current_image], 0, sizeof(mat4), 0, &data);
-	memcpy(data, &view_proj, sizeof(mat4));
-	vkUnmapMemory(logical_device, camera->buffers_memory[current_image]);
+	glm_mat4_mulN((mat4 *[]){ &camera->proj, &camera->view }, 2, *view_proj);
+	camera->offset = (uint32_t) offset;
+
+	return 0;
 }
 
 int
@@ -95,13 +153,17 @@ acquire_swapchain_image(struct vk_program *program, uint8_t current_frame, uint3
 {
 	struct vk_device *dev = &program->device;
 	const VkDevice logical_device = dev->logical_device;
-	const struct vk_draw_sync *sync = &dev->draw_sync;
+	struct vk_draw_sync *sync = &dev->draw_sync;
 	VkSemaphore image_available_semaphore = sync->image_available_semaphore[current_frame];
-	VkFence in_flight_fences = sync->in_flight_fences[current_frame];
 	VkResult result;
 	int ret;
 
-	vkWaitForFences(logical_device, 1, &in_flight_fences, VK_TRUE, UINT64_MAX);
+	/* The semaphores and the frame ring part of the slot are reused, the
+	 * frame that had them must be done */
+	if (sync->frame_submitted >= MAX_FRAMES_IN_FLIGHT &&
+		wait_timeline(logical_device, sync->frame_timeline, &sync->frame_completed,
+					  sync->frame_submitted + 1 - MAX_FRAMES_IN_FLIGHT))
+		return -1;
 
 	result = vkAcquireNextImageKHR(logical_device, dev->swapchain.handle, UINT64_MAX,
 								   image_available_semaphore, VK_NULL_HANDLE, imageIndex);
@@ -116,16 +178,10 @@ acquire_swapchain_image(struct vk_program *program, uint8_t current_frame, uint3
 		return -1;
 	}
 
-	if (sync->images_in_flight[*imageIndex] != VK_NULL_HANDLE)
-		vkWaitForFences(logical_device, 1, &sync->images_in_flight[*imageIndex], VK_TRUE, UINT64_MAX);
-
-	sync->images_in_flight[*imageIndex] = in_flight_fences;
-
-	result = vkResetFences(logical_device, 1, &in_flight_fences);
-	if (result != VK_SUCCESS) {
-		print_error("Failed to reset fences!");
+	/* Its command buffer is recorded again, usually the frame that used
+	 * it last is already done and there is nothing to wait */
+	if (wait_timeline(logical_device, sync->frame_timeline, &sync->frame_completed, sync->image_frames[*imageIndex]))
 		return -1;
-	}
 
 	return 0;
 }
@@ -134,10 +190,10 @@ int
 draw_frame(struct vk_program *program, uint8_t current_frame, uint32_t imageIndex)
 {
 	struct vk_device *dev = &program->device;
-	const struct vk_draw_sync *sync = &dev->draw_sync;
+	struct vk_draw_sync *sync = &dev->draw_sync;
+	struct upload_engine *upload_engine = &dev->upload_engine;
 	VkSemaphore image_available_semaphore = sync->image_available_semaphore[current_frame];
 	VkSemaphore render_finished_semaphore = sync->render_finished_semaphore[current_frame];
-	VkFence in_flight_fences = sync->in_flight_fences[current_frame];
 	const VkQueue *queues = dev->cmd_submission.queue_handles;
 	bool *framebuffer_resized = &dev->swapchain.framebuffer_resized;
 	VkCommandBuffer **cmd_buffers = dev->cmd_submission.cmd_buffers;
@@ -145,16 +201,30 @@ draw_frame(struct vk_program *program, uint8_t current_frame, uint32_t imageInde
 
 	/* The swapchain that will be used in present_info */
 	VkSwapchainKHR swapchains[] = { dev->swapchain.handle };
-	/* All bellow used in submit_info to submit the graphics command buffer */
-	VkSemaphore waitSemaphores[] = { image_available_semaphore };
-	/* Specifies to which semaphore a signal will be emited to after the rendering*/
-	VkSemaphore signalSemaphores[] = { render_finished_semaphore };
+	/* All bellow used in submit_info to submit the graphics command buffer,
+	 * the uploads of the frame are waited too, if there are any */
+	VkSemaphore waitSemaphores[] = { image_available_semaphore, upload_engine->timeline };
+	uint64_t waitValues[] = { 0, upload_engine->wait_value };
+	/* Specifies to which semaphore a signal will be emited to after the
+	 * rendering, the frame timeline gets the number of the frame */
+	VkSemaphore signalSemaphores[] = { render_finished_semaphore, sync->frame_timeline };
+	uint64_t signalValues[] = { 0, get_recording_frame(sync) };
 	/* Which stages of the pipeline the submit will wait */
-	VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+	VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, UPLOAD_DST_STAGES };
+
+	/* The values of the binary semaphores are ignored */
+	VkTimelineSemaphoreSubmitInfo timelineInfo = {
+		.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+		.waitSemaphoreValueCount = upload_engine->wait_value ? 2 : 1,
+		.pWaitSemaphoreValues = waitValues,
+		.signalSemaphoreValueCount = array_size(signalValues),
+		.pSignalSemaphoreValues = signalValues
+	};
 
 	VkSubmitInfo submitInfo = {
 		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-		.waitSemaphoreCount = array_size(waitSemaphores),
+		.pNext = &timelineInfo,
+		.waitSemaphoreCount = upload_engine->wait_value ? 2 : 1,
 		.pWaitSemaphores = waitSemaphores,
 		.pWaitDstStageMask = waitStages,
 		.commandBufferCount = 1,
@@ -163,16 +233,22 @@ draw_frame(struct vk_program *program, uint8_t current_frame, uint32_t imageInde
 		.pSignalSemaphores = signalSemaphores
 	};
 
-	result = vkQueueSubmit(queues[graphics], 1, &submitInfo, in_flight_fences);
+	result = vkQueueSubmit(queues[graphics], 1, &submitInfo, VK_NULL_HANDLE);
 	if (result != VK_SUCCESS) {
 		print_error("Failed to submit draw command buffer!");
 		return -1;
 	}
 
+	sync->image_frames[imageIndex] = ++sync->frame_submitted;
+	upload_engine->wait_value = 0;
+
+	/* Only the presentation waits the binary semaphore */
+	VkSemaphore presentSemaphores[] = { render_finished_semaphore };
+
 	VkPresentInfoKHR presentInfo = {
 		.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
-		.waitSemaphoreCount = array_size(signalSemaphores),
-		.pWaitSemaphores = signalSemaphores,
+		.waitSemaphoreCount = array_size(presentSemaphores),
+		.pWaitSemaphores = presentSemaphores,
 		.swapchainCount = array_size(swapchains),
 		.pSwapchains = swapchains,
 		.pImageIndices = &imageIndex
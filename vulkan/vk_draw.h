@@ -5,14 +5,28 @@
 #include "vk_types.h"
 
 
+int
+create_timeline_semaphore(VkDevice logical_device, VkSemaphore *semaphore);
+
+/* Last value reached by the timeline, without waiting. `completed` caches
+ * it. */
+uint64_t
+get_timeline_value(VkDevice logical_device, VkSemaphore timeline, uint64_t *completed);
+
+/* Waits until the timeline reaches `value`, no call is made when the cached
+ * `completed` value is already there */
+int
+wait_timeline(VkDevice logical_device, VkSemaphore timeline, uint64_t *completed, uint64_t value);
+
 int
 create_sync_objects(VkDevice logical_device, struct vk_draw_sync *sync, uint32_t images_count);
 
 void
 sync_objects_cleanup(VkDevice logical_device, struct vk_draw_sync *sync);
 
-void
-update_view_projection(const VkDevice logical_device, struct view_projection *camera, uint32_t current_image);
+/* Written in the frame ring, before the draw commands are recorded */
+int
+update_view_projection(struct frame_ring *ring, struct view_projection *camera);
 
 int
 acquire_swapchain_image(struct vk_program *program, uint8_t current_frame, uint32_t *imageIndex);
@@ -0,0 +1,60 @@
+#include <string.h>
+
+#include "vk_frame_ring.h"
+#include "vk_constants.h"
+#include "vk_buffer.h"
+#include "utils.h"
+
+int
+frame_ring_init(struct vk_device *dev, struct frame_ring *ring, VkDeviceSize frame_size)
+{
+	const VkPhysicalDeviceLimits *limits = &dev->device_properties.device_properties.limits;
+	int ret;
+
+	memset(ring, 0, sizeof(struct frame_ring));
+
+	/* The limits are powers of two, and the matrices are written in place
+	 * by cglm, which wants them aligned to 16 bytes */
+	ring->alignment = max(limits->minUniformBufferOffsetAlignment, (VkDeviceSize) 16);
+	ring->frame_size = (frame_size + ring->alignment - 1) & ~(ring->alignment - 1);
+
+	/* The graphics queue reads the uniforms, and the upload engine copies
+	 * the staged meshes out of it */
+	ret = create_shared_buffer(dev, ring->frame_size * MAX_FRAMES_IN_FLIGHT,
+							   VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+							   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+							   &ring->buffer, &ring->memory);
+	if (ret) {
+		print_error("Failed to create the frame ring buffer!");
+		return -1;
+	}
+
+	return 0;
+}
+
+void
+frame_ring_destroy(struct vk_device *dev, struct frame_ring *ring)
+{
+	destroy_buffer(dev, ring->buffer, &ring->memory);
+}
+
+void
+frame_ring_begin_frame(struct frame_ring *ring, uint32_t frame)
+{
+	ring->frame_offset = ring->frame_size * frame;
+	ring->head = 0;
+}
+
+void *
+frame_ring_alloc(struct frame_ring *ring, VkDeviceSize size, VkDeviceSize *offset)
+{
+	VkDeviceSize start = ring->head;
+
+	if (size > ring->frame_size - start)
+		return NULL;
+
+	ring->head = min(start + ((size + ring->alignment - 1) & ~(ring->alignment - 1)), ring->frame_size);
+	*offset = ring->frame_offset + start;
+
+	return (char *) ring->memory.mapped + *offset;
+}
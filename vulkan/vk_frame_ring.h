@@ -0,0 +1,42 @@
+#ifndef VK_FRAME_RING_H
+#define VK_FRAME_RING_H
+
+#include <vulkan/vulkan.h>
+#include <stdint.h>
+
+#include "vk_memory.h"
+
+struct vk_device;
+
+/* A host visible buffer mapped for its whole life and split in one part per
+ * frame in flight. The data written by the CPU for a frame, like the camera
+ * matrix or the staging copy of the meshes, is bump allocated in the part of
+ * the frame, which is reused once the frame is done.
+ * */
+struct frame_ring {
+	VkBuffer buffer;
+	struct memory_allocation memory;
+	VkDeviceSize frame_size;
+	/* Every allocation is aligned to it, enough for uniform buffers */
+	VkDeviceSize alignment;
+	/* Part of the current frame, and its first free byte */
+	VkDeviceSize frame_offset;
+	VkDeviceSize head;
+};
+
+int
+frame_ring_init(struct vk_device *dev, struct frame_ring *ring, VkDeviceSize frame_size);
+
+void
+frame_ring_destroy(struct vk_device *dev, struct frame_ring *ring);
+
+/* The frame that used the part before must be done */
+void
+frame_ring_begin_frame(struct frame_ring *ring, uint32_t frame);
+
+/* Returns the mapped memory and its offset in the buffer, or NULL if the
+ * part of the frame is full */
+void *
+frame_ring_alloc(struct frame_ring *ring, VkDeviceSize size, VkDeviceSize *offset);
+
+#endif //VK_FRAME_RING_H
@@ -1,153 +1,265 @@
+#include <stdlib.h>
 #include <string.h>
 
 #include "vk_gpu_objects.h"
 #include "vk_constants.h"
 #include "vk_buffer.h"
-#include "terrain.h"
+#include "mesher.h"
 #include "utils.h"
 
-int
-create_vertex_buffer(struct vk_device *dev, struct vk_vertex_object *vertex_object)
+#define INITIAL_CHUNK_MESH_CAPACITY 256
+
+void
+destroy_chunk_meshes(struct vk_device *dev, struct vk_game_objects *game_objects)
 {
-	VkDeviceSize size = sizeof(struct vertex) * vertex_object->vertices_count;
+	/* The meshes go with their arenas, the retired ranges are freed by the
+	 * deletion queue before */
+	destroy_mesh_arenas(dev, &game_objects->arenas);
 
-	return create_gpu_buffer(dev, &vertex_object->vertex_buffer_memory, &vertex_object->vertex_buffer,
-							 vertex_object->vertices, size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+	upload_scheduler_destroy(&game_objects->uploads);
+
+	free(game_objects->chunk_meshes);
+	game_objects->chunk_meshes = NULL;
+	game_objects->chunk_mesh_count = game_objects->chunk_mesh_capacity = 0;
+	game_objects->mesh_move_count = 0;
 }
 
-int
-create_index_buffer(struct vk_device *dev, struct vk_vertex_object *vertex_object)
+static void
+write_chunk_mesh(char *dst, const struct chunk_mesh *cpu_mesh)
 {
-	VkDeviceSize size = sizeof(uint16_t) * vertex_object->indices_count;
+	size_t vertex_size = sizeof(struct vertex) * cpu_mesh->vertex_count;
 
-	return create_gpu_buffer(dev, &vertex_object->index_buffer_memory, &vertex_object->index_buffer,
-							 vertex_object->indices, size, VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+	memcpy(dst, cpu_mesh->vertices, vertex_size);
+	memcpy(dst + vertex_size, cpu_mesh->indices, sizeof(uint32_t) * cpu_mesh->index_count);
 }
 
-int
-create_cubes_position_buffers(struct vk_device *dev, struct vk_vertex_object *vertex_object, uint32_t swapchain_images_count)
+/* Written in place when the arena is mapped, no frame in flight uses the
+ * range. Otherwise the vertices and the indices are copied with a single
+ * transfer of the upload engine, staged in the frame ring. A mesh that does
+ * not fit in the ring anymore gets its own staging buffer. */
+static int
+create_chunk_mesh(struct vk_device *dev, struct chunk_mesh *cpu_mesh, struct vk_chunk_mesh *mesh)
 {
-	VkDeviceMemory *local_buffer_memory;
-	VkBuffer *local_buffer;
-	int i, ret;
-
-	local_buffer = malloc(sizeof(VkBuffer) * swapchain_images_count);
-	if (!local_buffer) {
-		print_error("Failed to allocate cubes position buffers vector");
-		goto return_error;
-	}
+	struct mesh_arenas *arenas = &dev->game_objs.arenas;
+	struct memory_allocation staging_buffer_memory = { 0 };
+	VkBuffer staging_buffer = VK_NULL_HANDLE;
+	VkDeviceSize size, offset;
+	struct mesh_arena *arena;
+	char *staging;
+	int ret;
 
-	local_buffer_memory = malloc(sizeof(VkDeviceMemory) * swapchain_images_count);
-	if (!local_buffer_memory) {
-		print_error("Failed to allocate cubes position buffers vector");
-		goto free_local_buffer;
+	size = get_chunk_mesh_size(cpu_mesh);
+
+	if (allocate_arena_range(dev, arenas, size, &mesh->range))
+		return -1;
+
+	arena = &arenas->arenas[mesh->range.arena];
+
+	if (arena->memory.mapped) {
+		write_chunk_mesh((char *) arena->memory.mapped + mesh->range.offset, cpu_mesh);
+		goto set_counts;
 	}
 
-	for (i = 0; i < swapchain_images_count; i++) {
-		ret = create_buffer(dev, CUBES_POSITION_BUFFER_SIZE,
-							VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-							VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &local_buffer[i], &local_buffer_memory[i]);
+	staging = frame_ring_alloc(&dev->frame_ring, size, &offset);
+	if (!staging) {
+		ret = create_buffer(dev, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+							VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+							&staging_buffer, &staging_buffer_memory);
 		if (ret)
-			break;
-	}
+			goto free_range;
+
+		/* The frame being recorded waits the copy, it is done after it */
+		defer_buffer_destruction(dev, staging_buffer, &staging_buffer_memory);
 
-	if (i != swapchain_images_count) {
-		print_error("Failed to create cube position gpu buffer!");
-		destroy_buffer_vector(dev, local_buffer, local_buffer_memory, i);
-		goto free_local_buffer_memory;
+		staging = staging_buffer_memory.mapped;
+		offset = 0;
 	}
 
-	vertex_object->position_buffer = local_buffer;
-	vertex_object->position_buffer_memory = local_buffer_memory;
-	vertex_object->position_buffer_count = swapchain_images_count;
+	write_chunk_mesh(staging, cpu_mesh);
+
+	ret = upload_engine_copy_buffer(&dev->upload_engine, staging_buffer ? staging_buffer : dev->frame_ring.buffer,
+									offset, arena->buffer, mesh->range.offset, size);
+	if (ret)
+		goto free_range;
+
+set_counts:
+	mesh->vertex_count = cpu_mesh->vertex_count;
+	mesh->index_count = cpu_mesh->index_count;
 
 	return 0;
 
-free_local_buffer_memory:
-	free(local_buffer_memory);
-free_local_buffer:
-	free(local_buffer);
-return_error:
+free_range:
+	free_arena_range(dev, arenas, &mesh->range);
 	return -1;
 }
 
-int
-generate_terrain_buffer(struct vk_device *dev, fnl_state *noise, struct vk_vertex_object *cube)
+static int
+find_chunk_mesh(const struct vk_game_objects *game_objects, int32_t x, int32_t z)
 {
-	VkDeviceSize position_size = 280 * 280 * sizeof(vec3);
-	VkResult result;
-	void *data;
+	uint32_t i;
 
-	result = vkMapMemory(dev->logical_device, cube->staging_position_buffer_memory, 0, position_size, 0, &data);
-	if (result != VK_SUCCESS) {
-		print_error("Failed to map the position staging buffer");
-		return -1;
-	}
+	for (i = 0; i < game_objects->chunk_mesh_count; i++)
+		if (game_objects->chunk_meshes[i].x == x && game_objects->chunk_meshes[i].z == z)
+			return i;
 
-	generate_terrain(data, noise, -140, -140, 140, 140);
+	return -1;
+}
 
-	vkUnmapMemory(dev->logical_device, cube->staging_position_buffer_memory);
+/* The mesh stops being drawn now, its range is freed once the frames in
+ * flight are done */
+static void
+retire_chunk_mesh(struct vk_device *dev, struct vk_game_objects *game_objects, uint32_t index)
+{
+	defer_arena_range_free(dev, &game_objects->chunk_meshes[index].range);
 
-	cube->position_count = 280 * 280;
+	game_objects->chunk_meshes[index] = game_objects->chunk_meshes[--game_objects->chunk_mesh_count];
+}
 
-	return 0;
+/* Its range is the destination of a move of this frame */
+static bool
+is_mesh_moved(const struct vk_game_objects *game_objects, const struct vk_chunk_mesh *mesh)
+{
+	uint32_t i;
+
+	for (i = 0; i < game_objects->mesh_move_count; i++)
+		if (game_objects->mesh_moves[i].dst.arena == mesh->range.arena &&
+			game_objects->mesh_moves[i].dst.offset == mesh->range.offset)
+			return true;
+
+	return false;
 }
 
-int
-create_vp_ubo_buffers(struct vk_device *dev, struct view_projection *vp)
+/* Moves the last meshes of the arenas to free ranges before them, so the
+ * free space gathers at the end and the last arena gets empty and released.
+ * The copies are recorded before the draws of the frame, see
+ * `record_draw_cmd()`. A mesh is moved once per frame at most, its new
+ * range is only written by the copy. */
+static void
+compact_chunk_meshes(struct vk_device *dev, struct vk_game_objects *game_objects)
 {
-	struct vk_swapchain *swapchain = &dev->swapchain;
-	VkDeviceSize buffer_size = sizeof(mat4);
-	VkDeviceMemory *local_buffer_memory;
-	VkBuffer *local_buffer;
-	size_t i, ret;
-
-	local_buffer = malloc(sizeof(VkBuffer) * swapchain->images_count);
-	if (!local_buffer) {
-		print_error("Failed to allocate view-projection uniform buffer");
-		return -1;
-	}
+	struct vk_chunk_mesh *mesh;
+	struct vk_mesh_move *move;
+	struct arena_range moved;
+	int32_t last;
+	uint32_t i;
 
-	local_buffer_memory = malloc(sizeof(VkDeviceMemory) * swapchain->images_count);
-	if (!local_buffer_memory) {
-		print_error("Failed to allocate view-projection uniform buffer memory");
-		free(vp->buffers);
-		return -1;
-	}
+	game_objects->mesh_move_count = 0;
 
-	/* We need create several(equal to the swap chains) because we have
-	 * Several swap chain buffer on the fly at same time and we need
-	 * a uniform buffer with View Projection to each frame.
-	 * */
-	for (i = 0; i < swapchain->images_count; i++) {
-		ret = create_buffer(dev, buffer_size, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-							VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-							&local_buffer[i], &local_buffer_memory[i]);
-		if (ret)
+	while (game_objects->mesh_move_count < MESH_MOVES_PER_FRAME) {
+		last = -1;
+		for (i = 0; i < game_objects->chunk_mesh_count; i++) {
+			if (is_mesh_moved(game_objects, &game_objects->chunk_meshes[i]))
+				continue;
+
+			if (last < 0 || is_arena_range_before(&game_objects->chunk_meshes[last].range,
+												  &game_objects->chunk_meshes[i].range))
+				last = i;
+		}
+
+		if (last < 0)
+			break;
+
+		mesh = &game_objects->chunk_meshes[last];
+		if (take_arena_range_before(&game_objects->arenas, &mesh->range, &moved))
 			break;
+
+		/* The draws still in flight read the old range */
+		defer_arena_range_free(dev, &mesh->range);
+
+		move = &game_objects->mesh_moves[game_objects->mesh_move_count++];
+		move->src = mesh->range;
+		move->dst = moved;
+		move->size = get_chunk_mesh_size(mesh);
+
+		mesh->range = moved;
 	}
+}
+
+static int
+add_chunk_mesh(struct vk_device *dev, struct vk_game_objects *game_objects, struct mesh_task *mesh_task)
+{
+	struct vk_chunk_mesh *meshes, *mesh;
+	uint32_t capacity;
+	int index;
+
+	index = find_chunk_mesh(game_objects, mesh_task->x, mesh_task->z);
+	if (index >= 0)
+		retire_chunk_mesh(dev, game_objects, index);
+
+	/* Nothing to draw, a chunk full of air or buried */
+	if (!mesh_task->mesh.index_count)
+		return 0;
+
+	if (game_objects->chunk_mesh_count == game_objects->chunk_mesh_capacity) {
+		capacity = game_objects->chunk_mesh_capacity ? game_objects->chunk_mesh_capacity * 2 : INITIAL_CHUNK_MESH_CAPACITY;
+		meshes = realloc(game_objects->chunk_meshes, sizeof(struct vk_chunk_mesh) * capacity);
+		if (!meshes) {
+			print_error("Failed to grow the chunk meshes vector!");
+			return -1;
+		}
+
+		game_objects->chunk_meshes = meshes;
+		game_objects->chunk_mesh_capacity = capacity;
+	}
+
+	mesh = &game_objects->chunk_meshes[game_objects->chunk_mesh_count];
+	mesh->x = mesh_task->x;
+	mesh->z = mesh_task->z;
 
-	if (i != swapchain->images_count) {
-		destroy_buffer_vector(dev, vp->buffers, vp->buffers_memory, i);
+	if (create_chunk_mesh(dev, &mesh_task->mesh, mesh)) {
+		pprint_error("Failed to create the mesh buffers of the chunk (%d, %d)", mesh->x, mesh->z);
 		return -1;
 	}
 
-	vp->buffers = local_buffer;
-	vp->buffers_memory = local_buffer_memory;
-	vp->buffer_count = swapchain->images_count;
+	game_objects->chunk_mesh_count++;
+
 	return 0;
 }
 
-void
-destroy_buffer_vector(struct vk_device *dev, VkBuffer *buffers, VkDeviceMemory *buffers_memory, uint32_t buffer_count)
+int
+stream_chunk_meshes(struct vk_device *dev, struct world_streamer *streamer, const vec3 position)
 {
-	int i;
+	struct vk_game_objects *game_objects = &dev->game_objs;
+	struct upload_scheduler *uploads = &game_objects->uploads;
+	struct view_projection *camera = &game_objects->camera;
+	struct unloaded_chunk unloaded;
+	struct mesh_task *mesh_task;
+	mat4 view_proj;
+	int index, ret;
+
+	if (upload_scheduler_collect(uploads, streamer))
+		return -1;
+
+	/* Before the uploads, a chunk can be unloaded and loaded again */
+	while (world_streamer_pop_unloaded(streamer, &unloaded)) {
+		upload_scheduler_drop(uploads, unloaded.x, unloaded.z);
+
+		index = find_chunk_mesh(game_objects, unloaded.x, unloaded.z);
+		if (index >= 0)
+			retire_chunk_mesh(dev, game_objects, index);
+	}
 
-	for (i = 0; i < buffer_count; i++) {
-		vkDestroyBuffer(dev->logical_device, buffers[i], NULL);
-		vkFreeMemory(dev->logical_device, buffers_memory[i], NULL);
+	glm_mat4_mul(camera->proj, camera->view, view_proj);
+	upload_scheduler_begin_frame(uploads, position, view_proj);
+
+	while ((mesh_task = upload_scheduler_next(uploads))) {
+		ret = add_chunk_mesh(dev, game_objects, mesh_task);
+		world_streamer_release_mesh(mesh_task);
+		if (ret)
+			return -1;
 	}
 
-	free(buffers);
-	free(buffers_memory);
+	upload_scheduler_end_frame(uploads);
+
+	/* The copies run while the previous frames are drawn */
+	if (upload_engine_submit(&dev->upload_engine))
+		return -1;
+
+	compact_chunk_meshes(dev, game_objects);
+
+	game_objects->center_x = streamer->center_x;
+	game_objects->center_z = streamer->center_z;
+	game_objects->draw_distance = streamer->view_distance + 2;
+
+	return 0;
 }
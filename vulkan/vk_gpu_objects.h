@@ -1,25 +1,17 @@
 #ifndef VK_GPU_OBJECTS_H
 #define VK_GPU_OBJECTS_H
 
+#include "world_streamer.h"
 #include "game_objects.h"
 #include "vk_types.h"
 
+/* Called once per frame, after the frame fence is waited. Uploads the
+ * meshes finished by the streamer within the frame budget, closest first,
+ * and drops the unloaded ones. */
 int
-create_vertex_buffer(struct vk_device *dev, struct vk_vertex_object *vertex_object);
-
-int
-create_index_buffer(struct vk_device *dev, struct vk_vertex_object *vertex_object);
-
-int
-create_vp_ubo_buffers(struct vk_device *dev, struct view_projection *vp);
-
-int
-create_cubes_position_buffers(struct vk_device *dev, struct vk_vertex_object *vertex_object, uint32_t swapchain_images_count);
-
-int
-generate_terrain_buffer(struct vk_device *dev, fnl_state *noise, struct vk_vertex_object *cube);
+stream_chunk_meshes(struct vk_device *dev, struct world_streamer *streamer, const vec3 position);
 
 void
-destroy_buffer_vector(struct vk_device *dev, VkBuffer *buffers, VkDeviceMemory *buffers_memory, uint32_t buffer_count);
+destroy_chunk_meshes(struct vk_device *dev, struct vk_game_objects *game_objects);
 
 #endif //VK_GPU_OBJECTS_H
@@ -4,7 +4,8 @@
 #include "utils.h"
 
 VkImageView
-create_image_view(VkDevice logical_device, VkImage image, VkFormat format, VkImageAspectFlags aspect_flags)
+create_image_view(VkDevice logical_device, VkImage image, VkFormat format,
+				  VkImageAspectFlags aspect_flags, VkImageViewType view_type)
 {
 	VkImageView image_view;
 	VkResult result;
@@ -12,7 +13,7 @@ create_image_view(VkDevice logical_device, VkImage image, VkFormat format, VkIma
 	VkImageViewCreateInfo view_info = {
 		.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
 		.image = image,
-		.viewType = VK_IMAGE_VIEW_TYPE_2D,
+		.viewType = view_type,
 		.format = format,
 		.components.r = VK_COMPONENT_SWIZZLE_IDENTITY,
 		.components.g = VK_COMPONENT_SWIZZLE_IDENTITY,
@@ -22,7 +23,7 @@ create_image_view(VkDevice logical_device, VkImage image, VkFormat format, VkIma
 		.subresourceRange.baseMipLevel = 0,
 		.subresourceRange.levelCount = 1,
 		.subresourceRange.baseArrayLayer = 0,
-		.subresourceRange.layerCount = 1
+		.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS
 	};
 
 	result = vkCreateImageView(logical_device, &view_info, NULL, &image_view);
@@ -46,11 +47,11 @@ image_views_cleanup(VkDevice logical_device, VkImageView *image_views, uint32_t
 }
 
 int
-create_image(struct vk_device *dev, uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling,
-			VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage* image, VkDeviceMemory* image_memory)
+create_image(struct vk_device *dev, uint32_t width, uint32_t height, uint32_t layers, VkFormat format, VkImageTiling tiling,
+			VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage* image, struct memory_allocation *image_memory)
 {
 	VkMemoryRequirements mem_requirements;
-	int64_t mem_type;
+	enum memory_kind kind;
 	VkResult result;
 
 	VkImageCreateInfo image_info = {
@@ -60,18 +61,27 @@ create_image(struct vk_device *dev, uint32_t width, uint32_t height, VkFormat fo
 		.extent.height = height,
 		.extent.depth = 1,
 		.mipLevels = 1,
-		.arrayLayers = 1,
+		.arrayLayers = layers,
 		.format = format,
 		.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
 		.usage = usage,
 		.samples = VK_SAMPLE_COUNT_1_BIT,
 	};
 
-	if (dev->cmd_submission.cmd_buffers_count[transfer] > 0)
-		/* It will be used by graphics and transfer command buffers */
+	uint32_t families[] = {
+		dev->cmd_submission.family_indices[graphics],
+		dev->cmd_submission.family_indices[transfer]
+	};
+
+	if (dev->cmd_submission.cmd_buffers_count[transfer] > 0) {
+		/* It will be used by graphics and transfer command buffers, the
+		 * families must be given with the concurrent sharing mode */
 		image_info.sharingMode = VK_SHARING_MODE_CONCURRENT;
-	else
+		image_info.queueFamilyIndexCount = array_size(families);
+		image_info.pQueueFamilyIndices = families;
+	} else {
 		image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	}
 
 	result = vkCreateImage(dev->logical_device, &image_info, NULL, image);
 	if (result != VK_SUCCESS) {
@@ -81,25 +91,13 @@ create_image(struct vk_device *dev, uint32_t width, uint32_t height, VkFormat fo
 
 	vkGetImageMemoryRequirements(dev->logical_device, *image, &mem_requirements);
 
-	mem_type = find_memory_type(dev->physical_device, mem_requirements.memoryTypeBits, properties);
-	if (mem_type == -1) {
-		print_error("Failed to find suitable memory type!");
-		goto destroy_image;
-	}
-
-	VkMemoryAllocateInfo alloc_info = {
-		.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-		.allocationSize = mem_requirements.size,
-		.memoryTypeIndex = (uint32_t) mem_type
-	};
-
-	result = vkAllocateMemory(dev->logical_device, &alloc_info, NULL, image_memory);
-	if (result != VK_SUCCESS) {
+	kind = tiling == VK_IMAGE_TILING_LINEAR ? MEMORY_LINEAR : MEMORY_OPTIMAL;
+	if (allocate_device_memory(&dev->allocator, &mem_requirements, properties, kind, image_memory)) {
 		print_error("failed to allocate image memory!");
 		goto destroy_image;
 	}
 
-	result = vkBindImageMemory(dev->logical_device, *image, *image_memory, 0);
+	result = vkBindImageMemory(dev->logical_device, *image, image_memory->memory, image_memory->offset);
 	if (result != VK_SUCCESS) {
 		print_error("failed to allocate image memory!");
 		goto destroy_image_memory;
@@ -108,15 +106,22 @@ create_image(struct vk_device *dev, uint32_t width, uint32_t height, VkFormat fo
 	return 0;
 
 destroy_image_memory:
-	vkFreeMemory(dev->logical_device, *image_memory, NULL);
+	free_device_memory(&dev->allocator, image_memory);
 destroy_image:
 	vkDestroyImage(dev->logical_device, *image, NULL);
 return_error:
 	return -1;
 }
 
+void
+destroy_image(struct vk_device *dev, VkImage image, struct memory_allocation *image_memory)
+{
+	vkDestroyImage(dev->logical_device, image, NULL);
+	free_device_memory(&dev->allocator, image_memory);
+}
+
 int
-transition_image_layout(struct vk_cmd_submission *cmd_sub, VkImage image, VkFormat format,
+transition_image_layout(struct vk_cmd_submission *cmd_sub, VkImage image, VkFormat format, uint32_t layers,
 						VkImageLayout old_layout, VkImageLayout new_layout)
 {
 	VkPipelineStageFlags src_stage;
@@ -136,7 +141,7 @@ transition_image_layout(struct vk_cmd_submission *cmd_sub, VkImage image, VkForm
 		.subresourceRange.baseMipLevel = 0,
 		.subresourceRange.levelCount = 1,
 		.subresourceRange.baseArrayLayer = 0,
-		.subresourceRange.layerCount = 1,
+		.subresourceRange.layerCount = layers,
 		.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT
 	};
 
@@ -180,12 +185,14 @@ transition_image_layout(struct vk_cmd_submission *cmd_sub, VkImage image, VkForm
 }
 
 int
-copy_buffer_to_image(struct vk_cmd_submission *cmd_sub, VkBuffer buffer, VkImage image, uint32_t width, uint32_t height)
+copy_buffer_to_image(struct vk_cmd_submission *cmd_sub, VkBuffer buffer, VkImage image,
+					 uint32_t width, uint32_t height, uint32_t layers)
 {
 	VkCommandBuffer cmd_buffer;
 	VkResult result;
 	VkQueue queue;
 
+	/* The layers are tightly packed one after the other in the buffer */
 	VkBufferImageCopy region = {
 		.bufferOffset = 0,
 		.bufferRowLength = 0,
@@ -193,7 +200,7 @@ copy_buffer_to_image(struct vk_cmd_submission *cmd_sub, VkBuffer buffer, VkImage
 		.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
 		.imageSubresource.mipLevel = 0,
 		.imageSubresource.baseArrayLayer = 0,
-		.imageSubresource.layerCount = 1,
+		.imageSubresource.layerCount = layers,
 		.imageOffset = { 0, 0, 0 },
 		.imageExtent = { width, height, 1 }
 	};
@@ -220,15 +227,14 @@ copy_buffer_to_image(struct vk_cmd_submission *cmd_sub, VkBuffer buffer, VkImage
 }
 
 int
-create_gpu_image(struct vk_device *dev, VkDeviceMemory staging_buffer_memory, VkBuffer staging_buffer,
-				 void *staging_buffer_data, int tex_width, int tex_height,
-				 VkDeviceMemory *texture_image_memory, VkImage *texture_image)
+create_gpu_image(struct vk_device *dev, VkBuffer staging_buffer, int tex_width, int tex_height, uint32_t layers,
+				 struct memory_allocation *texture_image_memory, VkImage *texture_image)
 {
-	VkDeviceMemory local_texture_image_memory;
+	struct memory_allocation local_texture_image_memory;
 	VkImage local_texture_image;
 	int ret;
 
-	ret = create_image(dev, tex_width, tex_height, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL,
+	ret = create_image(dev, tex_width, tex_height, layers, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL,
 					   VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
 					   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &local_texture_image, &local_texture_image_memory);
 	if (ret)
@@ -243,16 +249,16 @@ create_gpu_image(struct vk_device *dev, VkDeviceMemory staging_buffer_memory, Vk
 	 * vkCmdCopyBufferToImage function. And the step (3) is necessary
 	 * to shader access the texture.
 	 * */
-	ret = transition_image_layout(&dev->cmd_submission, local_texture_image, VK_FORMAT_R8G8B8A8_SRGB,
+	ret = transition_image_layout(&dev->cmd_submission, local_texture_image, VK_FORMAT_R8G8B8A8_SRGB, layers,
 								  VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
 	if (ret)
 		goto destroy_image;
 
-	ret = copy_buffer_to_image(&dev->cmd_submission, staging_buffer, local_texture_image, tex_width, tex_height);
+	ret = copy_buffer_to_image(&dev->cmd_submission, staging_buffer, local_texture_image, tex_width, tex_height, layers);
 	if (ret)
 		goto destroy_image;
 
-	ret = transition_image_layout(&dev->cmd_submission, local_texture_image, VK_FORMAT_R8G8B8A8_SRGB,
+	ret = transition_image_layout(&dev->cmd_submission, local_texture_image, VK_FORMAT_R8G8B8A8_SRGB, layers,
 								  VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 	if (ret)
 		goto destroy_image;
@@ -263,8 +269,7 @@ create_gpu_image(struct vk_device *dev, VkDeviceMemory staging_buffer_memory, Vk
 	return 0;
 
 destroy_image:
-	vkDestroyImage(dev->logical_device, local_texture_image, NULL);
-	vkFreeMemory(dev->logical_device, local_texture_image_memory, NULL);
+	destroy_image(dev, local_texture_image, &local_texture_image_memory);
 return_error:
 	return ret;
 }
@@ -4,25 +4,29 @@
 #include "vk_types.h"
 
 VkImageView
-create_image_view(VkDevice logical_device, VkImage image, VkFormat format, VkImageAspectFlags aspect_flags);
+create_image_view(VkDevice logical_device, VkImage image, VkFormat format,
+				  VkImageAspectFlags aspect_flags, VkImageViewType view_type);
 
 void
 image_views_cleanup(VkDevice logical_device, VkImageView *image_views, uint32_t images_count);
 
 int
-create_image(struct vk_device *dev, uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling,
-			VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage* image, VkDeviceMemory* image_memory);
+create_image(struct vk_device *dev, uint32_t width, uint32_t height, uint32_t layers, VkFormat format, VkImageTiling tiling,
+			VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage* image, struct memory_allocation *image_memory);
+
+void
+destroy_image(struct vk_device *dev, VkImage image, struct memory_allocation *image_memory);
 
 int
-transition_image_layout(struct vk_cmd_submission *cmd_sub, VkImage image, VkFormat format,
+transition_image_layout(struct vk_cmd_submission *cmd_sub, VkImage image, VkFormat format, uint32_t layers,
 						VkImageLayout old_layout, VkImageLayout new_layout);
 
 int
-copy_buffer_to_image(struct vk_cmd_submission *cmd_sub, VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
+copy_buffer_to_image(struct vk_cmd_submission *cmd_sub, VkBuffer buffer, VkImage image,
+					 uint32_t width, uint32_t height, uint32_t layers);
 
 int
-create_gpu_image(struct vk_device *dev, VkDeviceMemory staging_buffer_memory, VkBuffer staging_buffer,
-				 void *staging_buffer_data, int tex_width, int tex_height,
-				 VkDeviceMemory *texture_image_memory, VkImage *texture_image);
+create_gpu_image(struct vk_device *dev, VkBuffer staging_buffer, int tex_width, int tex_height, uint32_t layers,
+				 struct memory_allocation *texture_image_memory, VkImage *texture_image);
 
 #endif //VK_IMAGE_VIEW_H
@@ -106,7 +106,8 @@ create_app_info()
 		.applicationVersion = VK_MAKE_VERSION(1, 0, 0),
 		.pEngineName = "N/A",
 		.engineVersion = VK_MAKE_VERSION(1, 0, 0),
-		.apiVersion = VK_API_VERSION_1_0,
+		/* For the timeline semaphores */
+		.apiVersion = VK_API_VERSION_1_2,
 	};
 
 	return app_info;
@@ -212,6 +212,7 @@ is_device_suitable(VkPhysicalDevice physical_device, struct vk_device *picked_de
 {
 	VkPhysicalDeviceProperties *device_properties = &picked_device->device_properties.device_properties;
 	VkPhysicalDeviceFeatures supported_features;
+	VkPhysicalDeviceProperties properties;
 	struct vk_cmd_submission cmd_sub = { };
 	struct surface_support surface_support = { };
 	bool extensions_supported;
@@ -241,6 +242,24 @@ is_device_suitable(VkPhysicalDevice physical_device, struct vk_device *picked_de
 	if(!supported_features.samplerAnisotropy)
 		goto surface_support_cleanup;
 
+	/* The frames and the uploads are synchronized with timeline semaphores */
+	vkGetPhysicalDeviceProperties(physical_device, &properties);
+	if (properties.apiVersion < VK_API_VERSION_1_2)
+		goto surface_support_cleanup;
+
+	VkPhysicalDeviceVulkan12Features vulkan12_features = {
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES
+	};
+
+	VkPhysicalDeviceFeatures2 features2 = {
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+		.pNext = &vulkan12_features
+	};
+
+	vkGetPhysicalDeviceFeatures2(physical_device, &features2);
+	if (!vulkan12_features.timelineSemaphore)
+		goto surface_support_cleanup;
+
 	vkGetPhysicalDeviceProperties(physical_device, device_properties);
 	picked_device->physical_device = physical_device;
 	picked_device->cmd_submission = cmd_sub;
@@ -332,8 +351,14 @@ create_logical_device(struct vk_device *device)
 		.samplerAnisotropy = VK_TRUE
 	};
 
+	VkPhysicalDeviceVulkan12Features vulkan12_features = {
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+		.timelineSemaphore = VK_TRUE
+	};
+
 	VkDeviceCreateInfo create_info = {
 		.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+		.pNext = &vulkan12_features,
 		.pQueueCreateInfos = queue_create_infos,
 		.queueCreateInfoCount = unique_family_count,
 		.enabledExtensionCount = array_size(device_extensions),
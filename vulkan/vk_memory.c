@@ -0,0 +1,325 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "vk_constants.h"
+#include "vk_memory.h"
+#include "utils.h"
+
+/* Results of `take_range()` */
+#define RANGE_NOT_FOUND 1
+
+/* Several types can match, like the system memory and the host visible
+ * window of the VRAM. The one on the biggest heap goes first, then the
+ * order of the device. */
+static int64_t
+find_memory_type(const struct memory_allocator *allocator, uint32_t type_filter, VkMemoryPropertyFlags properties)
+{
+	const VkPhysicalDeviceMemoryProperties *props = &allocator->properties;
+	int64_t found = -1;
+	uint32_t i;
+
+	for (i = 0; i < props->memoryTypeCount; i++) {
+		if (!(type_filter & (1 << i)) || (props->memoryTypes[i].propertyFlags & properties) != properties)
+			continue;
+
+		if (found == -1 || props->memoryHeaps[props->memoryTypes[i].heapIndex].size >
+						   props->memoryHeaps[props->memoryTypes[found].heapIndex].size)
+			found = i;
+	}
+
+	return found;
+}
+
+/* The 256 MiB window of the VRAM that discrete devices map without
+ * resizable BAR is too small to hold the meshes, it is not used */
+static bool
+has_direct_upload(const struct memory_allocator *allocator)
+{
+	const VkPhysicalDeviceMemoryProperties *props = &allocator->properties;
+	VkDeviceSize vram = 0;
+	int64_t memory_type;
+	uint32_t i;
+
+	for (i = 0; i < props->memoryHeapCount; i++)
+		if (props->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+			vram = max(vram, props->memoryHeaps[i].size);
+
+	memory_type = find_memory_type(allocator, UINT32_MAX, DIRECT_UPLOAD_MEMORY);
+
+	return memory_type != -1 && props->memoryHeaps[props->memoryTypes[memory_type].heapIndex].size == vram;
+}
+
+void
+memory_allocator_init(struct memory_allocator *allocator, VkPhysicalDevice physical_device, VkDevice logical_device)
+{
+	memset(allocator, 0, sizeof(struct memory_allocator));
+
+	allocator->logical_device = logical_device;
+	vkGetPhysicalDeviceMemoryProperties(physical_device, &allocator->properties);
+	allocator->direct_upload = has_direct_upload(allocator);
+}
+
+/* Small heaps, like the host visible window of the VRAM, are not taken by
+ * a few blocks. A resource bigger than a block gets a block of its own. */
+static VkDeviceSize
+get_block_size(const struct memory_allocator *allocator, uint32_t memory_type, VkDeviceSize size)
+{
+	uint32_t heap = allocator->properties.memoryTypes[memory_type].heapIndex;
+	VkDeviceSize block_size = min((VkDeviceSize) MEMORY_BLOCK_SIZE, allocator->properties.memoryHeaps[heap].size / 8);
+
+	return max(block_size, size);
+}
+
+static struct memory_block *
+create_memory_block(struct memory_allocator *allocator, uint32_t memory_type, VkDeviceSize size)
+{
+	struct memory_block *block;
+	VkResult result;
+
+	block = calloc(1, sizeof(struct memory_block));
+	if (!block) {
+		print_error("Failed to allocate memory block!");
+		goto return_error;
+	}
+
+	block->free_ranges = malloc(sizeof(struct memory_range));
+	if (!block->free_ranges) {
+		print_error("Failed to allocate memory block free range!");
+		goto free_block;
+	}
+
+	VkMemoryAllocateInfo alloc_info = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+		.allocationSize = size,
+		.memoryTypeIndex = memory_type
+	};
+
+	result = vkAllocateMemory(allocator->logical_device, &alloc_info, NULL, &block->memory);
+	if (result != VK_SUCCESS) {
+		print_error("Failed to allocate device memory block!");
+		goto free_range;
+	}
+
+	/* Mapping the same memory twice is not allowed, so the resources get
+	 * a pointer to the block mapping instead */
+	if (allocator->properties.memoryTypes[memory_type].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+		result = vkMapMemory(allocator->logical_device, block->memory, 0, VK_WHOLE_SIZE, 0, &block->mapped);
+		if (result != VK_SUCCESS) {
+			print_error("Failed to map device memory block!");
+			goto free_memory;
+		}
+	}
+
+	*block->free_ranges = (struct memory_range) { .offset = 0, .size = size, .next = NULL };
+	block->size = size;
+
+	allocator->block_count++;
+	allocator->block_bytes += size;
+
+	return block;
+
+free_memory:
+	vkFreeMemory(allocator->logical_device, block->memory, NULL);
+free_range:
+	free(block->free_ranges);
+free_block:
+	free(block);
+return_error:
+	return NULL;
+}
+
+static void
+destroy_memory_block(struct memory_allocator *allocator, struct memory_block *block)
+{
+	struct memory_range *range;
+
+	while ((range = block->free_ranges)) {
+		block->free_ranges = range->next;
+		free(range);
+	}
+
+	if (block->mapped)
+		vkUnmapMemory(allocator->logical_device, block->memory);
+	vkFreeMemory(allocator->logical_device, block->memory, NULL);
+
+	allocator->block_count--;
+	allocator->block_bytes -= block->size;
+
+	free(block);
+}
+
+void
+memory_allocator_destroy(struct memory_allocator *allocator)
+{
+	struct memory_block *block;
+	uint32_t type, kind;
+
+	for (type = 0; type < VK_MAX_MEMORY_TYPES; type++) {
+		for (kind = 0; kind < memory_kind_count; kind++) {
+			while ((block = allocator->blocks[type][kind])) {
+				allocator->blocks[type][kind] = block->next;
+				destroy_memory_block(allocator, block);
+			}
+		}
+	}
+}
+
+/* First fit. The alignment padding before the resource stays free, it is
+ * merged back with the range before when possible. */
+static int
+take_range(struct memory_block *block, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize *offset)
+{
+	struct memory_range **link, *range, *after;
+	VkDeviceSize start, end, range_end;
+
+	for (link = &block->free_ranges; (range = *link); link = &range->next) {
+		/* The alignments are powers of two */
+		start = (range->offset + alignment - 1) & ~(alignment - 1);
+		end = start + size;
+		range_end = range->offset + range->size;
+		if (end > range_end)
+			continue;
+
+		if (start > range->offset && end < range_end) {
+			after = malloc(sizeof(struct memory_range));
+			if (!after) {
+				print_error("Failed to allocate memory block free range!");
+				return -1;
+			}
+
+			*after = (struct memory_range) { .offset = end, .size = range_end - end, .next = range->next };
+			range->size = start - range->offset;
+			range->next = after;
+		} else if (start > range->offset) {
+			range->size = start - range->offset;
+		} else if (end < range_end) {
+			range->offset = end;
+			range->size = range_end - end;
+		} else {
+			*link = range->next;
+			free(range);
+		}
+
+		block->used += size;
+		*offset = start;
+
+		return 0;
+	}
+
+	return RANGE_NOT_FOUND;
+}
+
+/* Coalesced with the free ranges around it. If the range can't be
+ * allocated it is lost until the block is destroyed. */
+static void
+give_range(struct memory_block *block, VkDeviceSize offset, VkDeviceSize size)
+{
+	struct memory_range **link = &block->free_ranges, *before = NULL, *after, *range;
+
+	while ((after = *link) && after->offset < offset) {
+		before = after;
+		link = &after->next;
+	}
+
+	block->used -= size;
+
+	if (before && before->offset + before->size == offset) {
+		before->size += size;
+		if (after && offset + size == after->offset) {
+			before->size += after->size;
+			before->next = after->next;
+			free(after);
+		}
+		return;
+	}
+
+	if (after && offset + size == after->offset) {
+		after->offset = offset;
+		after->size += size;
+		return;
+	}
+
+	range = malloc(sizeof(struct memory_range));
+	if (!range) {
+		print_error("Failed to allocate memory block free range!");
+		return;
+	}
+
+	*range = (struct memory_range) { .offset = offset, .size = size, .next = after };
+	*link = range;
+}
+
+int
+allocate_device_memory(struct memory_allocator *allocator, const VkMemoryRequirements *requirements,
+					   VkMemoryPropertyFlags properties, enum memory_kind kind, struct memory_allocation *allocation)
+{
+	struct memory_block **link, *block;
+	VkDeviceSize offset;
+	int64_t memory_type;
+	int ret = RANGE_NOT_FOUND;
+
+	memory_type = find_memory_type(allocator, requirements->memoryTypeBits, properties);
+	if (memory_type == -1) {
+		print_error("Failed to find suitable memory type!");
+		return -1;
+	}
+
+	/* The oldest blocks are filled first, so the newest ones get empty and
+	 * released when the resources are freed */
+	for (link = &allocator->blocks[memory_type][kind]; (block = *link); link = &block->next) {
+		ret = take_range(block, requirements->size, requirements->alignment, &offset);
+		if (ret != RANGE_NOT_FOUND)
+			break;
+	}
+
+	if (ret == RANGE_NOT_FOUND) {
+		block = create_memory_block(allocator, memory_type, get_block_size(allocator, memory_type, requirements->size));
+		if (!block)
+			return -1;
+
+		*link = block;
+		ret = take_range(block, requirements->size, requirements->alignment, &offset);
+	}
+
+	if (ret)
+		return -1;
+
+	*allocation = (struct memory_allocation) {
+		.memory = block->memory,
+		.offset = offset,
+		.size = requirements->size,
+		.mapped = block->mapped ? (char *) block->mapped + offset : NULL,
+		.block = block,
+		.memory_type = memory_type,
+		.kind = kind
+	};
+
+	allocator->allocated_bytes += requirements->size;
+
+	return 0;
+}
+
+void
+free_device_memory(struct memory_allocator *allocator, struct memory_allocation *allocation)
+{
+	struct memory_block **link = &allocator->blocks[allocation->memory_type][allocation->kind];
+	struct memory_block *block = allocation->block;
+
+	if (!block)
+		return;
+
+	give_range(block, allocation->offset, allocation->size);
+	allocator->allocated_bytes -= allocation->size;
+	allocation->block = NULL;
+
+	/* The first block of each type is kept, so streaming a few resources
+	 * in and out never allocates, unless it was made for a big resource */
+	if (block->used || (*link == block && block->size == get_block_size(allocator, allocation->memory_type, 0)))
+		return;
+
+	while (*link != block)
+		link = &(*link)->next;
+	*link = block->next;
+
+	destroy_memory_block(allocator, block);
+}
@@ -0,0 +1,79 @@
+#ifndef VK_MEMORY_H
+#define VK_MEMORY_H
+
+#include <vulkan/vulkan.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Linear resources (buffers) and optimal images never share a block, so
+ * the `bufferImageGranularity` never has to be respected between them */
+enum memory_kind { MEMORY_LINEAR = 0, MEMORY_OPTIMAL, memory_kind_count };
+
+/* Memory the CPU writes in place and the GPU reads at full speed */
+#define DIRECT_UPLOAD_MEMORY \
+	(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+
+/* Free range of a block, the ranges are sorted by offset and never touch */
+struct memory_range {
+	VkDeviceSize offset;
+	VkDeviceSize size;
+	struct memory_range *next;
+};
+
+/* A single `vkAllocateMemory()` shared by many resources */
+struct memory_block {
+	VkDeviceMemory memory;
+	VkDeviceSize size;
+	VkDeviceSize used;
+	/* Mapped once for its whole life, NULL if not host visible */
+	void *mapped;
+	struct memory_range *free_ranges;
+	struct memory_block *next;
+};
+
+/* Part of a block owned by one resource */
+struct memory_allocation {
+	VkDeviceMemory memory;
+	VkDeviceSize offset;
+	VkDeviceSize size;
+	/* Already offset, NULL if not host visible */
+	void *mapped;
+	struct memory_block *block;
+	uint32_t memory_type;
+	uint8_t kind;
+};
+
+/* Grabs large blocks of device memory per memory type and splits them
+ * between the resources with first fit free lists. Only used by the
+ * thread that owns the device.
+ * */
+struct memory_allocator {
+	VkDevice logical_device;
+	VkPhysicalDeviceMemoryProperties properties;
+	/* A DIRECT_UPLOAD_MEMORY type is on the biggest device local heap, with
+	 * resizable BAR or on integrated and software devices. The resources
+	 * written by the CPU can skip the staging copy. */
+	bool direct_upload;
+	struct memory_block *blocks[VK_MAX_MEMORY_TYPES][memory_kind_count];
+	/* `vkAllocateMemory()` calls alive, and the bytes they hold */
+	uint32_t block_count;
+	VkDeviceSize block_bytes;
+	/* Bytes given to the resources */
+	VkDeviceSize allocated_bytes;
+};
+
+void
+memory_allocator_init(struct memory_allocator *allocator, VkPhysicalDevice physical_device, VkDevice logical_device);
+
+/* Every allocation must be freed before */
+void
+memory_allocator_destroy(struct memory_allocator *allocator);
+
+int
+allocate_device_memory(struct memory_allocator *allocator, const VkMemoryRequirements *requirements,
+					   VkMemoryPropertyFlags properties, enum memory_kind kind, struct memory_allocation *allocation);
+
+void
+free_device_memory(struct memory_allocator *allocator, struct memory_allocation *allocation);
+
+#endif //VK_MEMORY_H
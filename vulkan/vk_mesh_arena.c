@@ -0,0 +1,225 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "vk_deletion_queue.h"
+#include "vk_mesh_arena.h"
+#include "vk_buffer.h"
+#include "utils.h"
+
+#define get_level(order) ((order) - MESH_ARENA_MIN_ORDER)
+/* Blocks of an order in an arena */
+#define get_block_count(order) (MESH_ARENA_SIZE >> (order))
+#define get_word_count(order) ((get_block_count(order) + 63) / 64)
+
+#define is_block_free(arena, order, block) \
+	(((arena)->free_blocks[get_level(order)][(block) / 64] >> ((block) % 64)) & 1)
+
+static void
+set_block_free(struct mesh_arena *arena, uint32_t order, VkDeviceSize block)
+{
+	arena->free_blocks[get_level(order)][block / 64] |= 1ULL << (block % 64);
+	arena->free_count[get_level(order)]++;
+}
+
+static void
+set_block_used(struct mesh_arena *arena, uint32_t order, VkDeviceSize block)
+{
+	arena->free_blocks[get_level(order)][block / 64] &= ~(1ULL << (block % 64));
+	arena->free_count[get_level(order)]--;
+}
+
+static int
+create_mesh_arena(struct vk_device *dev, struct mesh_arena *arena)
+{
+	VkMemoryPropertyFlags properties;
+	uint64_t *words;
+	size_t word_count = 0;
+	uint32_t order;
+	int ret;
+
+	memset(arena, 0, sizeof(struct mesh_arena));
+
+	for (order = MESH_ARENA_MIN_ORDER; order <= MESH_ARENA_MAX_ORDER; order++)
+		word_count += get_word_count(order);
+
+	/* Every bitmap in the same allocation */
+	words = calloc(word_count, sizeof(uint64_t));
+	if (!words) {
+		print_error("Failed to allocate the mesh arena bitmaps!");
+		return -1;
+	}
+
+	for (order = MESH_ARENA_MIN_ORDER; order <= MESH_ARENA_MAX_ORDER; order++) {
+		arena->free_blocks[get_level(order)] = words;
+		words += get_word_count(order);
+	}
+
+	/* Mapped when possible, then the meshes are written in place */
+	properties = dev->allocator.direct_upload ? DIRECT_UPLOAD_MEMORY : VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+	ret = create_buffer(dev, MESH_ARENA_SIZE, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+						VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+						properties, &arena->buffer, &arena->memory);
+	if (ret) {
+		print_error("Failed to create a mesh arena!");
+		free(arena->free_blocks[0]);
+		return -1;
+	}
+
+	set_block_free(arena, MESH_ARENA_MAX_ORDER, 0);
+
+	return 0;
+}
+
+static void
+destroy_mesh_arena(struct vk_device *dev, struct mesh_arena *arena)
+{
+	destroy_buffer(dev, arena->buffer, &arena->memory);
+	free(arena->free_blocks[0]);
+}
+
+void
+destroy_mesh_arenas(struct vk_device *dev, struct mesh_arenas *arenas)
+{
+	uint32_t i;
+
+	for (i = 0; i < arenas->arena_count; i++)
+		destroy_mesh_arena(dev, &arenas->arenas[i]);
+
+	arenas->arena_count = 0;
+}
+
+static VkDeviceSize
+find_first_free_block(const struct mesh_arena *arena, uint32_t order)
+{
+	const uint64_t *words = arena->free_blocks[get_level(order)];
+	VkDeviceSize i;
+
+	for (i = 0; !words[i]; i++)
+		;
+
+	return i * 64 + __builtin_ctzll(words[i]);
+}
+
+/* Split the first free block of the smallest order that is big enough */
+static int
+take_block(struct mesh_arena *arena, uint32_t order, VkDeviceSize *offset)
+{
+	uint32_t split_order = order;
+	VkDeviceSize block;
+
+	while (split_order <= MESH_ARENA_MAX_ORDER && !arena->free_count[get_level(split_order)])
+		split_order++;
+
+	if (split_order > MESH_ARENA_MAX_ORDER)
+		return -1;
+
+	block = find_first_free_block(arena, split_order);
+	set_block_used(arena, split_order, block);
+
+	/* The lower half is split again, the upper half becomes free */
+	while (split_order > order) {
+		split_order--;
+		block *= 2;
+		set_block_free(arena, split_order, block + 1);
+	}
+
+	*offset = block << order;
+	arena->used += (VkDeviceSize) 1 << order;
+
+	return 0;
+}
+
+/* Merged with its buddy as long as the buddy is free too */
+static void
+give_block(struct mesh_arena *arena, uint32_t order, VkDeviceSize offset)
+{
+	VkDeviceSize block = offset >> order;
+
+	arena->used -= (VkDeviceSize) 1 << order;
+
+	while (order < MESH_ARENA_MAX_ORDER && is_block_free(arena, order, block ^ 1)) {
+		set_block_used(arena, order, block ^ 1);
+		block /= 2;
+		order++;
+	}
+
+	set_block_free(arena, order, block);
+}
+
+int
+allocate_arena_range(struct vk_device *dev, struct mesh_arenas *arenas, VkDeviceSize size, struct arena_range *range)
+{
+	uint32_t order = MESH_ARENA_MIN_ORDER;
+	uint32_t i;
+
+	while (order <= MESH_ARENA_MAX_ORDER && ((VkDeviceSize) 1 << order) < size)
+		order++;
+
+	if (order > MESH_ARENA_MAX_ORDER) {
+		print_error("The chunk mesh is bigger than a mesh arena!");
+		return -1;
+	}
+
+	range->order = order;
+
+	for (i = 0; i < arenas->arena_count; i++) {
+		if (!take_block(&arenas->arenas[i], order, &range->offset)) {
+			range->arena = i;
+			return 0;
+		}
+	}
+
+	if (arenas->arena_count == MAX_MESH_ARENAS) {
+		print_error("Every mesh arena is full!");
+		return -1;
+	}
+
+	if (create_mesh_arena(dev, &arenas->arenas[arenas->arena_count]))
+		return -1;
+
+	range->arena = arenas->arena_count++;
+
+	return take_block(&arenas->arenas[range->arena], order, &range->offset);
+}
+
+int
+take_arena_range_before(struct mesh_arenas *arenas, const struct arena_range *range, struct arena_range *moved)
+{
+	struct mesh_arena *arena;
+	uint32_t i;
+
+	moved->order = range->order;
+
+	for (i = 0; i <= range->arena; i++) {
+		arena = &arenas->arenas[i];
+		if (take_block(arena, range->order, &moved->offset))
+			continue;
+
+		moved->arena = i;
+		if (is_arena_range_before(moved, range))
+			return 0;
+
+		/* The range is already in front of the free blocks of its arena */
+		give_block(arena, moved->order, moved->offset);
+		break;
+	}
+
+	return -1;
+}
+
+void
+free_arena_range(struct vk_device *dev, struct mesh_arenas *arenas, const struct arena_range *range)
+{
+	struct mesh_arena *arena;
+
+	give_block(&arenas->arenas[range->arena], range->order, range->offset);
+
+	/* The first arena is always kept. The frames in flight still bind the
+	 * buffer of the others, even with nothing left to draw from it. */
+	while (arenas->arena_count > 1 && !arenas->arenas[arenas->arena_count - 1].used) {
+		arena = &arenas->arenas[--arenas->arena_count];
+		defer_buffer_destruction(dev, arena->buffer, &arena->memory);
+		free(arena->free_blocks[0]);
+	}
+}
@@ -0,0 +1,71 @@
+#ifndef VK_MESH_ARENA_H
+#define VK_MESH_ARENA_H
+
+#include <vulkan/vulkan.h>
+#include <stdint.h>
+
+#include "vk_memory.h"
+
+/* Blocks of the buddy allocator go from 2^MESH_ARENA_MIN_ORDER bytes to
+ * the whole arena */
+#define MESH_ARENA_MIN_ORDER 8
+#define MESH_ARENA_MAX_ORDER 25
+#define MESH_ARENA_ORDER_COUNT (MESH_ARENA_MAX_ORDER - MESH_ARENA_MIN_ORDER + 1)
+#define MESH_ARENA_SIZE ((VkDeviceSize) 1 << MESH_ARENA_MAX_ORDER)
+#define MAX_MESH_ARENAS 16
+
+struct vk_device;
+
+/* Block of a mesh arena */
+struct arena_range {
+	uint32_t arena;
+	uint32_t order;
+	VkDeviceSize offset;
+};
+
+#define get_arena_range_size(range) ((VkDeviceSize) 1 << (range)->order)
+
+/* A device local buffer holding the vertices and the indices of many chunk
+ * meshes, split with a buddy allocator */
+struct mesh_arena {
+	VkBuffer buffer;
+	struct memory_allocation memory;
+	/* One bit per block of each order, set if the block is free */
+	uint64_t *free_blocks[MESH_ARENA_ORDER_COUNT];
+	uint32_t free_count[MESH_ARENA_ORDER_COUNT];
+	VkDeviceSize used;
+};
+
+/* The arenas are created as needed, and the last one is destroyed once
+ * empty, the compaction moves the meshes toward the first arenas */
+struct mesh_arenas {
+	struct mesh_arena arenas[MAX_MESH_ARENAS];
+	uint32_t arena_count;
+};
+
+/* The lowest free block of the smallest order that fits `size` */
+int
+allocate_arena_range(struct vk_device *dev, struct mesh_arenas *arenas, VkDeviceSize size, struct arena_range *range);
+
+/* A free block of the same order before `range`, taken from the arenas
+ * that already exist. Returns -1 if there is none. */
+int
+take_arena_range_before(struct mesh_arenas *arenas, const struct arena_range *range, struct arena_range *moved);
+
+/* No frame in flight may still use the range, see
+ * `defer_arena_range_free()` */
+void
+free_arena_range(struct vk_device *dev, struct mesh_arenas *arenas, const struct arena_range *range);
+
+/* True if `a` comes before `b` in the arenas */
+#define is_arena_range_before(a, b) \
+	((a)->arena < (b)->arena || ((a)->arena == (b)->arena && (a)->offset < (b)->offset))
+
+#define are_arena_ranges_overlapping(a, b) \
+	((a)->arena == (b)->arena && (a)->offset < (b)->offset + get_arena_range_size(b) && \
+	 (b)->offset < (a)->offset + get_arena_range_size(a))
+
+void
+destroy_mesh_arenas(struct vk_device *dev, struct mesh_arenas *arenas);
+
+#endif //VK_MESH_ARENA_H
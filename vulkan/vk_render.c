@@ -109,14 +109,10 @@ create_shader_module(const VkDevice logical_device, const char *code, int64_t si
 }
 
 int
-create_graphics_pipeline(const VkDevice logical_device, struct swapchain_info *swapchain_info, struct vk_render *render)
+create_shader_modules(const VkDevice logical_device, struct vk_render *render)
 {
-	static VkVertexInputAttributeDescription vertex_attribute_descriptions[3];
-	static VkVertexInputBindingDescription vertex_binding_description[2];
 	char *vert_shader_code, *frag_shader_code;
 	int64_t vert_size, frag_size;
-	VkPipeline pipeline;
-	VkResult result;
 	int ret = -1;
 
 	vert_shader_code = read_file("shaders/vert.spv", &vert_size);
@@ -127,18 +123,72 @@ create_graphics_pipeline(const VkDevice logical_device, struct swapchain_info *s
 	if (!frag_shader_code)
 		goto destroy_vert_code;
 
-	VkShaderModule vert_shader_module = create_shader_module(logical_device, vert_shader_code, vert_size);
-	if (vert_shader_module == VK_NULL_HANDLE)
+	render->vert_shader_module = create_shader_module(logical_device, vert_shader_code, vert_size);
+	if (render->vert_shader_module == VK_NULL_HANDLE)
 		goto destroy_frag_code;
 
-	VkShaderModule frag_shader_module = create_shader_module(logical_device, frag_shader_code, frag_size);
-	if (frag_shader_module == VK_NULL_HANDLE)
-		goto destroy_vert_module;
+	render->frag_shader_module = create_shader_module(logical_device, frag_shader_code, frag_size);
+	if (render->frag_shader_module == VK_NULL_HANDLE) {
+		vkDestroyShaderModule(logical_device, render->vert_shader_module, NULL);
+		goto destroy_frag_code;
+	}
+
+	ret = 0;
+
+destroy_frag_code:
+	free(frag_shader_code);
+destroy_vert_code:
+	free(vert_shader_code);
+return_error:
+	return ret;
+}
+
+void
+destroy_shader_modules(const VkDevice logical_device, struct vk_render *render)
+{
+	vkDestroyShaderModule(logical_device, render->frag_shader_module, NULL);
+	vkDestroyShaderModule(logical_device, render->vert_shader_module, NULL);
+}
+
+int
+create_pipeline_layout(const VkDevice logical_device, struct vk_render *render)
+{
+	VkResult result;
+
+	/* The origin of the chunk being drawn */
+	VkPushConstantRange push_constant_range = {
+		.stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+		.offset = 0,
+		.size = sizeof(vec3)
+	};
+
+	VkPipelineLayoutCreateInfo pipeline_layout_info = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+		.setLayoutCount = 1,
+		.pSetLayouts = &render->descriptor_set_layout,
+		.pushConstantRangeCount = 1,
+		.pPushConstantRanges = &push_constant_range
+	};
+
+	result = vkCreatePipelineLayout(logical_device, &pipeline_layout_info, NULL, &render->pipeline_layout);
+	if (result != VK_SUCCESS) {
+		print_error("Failed to create pipeline layout!");
+		return -1;
+	}
+
+	return 0;
+}
+
+int
+create_graphics_pipeline(const VkDevice logical_device, struct vk_render *render)
+{
+	static VkVertexInputAttributeDescription vertex_attribute_descriptions[1];
+	static VkVertexInputBindingDescription vertex_binding_description[1];
+	VkPipeline pipeline;
+	VkResult result;
 
 	get_vertex_binding_description(0, vertex_binding_description);
 	get_vertex_attribute_descriptions(0, 0, vertex_attribute_descriptions);
-	get_vec3_binding_description(1, VK_VERTEX_INPUT_RATE_INSTANCE, &vertex_binding_description[1]);
-	get_vec3_attribute_descriptions(1, 2, &vertex_attribute_descriptions[2]);
 
 	VkPipelineVertexInputStateCreateInfo vertex_input_info = {
 		.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
@@ -151,14 +201,14 @@ create_graphics_pipeline(const VkDevice logical_device, struct swapchain_info *s
 	VkPipelineShaderStageCreateInfo vert_shader_stage_info = {
 		.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
 		.stage = VK_SHADER_STAGE_VERTEX_BIT,
-		.module = vert_shader_module,
+		.module = render->vert_shader_module,
 		.pName = "main"
 	};
 
 	VkPipelineShaderStageCreateInfo frag_shader_stage_info = {
 		.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
 		.stage = VK_SHADER_STAGE_FRAGMENT_BIT,
-		.module = frag_shader_module,
+		.module = render->frag_shader_module,
 		.pName = "main"
 	};
 
@@ -173,27 +223,20 @@ create_graphics_pipeline(const VkDevice logical_device, struct swapchain_info *s
 		.primitiveRestartEnable = VK_FALSE
 	};
 
-	VkViewport viewport = {
-		.x = 0.0f,
-		.y = 0.0f,
-		.width = swapchain_info->extent.width,
-		.height = swapchain_info->extent.height,
-		.minDepth = 0.0f,
-		.maxDepth = 1.0f
-	};
-
-	VkRect2D scissor = {
-		.offset = {0, 0},
-		.extent = swapchain_info->extent
-	};
-
-	/* Now just fill the struct with the two above */
+	/* Set when the commands are recorded, so the pipeline does not depend
+	 * on the swapchain extent, see `record_draw_cmd()` */
 	VkPipelineViewportStateCreateInfo viewport_state = {
 		.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
 		.viewportCount = 1,
-		.pViewports = &viewport,
-		.scissorCount = 1,
-		.pScissors = &scissor
+		.scissorCount = 1
+	};
+
+	VkDynamicState dynamic_states[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+
+	VkPipelineDynamicStateCreateInfo dynamic_state = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+		.dynamicStateCount = array_size(dynamic_states),
+		.pDynamicStates = dynamic_states
 	};
 
 	/* The rasterization node of the pipeline */
@@ -250,18 +293,6 @@ create_graphics_pipeline(const VkDevice logical_device, struct swapchain_info *s
 		.blendConstants[3] = 0.0f, // Optional
 	};
 
-	VkPipelineLayoutCreateInfo pipeline_layout_info = {
-		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
-		.setLayoutCount = 1,
-		.pSetLayouts = &render->descriptor_set_layout
-	};
-
-	result = vkCreatePipelineLayout(logical_device, &pipeline_layout_info, NULL, &render->pipeline_layout);
-	if (result != VK_SUCCESS) {
-		print_error("Failed to create pipeline layout!");
-		goto destroy_frag_module;
-	}
-
 	VkPipelineDepthStencilStateCreateInfo depth_stencil = {
 		.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
 		.depthTestEnable = VK_TRUE,
@@ -282,7 +313,7 @@ create_graphics_pipeline(const VkDevice logical_device, struct swapchain_info *s
 		.pMultisampleState = &multisampling,
 		.pDepthStencilState = &depth_stencil,
 		.pColorBlendState = &color_blending,
-		.pDynamicState = NULL, // Optional
+		.pDynamicState = &dynamic_state,
 		.renderPass = render->render_pass,
 		.layout = render->pipeline_layout,
 		.subpass = 0,
@@ -292,24 +323,12 @@ create_graphics_pipeline(const VkDevice logical_device, struct swapchain_info *s
 
 	result = vkCreateGraphicsPipelines(logical_device, VK_NULL_HANDLE, 1, &pipeline_info, NULL, &pipeline);
 	if (result != VK_SUCCESS) {
-		vkDestroyPipelineLayout(logical_device, render->pipeline_layout, NULL);
 		print_error("Failed to create graphics pipeline!");
-		goto destroy_frag_module;
+		return -1;
 	}
 	render->graphics_pipeline = pipeline;
 
-	ret = 0;
-
-destroy_frag_module:
-	vkDestroyShaderModule(logical_device, frag_shader_module, NULL);
-destroy_vert_module:
-	vkDestroyShaderModule(logical_device, vert_shader_module, NULL);
-destroy_frag_code:
-	free(frag_shader_code);
-destroy_vert_code:
-	free(vert_shader_code);
-return_error:
-	return ret;
+	return 0;
 }
 
 int
@@ -370,12 +389,12 @@ framebuffers_cleanup(const VkDevice logical_device, VkFramebuffer *framebuffers,
 int
 create_depth_resources(struct vk_device *dev, struct vk_render *render, VkExtent2D swapchain_extent)
 {
-	VkDeviceMemory depth_image_memory;
+	struct memory_allocation depth_image_memory;
 	VkImageView depth_image_view;
 	VkImage depth_image;
 	int ret = -1;
 
-	ret = create_image(dev, swapchain_extent.width, swapchain_extent.height, render->depth_format,
+	ret = create_image(dev, swapchain_extent.width, swapchain_extent.height, 1, render->depth_format,
 					   VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
 					   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &depth_image, &depth_image_memory);
 	if (ret) {
@@ -383,7 +402,8 @@ create_depth_resources(struct vk_device *dev, struct vk_render *render, VkExtent
 		goto return_error;
 	}
 
-	depth_image_view = create_image_view(dev->logical_device, depth_image, render->depth_format, VK_IMAGE_ASPECT_DEPTH_BIT);
+	depth_image_view = create_image_view(dev->logical_device, depth_image, render->depth_format,
+										 VK_IMAGE_ASPECT_DEPTH_BIT, VK_IMAGE_VIEW_TYPE_2D);
 	if (depth_image_view == VK_NULL_HANDLE) {
 		print_error("Failed to create depth buffer image view!");
 		goto destroy_depth_image;
@@ -396,8 +416,7 @@ create_depth_resources(struct vk_device *dev, struct vk_render *render, VkExtent
 	return 0;
 
 destroy_depth_image:
-	vkDestroyImage(dev->logical_device, depth_image, NULL);
-	vkFreeMemory(dev->logical_device, depth_image_memory, NULL);
+	destroy_image(dev, depth_image, &depth_image_memory);
 return_error:
 	return ret;
 }
@@ -7,8 +7,20 @@
 VkRenderPass
 create_render_pass(VkDevice logical_device, VkFormat depth_format, struct swapchain_info state);
 
+/* Read once at init, with the pipeline */
 int
-create_graphics_pipeline(const VkDevice logical_device, struct swapchain_info *swapchain_info, struct vk_render *render);
+create_shader_modules(const VkDevice logical_device, struct vk_render *render);
+
+void
+destroy_shader_modules(const VkDevice logical_device, struct vk_render *render);
+
+/* The descriptor set layout must exist */
+int
+create_pipeline_layout(const VkDevice logical_device, struct vk_render *render);
+
+/* The shader modules and the pipeline layout must exist */
+int
+create_graphics_pipeline(const VkDevice logical_device, struct vk_render *render);
 
 int
 create_framebuffers(const VkDevice logical_device, struct vk_swapchain *swapchain, struct vk_render *render);
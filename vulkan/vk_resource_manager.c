@@ -4,6 +4,7 @@
 #include "vk_resource_manager.h"
 #include "vk_logical_device.h"
 #include "vk_command_buffer.h"
+#include "vk_deletion_queue.h"
 #include "vk_descriptors.h"
 #include "vk_gpu_objects.h"
 #include "vk_swapchain.h"
@@ -16,6 +17,7 @@
 #include "game_data.h"
 #include "vk_render.h"
 #include "vk_buffer.h"
+#include "constants.h"
 #include "vk_image.h"
 #include "terrain.h"
 #include "vk_draw.h"
@@ -29,11 +31,9 @@ create_render_and_presentation_infra(struct vk_program *program)
 	struct vk_render *render = &dev->render;
 	struct vk_swapchain *swapchain = &dev->swapchain;
 	struct swapchain_info *state = &swapchain->state;
-	struct vk_vertex_object *cube = &dev->game_objs.cube;
 	VkExtent2D *extent = &state->extent;
-	struct view_projection *camera = &dev->game_objs.camera;
 
-	if (create_swapchain(dev, game_window->surface, game_window->window))
+	if (create_swapchain(dev, game_window->surface, game_window->window, VK_NULL_HANDLE))
 		goto exit_error;
 
 	if (create_swapchain_image_views(dev->logical_device, swapchain))
@@ -43,7 +43,7 @@ create_render_and_presentation_infra(struct vk_program *program)
 	if (render->render_pass == VK_NULL_HANDLE)
 		goto destroy_image_views;
 
-	if (create_graphics_pipeline(dev->logical_device, state, render))
+	if (create_graphics_pipeline(dev->logical_device, render))
 		goto destroy_render_pass;
 
 	if (create_depth_resources(dev, render, *extent))
@@ -52,15 +52,12 @@ create_render_and_presentation_infra(struct vk_program *program)
 	if (create_framebuffers(dev->logical_device, swapchain, &dev->render))
 		goto destroy_depth_resources;
 
-	if (create_vp_ubo_buffers(dev, camera))
-		goto destroy_framebuffers;
-
 	/* Update the projection matrix to handle a possible windows resize */
-	update_projection(camera->proj, program->game.configs.FoV, extent->width, extent->height, -1.0f);
+	update_projection(dev->game_objs.camera.proj, program->game.configs.FoV, extent->width, extent->height, -1.0f);
 
-	dev->cmd_submission.descriptor_pool = create_descriptor_pool(dev->logical_device, swapchain, cube->texture_count);
+	dev->cmd_submission.descriptor_pool = create_descriptor_pool(dev->logical_device, swapchain);
 	if (dev->cmd_submission.descriptor_pool == VK_NULL_HANDLE)
-		goto destroy_vp_buffers;
+		goto destroy_framebuffers;
 
 	if (create_descriptor_sets(dev, &dev->cmd_submission, render->descriptor_set_layout))
 		goto destroy_descriptor_pool;
@@ -70,23 +67,20 @@ create_render_and_presentation_infra(struct vk_program *program)
 	/* Descriptor sets are destroyed *here* */
 destroy_descriptor_pool:
 	vkDestroyDescriptorPool(dev->logical_device, dev->cmd_submission.descriptor_pool, NULL);
-destroy_vp_buffers:
-	destroy_buffer_vector(dev, camera->buffers, camera->buffers_memory, camera->buffer_count);
 destroy_framebuffers:
 	framebuffers_cleanup(dev->logical_device, render->swapChain_framebuffers, render->framebuffer_count);
 destroy_depth_resources:
-	vkDestroyImage(dev->logical_device, render->depth_image, NULL);
-	vkFreeMemory(dev->logical_device, render->depth_image_memory, NULL);
 	vkDestroyImageView(dev->logical_device, render->depth_image_view, NULL);
+	destroy_image(dev, render->depth_image, &render->depth_image_memory);
 destroy_graphics_pipeline:
 	vkDestroyPipeline(dev->logical_device, render->graphics_pipeline, NULL);
-	vkDestroyPipelineLayout(dev->logical_device, render->pipeline_layout, NULL);
 destroy_render_pass:
 	vkDestroyRenderPass(dev->logical_device, render->render_pass, NULL);
 destroy_image_views:
 	image_views_cleanup(dev->logical_device, swapchain->image_views, swapchain->images_count);
 destroy_swapchain:
 	vkDestroySwapchainKHR(dev->logical_device, swapchain->handle, NULL);
+	free(swapchain->images);
 exit_error:
 	return -1;
 }
@@ -96,104 +90,35 @@ destroy_render_and_presentation_infra(struct vk_device *dev)
 {
 	struct vk_render *render = &dev->render;
 	struct vk_swapchain *swapchain = &dev->swapchain;
-	struct view_projection *camera = &dev->game_objs.camera;
 
 	/* Descriptor sets are destroyed *here* */
-	destroy_buffer_vector(dev, camera->buffers, camera->buffers_memory, camera->buffer_count);
 	vkDestroyDescriptorPool(dev->logical_device, dev->cmd_submission.descriptor_pool, NULL);
 	free(dev->cmd_submission.descriptor_sets);
 
 	/* Cleanup pipeline resources */
 	framebuffers_cleanup(dev->logical_device, render->swapChain_framebuffers, render->framebuffer_count);
 	vkDestroyPipeline(dev->logical_device, dev->render.graphics_pipeline, NULL);
-	vkDestroyPipelineLayout(dev->logical_device, render->pipeline_layout, NULL);
 	vkDestroyRenderPass(dev->logical_device, dev->render.render_pass, NULL);
 	/* Destroy depth resources */
-	vkDestroyImage(dev->logical_device, render->depth_image, NULL);
-	vkFreeMemory(dev->logical_device, render->depth_image_memory, NULL);
 	vkDestroyImageView(dev->logical_device, render->depth_image_view, NULL);
+	destroy_image(dev, render->depth_image, &render->depth_image_memory);
 
 	/* Cleanup swapchain resources*/
 	image_views_cleanup(dev->logical_device, swapchain->image_views, swapchain->images_count);
 	vkDestroySwapchainKHR(dev->logical_device, swapchain->handle, NULL);
-}
-
-int
-_create_render_and_presentation_infra(struct vk_program *program)
-{
-	struct vk_device *dev = &program->device;
-	uint32_t *cmd_buffers_count = dev->cmd_submission.cmd_buffers_count;
-	VkCommandBuffer **cmd_buffer = dev->cmd_submission.cmd_buffers;
-	VkCommandPool *cmd_pool = dev->cmd_submission.command_pools;
-	struct vk_vertex_object *cube = &dev->game_objs.cube;
-	uint32_t buffer_count = dev->swapchain.images_count;
-	int i, ret;
-
-	if (create_render_and_presentation_infra(program))
-		goto return_error;
-
-	cmd_buffer[graphics] = alloc_command_buffers(dev->logical_device, cmd_pool[graphics],
-												 VK_COMMAND_BUFFER_LEVEL_PRIMARY, buffer_count);
-	if (!cmd_buffer[graphics])
-		goto destroy_render_and_presentation_infra;
-
-	dev->cmd_submission.cmd_buffers_count[graphics] = buffer_count;
-
-	if (create_cubes_position_buffers(dev, cube, dev->swapchain.images_count))
-		goto free_graphics_command_buffers;
-
-	vkQueueWaitIdle(dev->cmd_submission.queue_handles[graphics]);
-	for (i = 0; i < dev->swapchain.images_count; i++) {
-		ret = copy_buffer(&dev->cmd_submission, cube->staging_position_buffer,
-						  cube->position_buffer[i], cube->position_count * sizeof(vec3));
-		if (ret) {
-			pprint_error("Failed to copy position data to %d/%d gpu poistion buffer", i+1, dev->swapchain.images_count);
-			goto destroy_position_buffers;
-		}
-	}
-
-	return 0;
-
-destroy_position_buffers:
-	destroy_buffer_vector(dev, cube->position_buffer, cube->position_buffer_memory, dev->swapchain.images_count);
-free_graphics_command_buffers:
-	vkFreeCommandBuffers(dev->logical_device, cmd_pool[graphics], cmd_buffers_count[graphics], cmd_buffer[graphics]);
-	free_command_buffer_vector(dev->cmd_submission.cmd_buffers);
-destroy_render_and_presentation_infra:
-	destroy_render_and_presentation_infra(dev);
-return_error:
-	return -1;
-}
-
-void
-_destroy_render_and_presentation_infra(struct vk_device *dev)
-{
-	uint32_t *cmd_buffers_count = dev->cmd_submission.cmd_buffers_count;
-	VkCommandBuffer **cmd_buffer = dev->cmd_submission.cmd_buffers;
-	VkCommandPool *cmd_pool = dev->cmd_submission.command_pools;
-	struct vk_vertex_object *cube = &dev->game_objs.cube;
-
-	destroy_render_and_presentation_infra(dev);
-
-	destroy_buffer_vector(dev, cube->position_buffer, cube->position_buffer_memory, cube->position_buffer_count);
-
-	/* Free grahics command buffers */
-	vkFreeCommandBuffers(dev->logical_device, cmd_pool[graphics], cmd_buffers_count[graphics], cmd_buffer[graphics]);
-	free_command_buffer_vector(dev->cmd_submission.cmd_buffers);
-	cmd_buffers_count[graphics] = 0;
+	free(swapchain->images);
 }
 
 int
 init_vk(struct vk_program *program)
 {
 	struct vk_device *dev = &program->device;
-	struct vk_vertex_object *cube = &dev->game_objs.cube;
-	struct vk_cmd_submission *cmd_sub = &dev->cmd_submission;
 	struct window *game_window = &program->game_window;
 	struct vk_render *render = &dev->render;
 	struct game_data *game = &program->game;
+	uint32_t chunk_count;
 	VkResult result;
-	int ret, i;
+	int seed;
 
 	program->app_info = create_app_info();
 	program->instance = create_instance(&program->app_info);
@@ -214,104 +139,100 @@ init_vk(struct vk_program *program)
 	if (create_logical_device(dev))
 		goto destroy_surface_support;
 
+	memory_allocator_init(&dev->allocator, dev->physical_device, dev->logical_device);
+
 	if (create_command_pools(dev))
 		goto destroy_device;
 
 	if (create_command_buffers(dev, dev->swapchain.support.capabilities.minImageCount + 1))
 		goto destroy_command_pools;
 
-	if (load_all_textures(dev))
+	if (upload_engine_init(dev, &dev->upload_engine))
 		goto destroy_command_pools;
 
-	ret = create_texture_image_views(dev->logical_device, cube->texture_images,
-									 &cube->texture_images_view, cube->texture_count);
-	if (ret)
-		goto destroy_texture;
+	if (load_all_textures(dev))
+		goto destroy_upload_engine;
 
 	render->texture_sampler = create_texture_sampler(dev->logical_device, &dev->device_properties.device_properties);
 	if (render->texture_sampler == VK_NULL_HANDLE)
-		goto destroy_texture_image_view;
+		goto destroy_texture;
 
-	dev->render.descriptor_set_layout = create_descriptor_set_layout_binding(dev->logical_device, cube->texture_count);
+	dev->render.descriptor_set_layout = create_descriptor_set_layout_binding(dev->logical_device);
 	if (dev->render.descriptor_set_layout == VK_NULL_HANDLE)
 		goto destroy_texture_sampler;
 
+	/* Kept when the window is resized */
+	if (create_shader_modules(dev->logical_device, render))
+		goto destroy_descriptor_set_layout;
+
+	if (create_pipeline_layout(dev->logical_device, render))
+		goto destroy_shader_modules;
+
 	init_game_state(game);
 
-	init_noise_generator(&game->terrain.noise, get_seed());
+	/* The seed of a new level, an existing one keeps its own */
+	seed = get_seed();
+	if (open_level(WORLD_DIRECTORY, &seed))
+		goto destroy_pipeline_layout;
 
-	/* Create cubes position staging buffer */
-	ret = create_buffer(dev, CUBES_POSITION_BUFFER_SIZE, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-						VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-						&cube->staging_position_buffer, &cube->staging_position_buffer_memory);
-	if (ret)
-		goto destroy_descriptor_set_layout;
+	init_noise_generator(&game->terrain.noise, seed);
 
-	// TODO: Move the terrain genetion to vk_main_loop
-	if (generate_terrain_buffer(dev, &game->terrain.noise, cube))
-		goto destroy_cube_staging_buffer;
+	if (region_store_init(&game->terrain.regions, WORLD_DIRECTORY))
+		goto destroy_pipeline_layout;
 
-	if (create_cubes_position_buffers(dev, cube, dev->swapchain.support.capabilities.minImageCount + 1))
-		goto destroy_cube_staging_buffer;
+	if (worker_pool_init(&game->workers, get_worker_count(), WORKER_QUEUE_SIZE))
+		goto destroy_region_store;
 
-	for (i = 0; i < cube->position_buffer_count; i++) {
-		ret = copy_buffer(&dev->cmd_submission, cube->staging_position_buffer,
-						  cube->position_buffer[i], cube->position_count * sizeof(vec3));
-		if (ret)
-			goto destroy_cubes_position_buffers;
-	}
+	/* Enough for the chunks around the player, the cached ones grow it, see
+	 * `struct world_streamer` */
+	chunk_count = 2 * (game->configs.view_distance + 2) + 1;
+	if (world_init(&game->terrain.world, chunk_count * chunk_count))
+		goto destroy_worker_pool;
 
-	if (create_render_and_presentation_infra(program))
-		goto destroy_cubes_position_buffers;
-
-	/* TODO: remove this, and either
-	 * - Add a function to from these informationsload a file or
-	 * - Create a function to do this
-	 */
-	cube->vertices = cube_vertices;
-	cube->vertices_count = array_size(cube_vertices);
-	cube->indices = cube_vertex_indices;
-	cube->indices_count = array_size(cube_vertex_indices);
-
-	if (create_vertex_buffer(dev, cube))
-		goto destroy_render_and_presentation_infra;
+	world_streamer_init(&game->terrain.streamer, &game->terrain.world, &game->terrain.noise,
+						&game->workers, &game->terrain.regions, game->configs.view_distance);
+
+	upload_scheduler_init(&dev->game_objs.uploads, UPLOAD_BYTES_PER_FRAME, UPLOAD_TIME_PER_FRAME_US);
 
-	if (create_index_buffer(dev, cube))
-		goto destroy_vertex_shader;
+	/* Before the descriptor sets, they point to it */
+	if (frame_ring_init(dev, &dev->frame_ring, FRAME_RING_SIZE))
+		goto destroy_world;
 
-	if (record_draw_cmd(cmd_sub, &dev->swapchain, &dev->render, &dev->game_objs))
-		goto destroy_index_shader;
+	if (create_render_and_presentation_infra(program))
+		goto destroy_frame_ring;
 
 	if (create_sync_objects(dev->logical_device, &dev->draw_sync, dev->swapchain.images_count))
-		goto destroy_index_shader;
+		goto destroy_render_and_presentation_infra;
 
 	return 0;
 
-destroy_index_shader:
-	vkDestroyBuffer(dev->logical_device, cube->index_buffer, NULL);
-	vkFreeMemory(dev->logical_device, cube->index_buffer_memory, NULL);
-destroy_vertex_shader:
-	vkDestroyBuffer(dev->logical_device, cube->vertex_buffer, NULL);
-	vkFreeMemory(dev->logical_device, cube->vertex_buffer_memory, NULL);
 destroy_render_and_presentation_infra:
 	destroy_render_and_presentation_infra(dev);
-destroy_cubes_position_buffers:
-	destroy_buffer_vector(dev, cube->position_buffer, cube->position_buffer_memory, dev->swapchain.images_count);
-destroy_cube_staging_buffer:
-	vkDestroyBuffer(dev->logical_device, cube->staging_position_buffer, NULL);
-	vkFreeMemory(dev->logical_device, cube->staging_position_buffer_memory, NULL);
+destroy_frame_ring:
+	frame_ring_destroy(dev, &dev->frame_ring);
+destroy_world:
+	world_destroy(&game->terrain.world);
+destroy_worker_pool:
+	worker_pool_destroy(&game->workers);
+destroy_region_store:
+	region_store_destroy(&game->terrain.regions);
+destroy_pipeline_layout:
+	vkDestroyPipelineLayout(dev->logical_device, render->pipeline_layout, NULL);
+destroy_shader_modules:
+	destroy_shader_modules(dev->logical_device, render);
 destroy_descriptor_set_layout:
 	vkDestroyDescriptorSetLayout(dev->logical_device, dev->render.descriptor_set_layout, NULL);
 destroy_texture_sampler:
 	vkDestroySampler(dev->logical_device, render->texture_sampler, NULL);
-destroy_texture_image_view:
-	destroy_texture_image_views(dev->logical_device, cube->texture_images_view, cube->texture_count);
 destroy_texture:
-	destroy_texture_images(dev, cube->texture_images_memory, cube->texture_images, cube->texture_count);
+	destroy_block_textures(dev, &dev->game_objs.textures);
+destroy_upload_engine:
+	upload_engine_destroy(dev, &dev->upload_engine);
 destroy_command_pools:
 	cleanup_command_pools(dev->logical_device, dev->cmd_submission.command_pools);
 	free_command_buffer_vector(dev->cmd_submission.cmd_buffers);
 destroy_device:
+	memory_allocator_destroy(&dev->allocator);
 	vkDestroyDevice(dev->logical_device, NULL);
 destroy_surface_support:
 	surface_support_cleanup(&dev->swapchain.support);
@@ -328,36 +249,46 @@ vk_cleanup(struct vk_program *program)
 {
 	struct window *game_window = &program->game_window;
 	struct vk_device *dev = &program->device;
-	struct vk_vertex_object *cube = &dev->game_objs.cube;
 	struct vk_render *render = &dev->render;
 
 	/* Destroy the draw synchronization primitives */
 	sync_objects_cleanup(dev->logical_device, &dev->draw_sync);
 
-	/* Destroy vertex and index buffer and buffer memory */
-	vkDestroyBuffer(dev->logical_device, cube->index_buffer, NULL);
-	vkFreeMemory(dev->logical_device, cube->index_buffer_memory, NULL);
-	vkDestroyBuffer(dev->logical_device, cube->vertex_buffer, NULL);
-	vkFreeMemory(dev->logical_device, cube->vertex_buffer_memory, NULL);
-	/* Destroy buffer position vectors*/
-	destroy_buffer_vector(dev, cube->position_buffer, cube->position_buffer_memory, dev->swapchain.images_count);
-	vkDestroyBuffer(dev->logical_device, cube->staging_position_buffer, NULL);
-	vkFreeMemory(dev->logical_device, cube->staging_position_buffer_memory, NULL);
+	/* Frees the retired ranges while their arenas still exist */
+	deletion_queue_destroy(dev);
+
+	/* Destroy the vertex and index buffers of the chunks */
+	destroy_chunk_meshes(dev, &dev->game_objs);
+
+	frame_ring_destroy(dev, &dev->frame_ring);
+
+	upload_engine_destroy(dev, &dev->upload_engine);
+
+	/* Waits for the chunk tasks, they use the world, and saves it */
+	world_streamer_destroy(&program->game.terrain.streamer);
+	worker_pool_destroy(&program->game.workers);
+	world_destroy(&program->game.terrain.world);
+	region_store_destroy(&program->game.terrain.regions);
 
 	/* clean texture resources */
 	vkDestroySampler(dev->logical_device, render->texture_sampler, NULL);
-	destroy_texture_image_views(dev->logical_device, cube->texture_images_view, cube->texture_count);
-	destroy_texture_images(dev, cube->texture_images_memory, cube->texture_images, cube->texture_count);
+	destroy_block_textures(dev, &dev->game_objs.textures);
 
 	/* Free command submission resources */
 	cleanup_command_pools(dev->logical_device, dev->cmd_submission.command_pools);
 	free_command_buffer_vector(dev->cmd_submission.cmd_buffers);
 
+	vkDestroyPipelineLayout(dev->logical_device, render->pipeline_layout, NULL);
+	destroy_shader_modules(dev->logical_device, render);
+
 	/* Destroy the uniform buffer MVP descriptor set layout, used in the graphics pipeline */
 	vkDestroyDescriptorSetLayout(dev->logical_device, dev->render.descriptor_set_layout, NULL);
 
 	surface_support_cleanup(&dev->swapchain.support);
 
+	/* Every buffer and image is destroyed by now */
+	memory_allocator_destroy(&dev->allocator);
+
 	vkDestroyDevice(dev->logical_device, NULL);
 
 	vkDestroySurfaceKHR(program->instance, game_window->surface, NULL);
@@ -365,12 +296,129 @@ vk_cleanup(struct vk_program *program)
 	vkDestroyInstance(program->instance, NULL);
 }
 
+/* What the frames in flight may still use goes to the deletion queue, the
+ * last frame submitted is the last one that can use it */
+static void
+retire_render_and_presentation_infra(struct vk_device *dev, const struct vk_swapchain *old_swapchain)
+{
+	struct vk_render *render = &dev->render;
+	struct deferred_destruction deferred = {
+		.frame = dev->draw_sync.frame_submitted
+	};
+	uint32_t i;
+
+	deferred.kind = deferred_framebuffer;
+	for (i = 0; i < render->framebuffer_count; i++) {
+		deferred.framebuffer = render->swapChain_framebuffers[i];
+		defer_destruction(dev, &deferred);
+	}
+
+	free(render->swapChain_framebuffers);
+	render->swapChain_framebuffers = NULL;
+	render->framebuffer_count = 0;
+
+	deferred.kind = deferred_image;
+	deferred.image.image = render->depth_image;
+	deferred.image.view = render->depth_image_view;
+	deferred.image.memory = render->depth_image_memory;
+	defer_destruction(dev, &deferred);
+
+	deferred.kind = deferred_image_view;
+	for (i = 0; i < old_swapchain->images_count; i++) {
+		deferred.image_view = old_swapchain->image_views[i];
+		defer_destruction(dev, &deferred);
+	}
+
+	free(old_swapchain->image_views);
+	free(old_swapchain->images);
+
+	deferred.kind = deferred_swapchain;
+	deferred.swapchain = old_swapchain->handle;
+	defer_destruction(dev, &deferred);
+}
+
+/* Only if the surface format changed, the pipeline is tied to the render
+ * pass. The frames in flight are waited, the framebuffers are created from
+ * it again after. */
+static int
+recreate_render_pass_and_pipeline(struct vk_device *dev)
+{
+	struct vk_draw_sync *sync = &dev->draw_sync;
+	struct vk_render *render = &dev->render;
+
+	if (wait_timeline(dev->logical_device, sync->frame_timeline, &sync->frame_completed, sync->frame_submitted))
+		return -1;
+
+	vkDestroyPipeline(dev->logical_device, render->graphics_pipeline, NULL);
+	vkDestroyRenderPass(dev->logical_device, render->render_pass, NULL);
+
+	render->render_pass = create_render_pass(dev->logical_device, render->depth_format, dev->swapchain.state);
+	if (render->render_pass == VK_NULL_HANDLE)
+		return -1;
+
+	return create_graphics_pipeline(dev->logical_device, render);
+}
+
+/* Only if the new swapchain has another image count. Each image has its
+ * command buffer and descriptor set, any of them may be in use, so the
+ * frames in flight are waited. */
+static int
+recreate_per_image_resources(struct vk_device *dev)
+{
+	struct vk_cmd_submission *cmd_sub = &dev->cmd_submission;
+	uint32_t images_count = dev->swapchain.images_count;
+	struct vk_draw_sync *sync = &dev->draw_sync;
+	VkCommandBuffer *cmd_buffers;
+	uint64_t *image_frames;
+
+	if (wait_timeline(dev->logical_device, sync->frame_timeline, &sync->frame_completed, sync->frame_submitted))
+		return -1;
+
+	cmd_buffers = alloc_command_buffers(dev->logical_device, cmd_sub->command_pools[graphics],
+										VK_COMMAND_BUFFER_LEVEL_PRIMARY, images_count);
+	if (!cmd_buffers)
+		return -1;
+
+	vkFreeCommandBuffers(dev->logical_device, cmd_sub->command_pools[graphics], cmd_sub->cmd_buffers_count[graphics],
+						 cmd_sub->cmd_buffers[graphics]);
+	free(cmd_sub->cmd_buffers[graphics]);
+	cmd_sub->cmd_buffers[graphics] = cmd_buffers;
+	cmd_sub->cmd_buffers_count[graphics] = images_count;
+
+	/* Every frame is done, no image needs to be waited */
+	image_frames = calloc(sizeof(uint64_t), images_count);
+	if (!image_frames) {
+		print_error("Failed to allocate image_frames vector");
+		return -1;
+	}
+
+	free(sync->image_frames);
+	sync->image_frames = image_frames;
+
+	/* Descriptor sets are destroyed *here* */
+	vkDestroyDescriptorPool(dev->logical_device, cmd_sub->descriptor_pool, NULL);
+	free(cmd_sub->descriptor_sets);
+	cmd_sub->descriptor_sets = NULL;
+
+	cmd_sub->descriptor_pool = create_descriptor_pool(dev->logical_device, &dev->swapchain);
+	if (cmd_sub->descriptor_pool == VK_NULL_HANDLE)
+		return -1;
+
+	return create_descriptor_sets(dev, cmd_sub, dev->render.descriptor_set_layout);
+}
+
+/* Only what depends on the window size is created again: the swapchain, the
+ * depth image and the framebuffers. The pipeline, the meshes, the textures
+ * and the descriptors stay as they are, and the device is not idled. */
 int
 recreate_render_and_presentation_infra(struct vk_program *program)
 {
 	struct window *game_window = &program->game_window;
 	struct vk_device *dev = &program->device;
-	struct vk_cmd_submission *cmd_sub = &dev->cmd_submission;
+	struct vk_swapchain *swapchain = &dev->swapchain;
+	VkExtent2D *extent = &swapchain->state.extent;
+	struct vk_render *render = &dev->render;
+	struct vk_swapchain old_swapchain;
 	int width = 0, height = 0;
 
 	glfwGetFramebufferSize(game_window->window, &width, &height);
@@ -380,19 +428,40 @@ recreate_render_and_presentation_infra(struct vk_program *program)
 		glfwWaitEvents();
 	}
 
-	vkDeviceWaitIdle(dev->logical_device);
-
 	// It is needed because we had a windows resize
-	query_surface_support(dev->physical_device, game_window->surface, &dev->swapchain.support);
+	surface_support_cleanup(&swapchain->support);
+	if (query_surface_support(dev->physical_device, game_window->surface, &swapchain->support))
+		goto return_error;
 
-	_destroy_render_and_presentation_infra(dev);
-	if (_create_render_and_presentation_infra(program)) {
-		print_error("Failed to recreate the render and presentation infrastructure!");
-		return -1;
-	}
+	/* The old swapchain hands its images over to the new one */
+	old_swapchain = *swapchain;
+	if (create_swapchain(dev, game_window->surface, game_window->window, old_swapchain.handle))
+		goto return_error;
 
-	if (record_draw_cmd(cmd_sub, &dev->swapchain, &dev->render, &dev->game_objs))
-		return -1;
+	retire_render_and_presentation_infra(dev, &old_swapchain);
+
+	if (create_swapchain_image_views(dev->logical_device, swapchain))
+		goto return_error;
+
+	if (swapchain->state.surface_format.format != old_swapchain.state.surface_format.format &&
+		recreate_render_pass_and_pipeline(dev))
+		goto return_error;
+
+	if (create_depth_resources(dev, render, *extent))
+		goto return_error;
+
+	if (create_framebuffers(dev->logical_device, swapchain, render))
+		goto return_error;
+
+	if (swapchain->images_count != dev->cmd_submission.cmd_buffers_count[graphics] &&
+		recreate_per_image_resources(dev))
+		goto return_error;
+
+	update_projection(dev->game_objs.camera.proj, program->game.configs.FoV, extent->width, extent->height, -1.0f);
 
 	return 0;
+
+return_error:
+	print_error("Failed to recreate the render and presentation infrastructure!");
+	return -1;
 }
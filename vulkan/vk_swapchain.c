@@ -52,7 +52,7 @@ chooseSwapExtent(const VkSurfaceCapabilitiesKHR capabilities, GLFWwindow *window
 }
 
 int
-create_swapchain(struct vk_device *device, VkSurfaceKHR surface, GLFWwindow *window)
+create_swapchain(struct vk_device *device, VkSurfaceKHR surface, GLFWwindow *window, VkSwapchainKHR old_swapchain)
 {
 	VkSurfaceCapabilitiesKHR swapchain_capabilities = device->swapchain.support.capabilities;
 	struct swapchain_info *swapchain_state = &device->swapchain.state;
@@ -60,6 +60,7 @@ create_swapchain(struct vk_device *device, VkSurfaceKHR surface, GLFWwindow *win
 	VkSharingMode image_sharing_mode = VK_SHARING_MODE_EXCLUSIVE;
 	uint32_t queue_family_indices[queues_count];
 	uint32_t family_count = 0;
+	VkSwapchainKHR handle;
 	uint32_t image_count;
 	VkResult result;
 	VkImage* images;
@@ -97,19 +98,19 @@ create_swapchain(struct vk_device *device, VkSurfaceKHR surface, GLFWwindow *win
 		.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
 		.presentMode = swapchain_state->present_mode,
 		.clipped = VK_TRUE,
-		.oldSwapchain = VK_NULL_HANDLE,
+		.oldSwapchain = old_swapchain,
 		.pQueueFamilyIndices = queue_family_indices,
 		.queueFamilyIndexCount = family_count,
 		.imageSharingMode = image_sharing_mode
 	};
 
-	result = vkCreateSwapchainKHR(device->logical_device, &create_info, NULL, &device->swapchain.handle);
+	result = vkCreateSwapchainKHR(device->logical_device, &create_info, NULL, &handle);
 	if (result != VK_SUCCESS) {
 		print_error("Failed to create swap chain!");
 		goto return_error;
 	}
 
-	result = vkGetSwapchainImagesKHR(device->logical_device, device->swapchain.handle, &image_count, NULL);
+	result = vkGetSwapchainImagesKHR(device->logical_device, handle, &image_count, NULL);
 	if (result != VK_SUCCESS) {
 		print_error("Failed to enumerate the swap chain images!");
 		goto destroy_swapchain;
@@ -121,12 +122,13 @@ create_swapchain(struct vk_device *device, VkSurfaceKHR surface, GLFWwindow *win
 		goto destroy_swapchain;
 	}
 
-	result = vkGetSwapchainImagesKHR(device->logical_device, device->swapchain.handle, &image_count, images);
+	result = vkGetSwapchainImagesKHR(device->logical_device, handle, &image_count, images);
 	if (result != VK_SUCCESS) {
 		print_error("Failed retrieve swap chain images!");
 		goto free_images;
 	}
 
+	device->swapchain.handle = handle;
 	device->swapchain.images = images;
 	device->swapchain.images_count = image_count;
 
@@ -135,7 +137,7 @@ create_swapchain(struct vk_device *device, VkSurfaceKHR surface, GLFWwindow *win
 free_images:
 	free(images);
 destroy_swapchain:
-	vkDestroySwapchainKHR(device->logical_device, device->swapchain.handle, NULL);
+	vkDestroySwapchainKHR(device->logical_device, handle, NULL);
 return_error:
 	return -1;
 }
@@ -154,7 +156,7 @@ create_swapchain_image_views(VkDevice logical_device, struct vk_swapchain *swapc
 	for (i = 0; i < swapchain->images_count; i++) {
 		swapchain->image_views[i] = create_image_view(logical_device, swapchain->images[i],
 													  swapchain->state.surface_format.format,
-													  VK_IMAGE_ASPECT_COLOR_BIT);
+													  VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_VIEW_TYPE_2D);
 		if (!swapchain->image_views[i]) {
 			pprint_error("Failed to create %d/%u image view!", i, swapchain->images_count);
 			break;
@@ -3,8 +3,11 @@
 
 #include "vk_types.h"
 
+/* The old swapchain, if any, is retired but not destroyed, its images may
+ * still be presented. It is replaced by the new one in `device` only on
+ * success. */
 int
-create_swapchain(struct vk_device *device, VkSurfaceKHR surface, GLFWwindow *window);
+create_swapchain(struct vk_device *device, VkSurfaceKHR surface, GLFWwindow *window, VkSwapchainKHR old_swapchain);
 
 int
 create_swapchain_image_views(VkDevice logical_device, struct vk_swapchain *swapchain);
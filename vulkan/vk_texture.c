@@ -4,58 +4,53 @@
 #include "vk_texture.h"
 #include "vk_buffer.h"
 #include "vk_image.h"
+#include "mesher.h"
 #include "utils.h"
 
 #define TEX_DIR "assets/textures/"
 
 void
-destroy_texture_images(struct vk_device *dev, VkDeviceMemory *texture_image_memory,
-					   VkImage *texture_image, uint32_t images_count)
+destroy_block_textures(struct vk_device *dev, struct vk_block_textures *textures)
 {
-	int i;
-
-	for (i = 0; i < images_count; i++) {
-		vkDestroyImage(dev->logical_device, texture_image[i], NULL);
-		vkFreeMemory(dev->logical_device, texture_image_memory[i], NULL);
-	}
-
-	free(texture_image_memory);
-	free(texture_image);
+	vkDestroyImageView(dev->logical_device, textures->image_view, NULL);
+	destroy_image(dev, textures->image, &textures->image_memory);
 }
 
+/* All the layers of a texture array have the same size */
 uint64_t
-calculate_staging_buffer_size(FILE *image_files[], uint32_t images_count)
+calculate_staging_buffer_size(FILE *image_files[], uint32_t images_count, int *width, int *height)
 {
-	int tex_width[images_count], tex_height[images_count];
-	VkDeviceSize staging_buffer_size = 0;
-	uint64_t current_image_size;
-	int tex_channel, i, ret;
+	int tex_width, tex_height, tex_channel, i, ret;
 
 	for (i = 0; i < images_count; i++) {
-		ret = stbi_info_from_file(image_files[i], &tex_width[i], &tex_height[i], &tex_channel);
+		ret = stbi_info_from_file(image_files[i], &tex_width, &tex_height, &tex_channel);
 		if (!ret)
 			return 0;
 
-		current_image_size = tex_width[i] * tex_height[i] * 4;
-		if (staging_buffer_size < current_image_size)
-			staging_buffer_size = current_image_size;
+		if (i > 0 && (tex_width != *width || tex_height != *height)) {
+			pprint_error("Texture %u is %dx%d, but the first one is %dx%d", i, tex_width, tex_height, *width, *height);
+			return 0;
+		}
+
+		*width = tex_width;
+		*height = tex_height;
 	}
 
-	return staging_buffer_size;
+	return (uint64_t) tex_width * tex_height * 4 * images_count;
 }
 
 int
-create_texture_images(struct vk_device *dev, char *image_names[], uint32_t images_count,
-					 VkImage **texture_image, VkDeviceMemory **texture_image_memory)
+create_texture_array(struct vk_device *dev, char *image_names[], uint32_t images_count,
+					 struct vk_block_textures *textures)
 {
-	VkDeviceMemory *local_texture_images_memory, staging_buffer_memory;
-	int tex_width, tex_height, tex_channels, i, ret = -1;
-	VkDeviceSize staging_buffer_size;
+	int tex_width, tex_height, width, height, tex_channels, i, ret = -1;
+	struct memory_allocation staging_buffer_memory, image_memory;
+	VkDeviceSize staging_buffer_size, layer_size;
 	FILE *image_files[images_count];
-	VkImage *local_texture_images;
 	VkBuffer staging_buffer;
-	VkResult result;
+	VkImageView image_view;
 	stbi_uc* pixels;
+	VkImage image;
 	void* data;
 
 	memset(image_files, 0, sizeof(FILE *) * images_count);
@@ -68,68 +63,55 @@ create_texture_images(struct vk_device *dev, char *image_names[], uint32_t image
 		}
 	}
 
-	staging_buffer_size = calculate_staging_buffer_size(image_files, images_count);
+	staging_buffer_size = calculate_staging_buffer_size(image_files, images_count, &width, &height);
 	if (staging_buffer_size == 0) {
 		print_error("Failed to retrieve image info about texture file!");
 		goto close_files;
 	}
+	layer_size = staging_buffer_size / images_count;
 
 	ret = create_buffer(dev, staging_buffer_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
 						VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &staging_buffer, &staging_buffer_memory);
 	if (ret)
 		goto close_files;
+	ret = -1;
 
-	result = vkMapMemory(dev->logical_device, staging_buffer_memory, 0, staging_buffer_size, 0, &data);
-	if (result != VK_SUCCESS) {
-		print_error("Failed to map buffer to system memory!");
-		goto destoy_staging_buffer;
-	}
-
-	local_texture_images = malloc(sizeof(VkImage) * images_count);
-	if (!local_texture_images) {
-		print_error("Failed to allocate texture images vector!");
-		goto unmap_staging_buffer;
-	}
-
-	local_texture_images_memory = malloc(sizeof(VkDeviceMemory) * images_count);
-	if (!local_texture_images_memory) {
-		print_error("Failed to allocate texture images memory vector!");
-		free(local_texture_images);
-		goto unmap_staging_buffer;
-	}
+	/* Host visible blocks stay mapped */
+	data = staging_buffer_memory.mapped;
 
 	for (i = 0; i < images_count; i++) {
 		pixels = stbi_load_from_file(image_files[i], &tex_width, &tex_height, &tex_channels, STBI_rgb_alpha);
 		if (!pixels) {
 			print_error("failed to load texture image!");
-			break;
+			goto destoy_staging_buffer;
 		}
 
-		memcpy(data, pixels, tex_width * tex_height * 4);
+		memcpy((char *) data + i * layer_size, pixels, layer_size);
 
 		stbi_image_free(pixels);
-
-		ret = create_gpu_image(dev, staging_buffer_memory, staging_buffer, data, tex_width, tex_height,
-							   &local_texture_images_memory[i], &local_texture_images[i]);
-		if (ret)
-			break;
 	}
 
-	if (i != images_count) {
-		destroy_texture_images(dev, local_texture_images_memory, local_texture_images, i);
-		goto unmap_staging_buffer;
-	}
+	ret = create_gpu_image(dev, staging_buffer, width, height, images_count, &image_memory, &image);
+	if (ret)
+		goto destoy_staging_buffer;
 
-	*texture_image = local_texture_images;
-	*texture_image_memory = local_texture_images_memory;
+	/* As the swapchain imageView we cannot access the content of texture
+	 * directly, we need a imageView to access it */
+	image_view = create_image_view(dev->logical_device, image, VK_FORMAT_R8G8B8A8_SRGB,
+								   VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_VIEW_TYPE_2D_ARRAY);
+	if (image_view == VK_NULL_HANDLE) {
+		destroy_image(dev, image, &image_memory);
+		ret = -1;
+		goto destoy_staging_buffer;
+	}
 
-	ret = 0;
+	textures->image = image;
+	textures->image_memory = image_memory;
+	textures->image_view = image_view;
+	textures->layer_count = images_count;
 
-unmap_staging_buffer:
-	vkUnmapMemory(dev->logical_device, staging_buffer_memory);
 destoy_staging_buffer:
-	vkDestroyBuffer(dev->logical_device, staging_buffer, NULL);
-	vkFreeMemory(dev->logical_device, staging_buffer_memory, NULL);
+	destroy_buffer(dev, staging_buffer, &staging_buffer_memory);
 close_files:
 	for (i = 0; i < images_count && image_files[i]; i++)
 		fclose(image_files[i]);
@@ -137,56 +119,6 @@ close_files:
 	return ret;
 }
 
-void
-destroy_texture_image_views(VkDevice logical_device, VkImageView *texture_images_view, uint32_t images_count)
-{
-	int i;
-
-	for (i = 0; i < images_count; i++)
-		vkDestroyImageView(logical_device, texture_images_view[i], NULL);
-
-	free(texture_images_view);
-}
-
-/* Create a ImageView to our textures(from createTextureImage).
- * As the swapchain imageView we cannot access the content of texture
- * directly, we need a imageView to access it.
- * */
-int
-create_texture_image_views(VkDevice logical_device, VkImage *texture_image,
-						   VkImageView **texture_images_view, uint32_t images_count)
-{
-	VkImageView *local_image_view;
-	int i;
-
-	local_image_view = calloc(images_count, sizeof(VkImageView));
-	if (!local_image_view) {
-		print_error("Failed to alloc textures image views!");
-		goto return_error;
-	}
-
-	for (i = 0; i < images_count; i++) {
-		local_image_view[i] = create_image_view(logical_device, texture_image[i],
-												VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT);
-		if (local_image_view[i] == VK_NULL_HANDLE) {
-			print_error("Failed to create texture image view!");
-			break;
-		}
-	}
-
-	if (i != images_count)
-		goto destroy_texture_views;
-
-	*texture_images_view = local_image_view;
-
-	return 0;
-
-destroy_texture_views:
-	destroy_texture_image_views(logical_device, local_image_view, i);
-return_error:
-	return -1;
-}
-
 VkSampler
 create_texture_sampler(VkDevice logical_device, VkPhysicalDeviceProperties *device_properties)
 {
@@ -222,27 +154,22 @@ create_texture_sampler(VkDevice logical_device, VkPhysicalDeviceProperties *devi
 }
 
 int
-load_cube_textures(struct vk_device *dev)
+load_block_textures(struct vk_device *dev)
 {
-	struct vk_vertex_object *cube = &dev->game_objs.cube;
-	int ret;
-
-	char *textures_names[] = {
-		TEX_DIR "stone_bricks.png", TEX_DIR "bricks.png", TEX_DIR "grass_block_top.png",
-		TEX_DIR "sand.png",	TEX_DIR "coarse_dirt.png", TEX_DIR "grass_block_side.png"
+	char *textures_names[texture_layer_count] = {
+		[TEXTURE_STONE_BRICKS] = TEX_DIR "stone_bricks.png",
+		[TEXTURE_BRICKS] = TEX_DIR "bricks.png",
+		[TEXTURE_GRASS_BLOCK_TOP] = TEX_DIR "grass_block_top.png",
+		[TEXTURE_SAND] = TEX_DIR "sand.png",
+		[TEXTURE_COARSE_DIRT] = TEX_DIR "coarse_dirt.png",
+		[TEXTURE_GRASS_BLOCK_SIDE] = TEX_DIR "grass_block_side.png"
 	};
 
-	ret = create_texture_images(dev, textures_names, array_size(textures_names),
-								&cube->texture_images, &cube->texture_images_memory);
-
-	if (!ret)
-		cube->texture_count = array_size(textures_names);
-
-	return ret;
+	return create_texture_array(dev, textures_names, array_size(textures_names), &dev->game_objs.textures);
 }
 
 int
 load_all_textures(struct vk_device *dev)
 {
-	return load_cube_textures(dev);
+	return load_block_textures(dev);
 }
@@ -8,15 +8,13 @@
 int
 load_all_textures(struct vk_device *dev);
 
-void
-destroy_texture_images(struct vk_device *dev, VkDeviceMemory *texture_image_memory,
-					   VkImage *texture_image, uint32_t images_count);
+/* Load the images as the layers of a single texture array */
 int
-create_texture_image_views(VkDevice logical_device, VkImage *texture_image,
-						   VkImageView **texture_images_view, uint32_t images_count);
+create_texture_array(struct vk_device *dev, char *image_names[], uint32_t images_count,
+					 struct vk_block_textures *textures);
 
 void
-destroy_texture_image_views(VkDevice logical_device, VkImageView *texture_images_view, uint32_t images_count);
+destroy_block_textures(struct vk_device *dev, struct vk_block_textures *textures);
 
 VkSampler
 create_texture_sampler(VkDevice logical_device, VkPhysicalDeviceProperties *device_properties);
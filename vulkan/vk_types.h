@@ -7,48 +7,65 @@
 #include <cglm/cglm.h>
 #include <stdbool.h>
 
+#include "vk_deletion_queue.h"
+#include "vk_upload_engine.h"
+#include "upload_scheduler.h"
+#include "vk_frame_ring.h"
+#include "vk_mesh_arena.h"
 #include "vk_constants.h"
+#include "vk_memory.h"
 #include "types.h"
 
 
 enum family_indices { graphics = 0, transfer, compute, protectedBit, sparseBindingBit, present, queues_count };
 
 struct view_projection {
-	VkBuffer *buffers;
-	uint32_t buffer_count;
-	VkDeviceMemory *buffers_memory;
-	uint32_t buffer_memory_count;
+	/* Dynamic offset of the matrix of the frame in the frame ring */
+	uint32_t offset;
 	mat4 proj;
 	mat4 view;
 };
 
-struct vk_vertex_object {
-	/* Vertex resources */
-	VkBuffer vertex_buffer;
-	VkDeviceMemory vertex_buffer_memory;
-	struct vertex *vertices;
-	uint64_t vertices_count;
-	/* Index resources */
-	uint16_t *indices;
-	uint64_t indices_count;
-	VkBuffer index_buffer;
-	VkDeviceMemory index_buffer_memory;
-	/* Textures resources */
-	VkImage *texture_images;
-	VkDeviceMemory *texture_images_memory;
-	VkImageView *texture_images_view;
-	uint32_t texture_count;
-	/* Model positions */
-	VkBuffer *position_buffer;
-	VkDeviceMemory *position_buffer_memory;
-	VkBuffer staging_position_buffer;
-	VkDeviceMemory staging_position_buffer_memory;
-	uint32_t position_count;
-	uint32_t position_buffer_count;
+/* Every block texture is a layer of the same image */
+struct vk_block_textures {
+	VkImage image;
+	struct memory_allocation image_memory;
+	VkImageView image_view;
+	uint32_t layer_count;
+};
+
+/* GPU copy of a chunk mesh, see `mesh_chunk()`. The vertices and then the
+ * indices are in a single range of a mesh arena. */
+struct vk_chunk_mesh {
+	int32_t x;
+	int32_t z;
+	struct arena_range range;
+	uint32_t vertex_count;
+	uint32_t index_count;
+};
+
+/* A mesh moved by the compaction, copied before the next draws */
+struct vk_mesh_move {
+	struct arena_range src;
+	struct arena_range dst;
+	VkDeviceSize size;
 };
 
 struct vk_game_objects {
-	struct vk_vertex_object cube;
+	struct vk_block_textures textures;
+	/* Meshes of the streamed chunks, in no particular order */
+	struct vk_chunk_mesh *chunk_meshes;
+	uint32_t chunk_mesh_count;
+	uint32_t chunk_mesh_capacity;
+	struct mesh_arenas arenas;
+	struct vk_mesh_move mesh_moves[MESH_MOVES_PER_FRAME];
+	uint32_t mesh_move_count;
+	/* The meshes of the chunks cached further than this from the player
+	 * chunk stay on the GPU, but are not drawn */
+	int32_t center_x;
+	int32_t center_z;
+	int32_t draw_distance;
+	struct upload_scheduler uploads;
 	struct view_projection camera;
 };
 
@@ -60,10 +77,19 @@ struct vk_device_properties {
 struct vk_draw_sync {
 	VkSemaphore image_available_semaphore[MAX_FRAMES_IN_FLIGHT];
 	VkSemaphore render_finished_semaphore[MAX_FRAMES_IN_FLIGHT];
-	VkFence in_flight_fences[MAX_FRAMES_IN_FLIGHT];
-	VkFence *images_in_flight;
+	/* Timeline of the graphics queue, signaled with the number of each
+	 * frame once it is drawn */
+	VkSemaphore frame_timeline;
+	uint64_t frame_submitted;
+	/* Last value seen on the timeline, a frame before it needs no wait */
+	uint64_t frame_completed;
+	/* Frame that used the command buffer of each swapchain image last */
+	uint64_t *image_frames;
 };
 
+/* The value the frame timeline gets once the frame being recorded is done */
+#define get_recording_frame(sync) ((sync)->frame_submitted + 1)
+
 struct vk_cmd_submission {
 	VkCommandPool command_pools[queues_count];
 	uint64_t pools_allocated;
@@ -83,12 +109,14 @@ struct vk_render {
 	VkRenderPass render_pass;
 	VkPipeline graphics_pipeline;
 	VkPipelineLayout pipeline_layout;;
+	VkShaderModule vert_shader_module;
+	VkShaderModule frag_shader_module;
 	VkFramebuffer *swapChain_framebuffers;
 	uint32_t framebuffer_count;
 	VkDescriptorSetLayout descriptor_set_layout;
 	VkSampler texture_sampler;
 	VkImage depth_image;
-	VkDeviceMemory depth_image_memory;
+	struct memory_allocation depth_image_memory;
 	VkImageView depth_image_view;
 	VkFormat depth_format;
 };
@@ -120,6 +148,14 @@ struct vk_swapchain {
 struct vk_device {
 	VkPhysicalDevice physical_device;
 	VkDevice logical_device;
+	/* Every buffer and image memory comes from it */
+	struct memory_allocator allocator;
+	/* Data written by the CPU every frame */
+	struct frame_ring frame_ring;
+	/* Copies to the device local buffers, on the transfer queue */
+	struct upload_engine upload_engine;
+	/* Resources destroyed once the frames using them are done */
+	struct deletion_queue deletion_queue;
 	struct vk_cmd_submission cmd_submission;
 	struct vk_swapchain swapchain;
 	struct vk_render render;
@@ -0,0 +1,222 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "vk_command_buffer.h"
+#include "vk_upload_engine.h"
+#include "vk_buffer.h"
+#include "vk_draw.h"
+#include "utils.h"
+
+#define INITIAL_UPLOAD_BARRIER_CAPACITY 64
+
+int
+upload_engine_init(struct vk_device *dev, struct upload_engine *engine)
+{
+	struct vk_cmd_submission *cmd_sub = &dev->cmd_submission;
+	VkCommandBuffer *cmd_buffers;
+	uint32_t i;
+
+	memset(engine, 0, sizeof(struct upload_engine));
+
+	engine->logical_device = dev->logical_device;
+	engine->dst_family = cmd_sub->family_indices[graphics];
+
+	if (cmd_sub->cmd_buffers_count[transfer] > 0) {
+		engine->queue = cmd_sub->queue_handles[transfer];
+		engine->pool = cmd_sub->command_pools[transfer];
+		engine->src_family = cmd_sub->family_indices[transfer];
+	} else {
+		engine->queue = cmd_sub->queue_handles[graphics];
+		engine->pool = cmd_sub->command_pools[graphics];
+		engine->src_family = cmd_sub->family_indices[graphics];
+	}
+
+	cmd_buffers = alloc_command_buffers(dev->logical_device, engine->pool, VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+										UPLOAD_BATCH_COUNT);
+	if (!cmd_buffers)
+		return -1;
+
+	for (i = 0; i < UPLOAD_BATCH_COUNT; i++)
+		engine->batches[i].cmd_buffer = cmd_buffers[i];
+
+	free(cmd_buffers);
+
+	if (create_timeline_semaphore(dev->logical_device, &engine->timeline)) {
+		upload_engine_destroy(dev, engine);
+		return -1;
+	}
+
+	return 0;
+}
+
+void
+upload_engine_destroy(struct vk_device *dev, struct upload_engine *engine)
+{
+	struct upload_batch *batch;
+	uint32_t i;
+
+	for (i = 0; i < UPLOAD_BATCH_COUNT; i++) {
+		batch = &engine->batches[i];
+		if (batch->cmd_buffer)
+			vkFreeCommandBuffers(dev->logical_device, engine->pool, 1, &batch->cmd_buffer);
+	}
+
+	if (engine->timeline)
+		vkDestroySemaphore(dev->logical_device, engine->timeline, NULL);
+
+	free(engine->barriers);
+	memset(engine, 0, sizeof(struct upload_engine));
+}
+
+/* The batch was submitted UPLOAD_BATCH_COUNT frames ago, it is almost
+ * always done by now */
+static int
+begin_batch(struct upload_engine *engine)
+{
+	struct upload_batch *batch = &engine->batches[engine->current];
+
+	if (wait_timeline(engine->logical_device, engine->timeline, &engine->completed, batch->value))
+		return -1;
+
+	/* The pool resets the buffer on begin */
+	if (begin_single_time_commands(batch->cmd_buffer) != VK_SUCCESS)
+		return -1;
+
+	/* Acquired by the frame that waited the last batch already */
+	engine->barrier_count = 0;
+	engine->recording = true;
+
+	return 0;
+}
+
+static int
+push_barrier(struct upload_engine *engine, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size)
+{
+	VkBufferMemoryBarrier *barriers;
+	uint32_t capacity;
+
+	if (engine->barrier_count == engine->barrier_capacity) {
+		capacity = engine->barrier_capacity ? engine->barrier_capacity * 2 : INITIAL_UPLOAD_BARRIER_CAPACITY;
+		barriers = realloc(engine->barriers, sizeof(VkBufferMemoryBarrier) * capacity);
+		if (!barriers) {
+			print_error("Failed to grow the upload barriers vector!");
+			return -1;
+		}
+
+		engine->barriers = barriers;
+		engine->barrier_capacity = capacity;
+	}
+
+	engine->barriers[engine->barrier_count++] = (VkBufferMemoryBarrier) {
+		.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+		.srcQueueFamilyIndex = engine->src_family,
+		.dstQueueFamilyIndex = engine->dst_family,
+		.buffer = buffer,
+		.offset = offset,
+		.size = size
+	};
+
+	return 0;
+}
+
+int
+upload_engine_copy_buffer(struct upload_engine *engine, VkBuffer src_buffer, VkDeviceSize src_offset,
+						  VkBuffer dst_buffer, VkDeviceSize dst_offset, VkDeviceSize size)
+{
+	if (!engine->recording && begin_batch(engine))
+		return -1;
+
+	/* The old content of the range is dropped, so only the graphics family
+	 * needs to acquire it */
+	if (engine->src_family != engine->dst_family && push_barrier(engine, dst_buffer, dst_offset, size))
+		return -1;
+
+	VkBufferCopy copy_region = {
+		.srcOffset = src_offset,
+		.dstOffset = dst_offset,
+		.size = size
+	};
+
+	vkCmdCopyBuffer(engine->batches[engine->current].cmd_buffer, src_buffer, dst_buffer, 1, &copy_region);
+
+	return 0;
+}
+
+int
+upload_engine_submit(struct upload_engine *engine)
+{
+	struct upload_batch *batch = &engine->batches[engine->current];
+	VkResult result;
+	uint32_t i;
+
+	if (!engine->recording)
+		return 0;
+
+	engine->recording = false;
+
+	/* Release half of the ownership transfers */
+	for (i = 0; i < engine->barrier_count; i++) {
+		engine->barriers[i].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		engine->barriers[i].dstAccessMask = 0;
+	}
+
+	if (engine->barrier_count)
+		vkCmdPipelineBarrier(batch->cmd_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+							 0, 0, NULL, engine->barrier_count, engine->barriers, 0, NULL);
+
+	result = vkEndCommandBuffer(batch->cmd_buffer);
+	if (result != VK_SUCCESS) {
+		print_error("Failed to record upload batch!");
+		return -1;
+	}
+
+	batch->value = engine->submitted + 1;
+
+	VkTimelineSemaphoreSubmitInfo timeline_info = {
+		.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+		.signalSemaphoreValueCount = 1,
+		.pSignalSemaphoreValues = &batch->value
+	};
+
+	VkSubmitInfo submit_info = {
+		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+		.pNext = &timeline_info,
+		.commandBufferCount = 1,
+		.pCommandBuffers = &batch->cmd_buffer,
+		.signalSemaphoreCount = 1,
+		.pSignalSemaphores = &engine->timeline
+	};
+
+	result = vkQueueSubmit(engine->queue, 1, &submit_info, VK_NULL_HANDLE);
+	if (result != VK_SUCCESS) {
+		print_error("Failed to submit upload batch!");
+		return -1;
+	}
+
+	engine->submitted = batch->value;
+	engine->wait_value = batch->value;
+	engine->current = (engine->current + 1) % UPLOAD_BATCH_COUNT;
+
+	return 0;
+}
+
+void
+upload_engine_acquire(struct upload_engine *engine, VkCommandBuffer cmd_buffer)
+{
+	uint32_t i;
+
+	if (!engine->barrier_count || engine->recording)
+		return;
+
+	/* Acquire half, it runs once the timeline wait is done */
+	for (i = 0; i < engine->barrier_count; i++) {
+		engine->barriers[i].srcAccessMask = 0;
+		engine->barriers[i].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT |
+											VK_ACCESS_INDEX_READ_BIT;
+	}
+
+	vkCmdPipelineBarrier(cmd_buffer, UPLOAD_DST_STAGES, UPLOAD_DST_STAGES, 0, 0, NULL,
+						 engine->barrier_count, engine->barriers, 0, NULL);
+
+	engine->barrier_count = 0;
+}
@@ -0,0 +1,77 @@
+#ifndef VK_UPLOAD_ENGINE_H
+#define VK_UPLOAD_ENGINE_H
+
+#include <vulkan/vulkan.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "vk_memory.h"
+
+/* Batches the GPU may still be running, a frame submits one at most */
+#define UPLOAD_BATCH_COUNT 3
+/* Where the uploaded buffers are read, the graphics submit waits for the
+ * batch there */
+#define UPLOAD_DST_STAGES (VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT)
+
+struct vk_device;
+
+struct upload_batch {
+	VkCommandBuffer cmd_buffer;
+	/* Value of the upload timeline once the copies are done, 0 if it was
+	 * never submitted */
+	uint64_t value;
+};
+
+/* Records the copies of a frame in a command buffer of the transfer queue,
+ * submitted once and signaling the upload timeline, so neither the CPU nor
+ * the graphics queue wait for the copies before they are needed.
+ *
+ * The transfer queue has its own family, so the buffers written by it are
+ * released to the graphics family at the end of the batch, and acquired by
+ * the next frame, see `upload_engine_acquire()`. Without a transfer queue
+ * the batches go to the graphics queue and no ownership moves.
+ * */
+struct upload_engine {
+	VkDevice logical_device;
+	VkQueue queue;
+	VkCommandPool pool;
+	uint32_t src_family;
+	uint32_t dst_family;
+	/* Counts the batches submitted, signaled as each one is done */
+	VkSemaphore timeline;
+	uint64_t submitted;
+	uint64_t completed;
+	struct upload_batch batches[UPLOAD_BATCH_COUNT];
+	uint32_t current;
+	bool recording;
+	/* Ranges written by the batch being recorded, or by the last submitted
+	 * one until the graphics queue acquires them */
+	VkBufferMemoryBarrier *barriers;
+	uint32_t barrier_count;
+	uint32_t barrier_capacity;
+	/* The next graphics submit waits the timeline for it, 0 if nothing was
+	 * uploaded since the last one */
+	uint64_t wait_value;
+};
+
+int
+upload_engine_init(struct vk_device *dev, struct upload_engine *engine);
+
+/* The device must be idle */
+void
+upload_engine_destroy(struct vk_device *dev, struct upload_engine *engine);
+
+int
+upload_engine_copy_buffer(struct upload_engine *engine, VkBuffer src_buffer, VkDeviceSize src_offset,
+						  VkBuffer dst_buffer, VkDeviceSize dst_offset, VkDeviceSize size);
+
+/* Submits the copies recorded since the last call, if any */
+int
+upload_engine_submit(struct upload_engine *engine);
+
+/* Recorded by the graphics command buffer that waits `wait_value`, before
+ * the uploaded buffers are used */
+void
+upload_engine_acquire(struct upload_engine *engine, VkCommandBuffer cmd_buffer);
+
+#endif //VK_UPLOAD_ENGINE_H